@@ -0,0 +1,144 @@
+#include <stdlib.h>
+#include <string.h>
+#include "tests.h"
+#include "ops.h"
+#include "undo.h"
+#include "lz.h"
+#include "coldRows.h"
+
+//Compresses len bytes of src and checks they come back, and that they don't fit a byte less
+static void lzCheck(const char *src, int len){
+    char *comp = malloc(lzCompressBound(len));
+    char *back = malloc(len + 1);
+    int compLen = lzCompress(src, len, comp);
+    CHECK(compLen > 0 && compLen <= lzCompressBound(len));
+    CHECK(lzDecompress(comp, compLen, back, len) == len);
+    CHECK(memcmp(back, src, len) == 0);
+    if (len > 0) CHECK(lzDecompress(comp, compLen, back, len - 1) == -1);
+    free(comp);
+    free(back);
+}
+
+//Nothing, noise, runs long enough for extra length bytes and matches that overlap what they write
+void testLzRoundTrip(editorConfig *ce){
+    (void)ce;
+    int len = 256 * 1024;
+    char *buf = malloc(len);
+
+    lzCheck(buf, 0);
+    for (int i = 0;i<len;i++) buf[i] = rand();
+    lzCheck(buf, len);
+    for (int n = 1;n<40;n++) lzCheck(buf, n);
+
+    memset(buf, 'a', len);
+    lzCheck(buf, len);
+    char *comp = malloc(lzCompressBound(len));
+    CHECK(lzCompress(buf, len, comp) < len / 100);
+    free(comp);
+
+    //Noise repeated from past the farthest offset and from just inside it, runs between noise, and text
+    for (int i = 0;i<len;i++) buf[i] = i < 100000 ? rand() : buf[i - (i < 180000 ? 70000 : 60000)];
+    lzCheck(buf, len);
+    for (int i = 0;i<len;i += 300) memset(&buf[i], ' ', 40 + rand() % 200);
+    lzCheck(buf, len);
+    static const char *pieces[] = {"int ", "x", " = ", "0;\n", "\treturn ", "é", "{\n", "}\n"};
+    int at = 0;
+    while (at < len - 64){
+        int n;
+        testRandomText(&buf[at], &n, pieces, sizeof(pieces) / sizeof(pieces[0]), 6);
+        at += n;
+    }
+    lzCheck(buf, at);
+    free(buf);
+}
+
+//The rows still read back as what was loaded while going in and out of the block cache
+static void coldCheckRows(editorConfig *ce, char **lines){
+    for (int k = 0;k<ce->numRows * 2;k++){
+        int y = rand() % ce->numRows;
+        erow *row = &ce->row[y];
+        CHECK((int)strlen(lines[y]) == row->size);
+        CHECK(memcmp(editorRowText(row), lines[y], row->size + 1) == 0);
+    }
+}
+
+//Frozen rows over many more blocks than the cache keeps, read, thawed and edited
+void testColdRows(editorConfig *ce){
+    static const char *pieces[] = {"a", "bc", "\t", "word ", "é", "{x}", "    ", "return 0;"};
+    int numRows = 4000;
+    char **lines = malloc(sizeof(char *) * numRows);
+    char buf[512];
+    for (int y = 0;y<numRows;y++){
+        int len;
+        testRandomText(buf, &len, pieces, sizeof(pieces) / sizeof(pieces[0]), 20);
+        lines[y] = strdup(buf);
+        editorInsertRow(ce, y, buf, len);
+    }
+    ce->dirty = 0;
+    size_t textLen;
+    char *text = testText(ce, &textLen);
+
+    //Small ranges so every one is a block of its own, the rows on screen stay as they are
+    for (int y = 0;y<numRows;y += 100) editorFreezeRows(ce, y, y + 100 < numRows ? y + 100 : numRows);
+    coldStats st;
+    editorColdGetStats(&st);
+    CHECK(st.numBlocks > COMETTEX_COLD_CACHE * 4);
+    CHECK(st.coldRows == numRows - ce->screenRow);
+    CHECK(ce->row[0].coldBlock == -1 && ce->row[ce->screenRow].coldBlock != -1);
+
+    CHECK(testSame(ce, text, textLen));
+    coldCheckRows(ce, lines);
+    if (testFailed()) return;
+    editorColdGetStats(&st);
+    CHECK(st.cacheBytes <= (size_t)COMETTEX_COLD_CACHE * COMETTEX_COLD_BLOCK_BYTES);
+
+    //Thawed rows are normal rows again, their block goes once the last of them is thawed
+    for (int k = 0;k<500;k++){
+        int y = rand() % numRows;
+        erow *row = &ce->row[y];
+        editorRowThaw(ce, row);
+        CHECK(row->coldBlock == -1 && row->chars && memcmp(row->chars, lines[y], row->size + 1) == 0);
+
+        y = rand() % numRows;
+        row = &ce->row[y];
+        int len;
+        testRandomText(buf, &len, pieces, sizeof(pieces) / sizeof(pieces[0]), 3);
+        int x = rand() % (row->size + 1);
+        size_t old = strlen(lines[y]);
+        char *s;
+        if (rand() % 3 && len){
+            editorInsertText(ce, y, x, buf, len);
+            s = malloc(old + len + 1);
+            memcpy(s, lines[y], x);
+            memcpy(s + x, buf, len);
+            memcpy(s + x + len, lines[y] + x, old - x + 1);
+        }else{
+            if (x == row->size) x = 0;
+            if (row->size == 0) continue;
+            int x1 = x + 1 + rand() % (row->size - x);
+            editorDeleteRange(ce, y, x, y, x1);
+            s = malloc(old + 1);
+            memcpy(s, lines[y], x);
+            memcpy(s + x, lines[y] + x1, old - x1 + 1);
+        }
+        editorUndoSeal();
+        free(lines[y]);
+        lines[y] = s;
+        CHECK(ce->row[y].coldBlock == -1);
+    }
+    coldCheckRows(ce, lines);
+    if (testFailed()) return;
+
+    //Undo brings back the text the rows had when they were frozen
+    while (editorUndo(ce));
+    CHECK(testSame(ce, text, textLen));
+
+    for (int y = 0;y<numRows;y++) editorRowThaw(ce, &ce->row[y]);
+    editorColdGetStats(&st);
+    CHECK(st.numBlocks == 0 && st.coldRows == 0 && st.compressedBytes == 0);
+    CHECK(testSame(ce, text, textLen));
+
+    for (int y = 0;y<numRows;y++) free(lines[y]);
+    free(lines);
+    free(text);
+}
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tests.h"
+#include "ops.h"
+#include "coldRows.h"
+#include "diff.h"
+
+static const char *pieces[] = {"a", "b", "\n", "xy", "\n\n"};
+#define NUM_PIECES (int)(sizeof(pieces) / sizeof(pieces[0]))
+
+//The saved file's rows, to check the hunks against
+static char **base = NULL;
+static int numBase = 0;
+
+static void diffTakeBase(editorConfig *ce){
+    for (int i = 0;i<numBase;i++) free(base[i]);
+    free(base);
+    numBase = ce->numRows;
+    base = malloc(sizeof(char *) * (numBase + 1));
+    for (int i = 0;i<numBase;i++) base[i] = strndup(editorRowText(&ce->row[i]), ce->row[i].size);
+}
+
+static int diffSameAsBase(editorConfig *ce, int y, int x){
+    erow *row = &ce->row[y];
+    return strlen(base[x]) == (size_t)row->size && memcmp(base[x], editorRowText(row), row->size) == 0;
+}
+
+//Rows between hunks are the file's, the hunks are in order, and the gutter marks say what the hunks do
+static void diffCheck(editorConfig *ce){
+    unsigned char *want = calloc(ce->numRows + 1, 1);
+    int y = 0, x = 0;
+    for (int i = 0;i<ce->numDiffHunks;i++){
+        diffHunk *h = &ce->diffHunks[i];
+        CHECK(h->cur >= y && h->base >= x && h->cur - y == h->base - x);
+        for (;y<h->cur;y++, x++) CHECK(diffSameAsBase(ce, y, x));
+        CHECK(h->curLen > 0 || h->baseLen > 0);
+        if (h->curLen == 0 && ce->numRows){
+            if (h->cur > 0) want[h->cur - 1] |= DIFF_DELETED_BELOW;
+            else want[0] |= DIFF_DELETED_ABOVE;
+        }
+        for (int k = 0;k<h->curLen;k++){
+            want[h->cur + k] &= ~DIFF_KIND_MASK;
+            want[h->cur + k] |= k < h->baseLen ? DIFF_MODIFIED : DIFF_ADDED;
+        }
+        y += h->curLen;
+        x += h->baseLen;
+    }
+    CHECK(ce->numRows - y == numBase - x);
+    for (;y<ce->numRows;y++, x++) CHECK(diffSameAsBase(ce, y, x));
+    for (int i = 0;i<ce->numRows;i++) CHECK(editorDiffMark(ce, i) == want[i]);
+    free(want);
+}
+
+//Random edits with the hunks brought up to date now and then, and after a save there are none
+void testDiff(editorConfig *ce){
+    char text[4096];
+    int len = 0;
+    for (int i = 0;i<200;i++) len += sprintf(text + len, "row %d\n", i % 37);
+    testLoad(ce, text);
+    editorDiffSaved(ce);
+    diffTakeBase(ce);
+
+    for (int step = 0;step<3000;step++){
+        char buf[64];
+        int y = ce->numRows ? rand() % ce->numRows : 0;
+        switch (rand() % 5){
+            case 0:
+                if (ce->numRows) editorRowInsertChar(ce, &ce->row[y], rand() % (ce->row[y].size + 1), 'a' + rand() % 3);
+                break;
+            case 1:
+                testRandomText(buf, &len, pieces, NUM_PIECES, 4);
+                editorInsertText(ce, y, 0, buf, len);
+                break;
+            case 2:
+                if (ce->numRows > 1) editorDelRows(ce, y, 1 + rand() % 4);
+                break;
+            case 3:
+                if (y + 1 < ce->numRows){
+                    int y1 = y + 1 + rand() % 2;
+                    if (y1 >= ce->numRows) y1 = ce->numRows - 1;
+                    editorDeleteRange(ce, y, 0, y1, 0);
+                }
+                break;
+            default:
+                if (ce->numRows && ce->row[y].size) editorRowDelChar(ce, &ce->row[y], 0);
+                break;
+        }
+        if (rand() % 3 == 0){
+            editorDiffUpdate(ce);
+            diffCheck(ce);
+            if (testFailed()) return;
+        }
+    }
+    editorDiffUpdate(ce);
+    diffCheck(ce);
+    if (testFailed()) return;
+
+    editorDiffSaved(ce);
+    diffTakeBase(ce);
+    CHECK(ce->numDiffHunks == 0);
+    diffCheck(ce);
+}
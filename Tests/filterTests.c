@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tests.h"
+#include "ops.h"
+#include "undo.h"
+#include "coldRows.h"
+#include "filter.h"
+
+//Rows [at, at + n) of text turned around, what tac makes of them
+static char *filterReversed(editorConfig *ce, int at, int n, size_t *len){
+    size_t total = 0;
+    for (int i = 0;i<ce->numRows;i++) total += ce->row[i].size + 1;
+    char *out = malloc(total + 1);
+    size_t k = 0;
+    for (int i = 0;i<at;i++){
+        memcpy(out + k, editorRowText(&ce->row[i]), ce->row[i].size);
+        k += ce->row[i].size;
+        out[k++] = '\n';
+    }
+    for (int i = at + n - 1;i>=at;i--){
+        memcpy(out + k, editorRowText(&ce->row[i]), ce->row[i].size);
+        k += ce->row[i].size;
+        out[k++] = '\n';
+    }
+    for (int i = at + n;i<ce->numRows;i++){
+        memcpy(out + k, editorRowText(&ce->row[i]), ce->row[i].size);
+        k += ce->row[i].size;
+        out[k++] = '\n';
+    }
+    *len = k;
+    return out;
+}
+
+//The rows come back as the command wrote them, and undo and redo go between that and before
+static void filterOne(editorConfig *ce, int at, int n, const char *cmd, const char *want, size_t wantLen){
+    size_t beforeLen;
+    char *before = testText(ce, &beforeLen);
+    int rows;
+    editorUndoSeal();
+    CHECK(editorFilterRows(ce, at, n, cmd, &rows) == 0);
+    CHECK(testSame(ce, want, wantLen));
+    editorUndoSeal();
+    CHECK(editorUndo(ce));
+    CHECK(testSame(ce, before, beforeLen));
+    CHECK(editorRedo(ce));
+    CHECK(testSame(ce, want, wantLen));
+    free(before);
+}
+
+void testFilterUndo(editorConfig *ce){
+    char row[64];
+    for (int i = 0;i<5000;i++){
+        int len = sprintf(row, "line %d of the file", i);
+        editorInsertRow(ce, ce->numRows, row, len);
+    }
+
+    size_t len;
+    char *want = filterReversed(ce, 10, 100, &len);
+    filterOne(ce, 10, 100, "tac", want, len);
+    free(want);
+    if (testFailed()) return;
+
+    want = filterReversed(ce, 0, ce->numRows, &len);
+    filterOne(ce, 0, ce->numRows, "tac", want, len);
+    free(want);
+    if (testFailed()) return;
+
+    //No output takes the rows away
+    size_t allLen;
+    char *all = testText(ce, &allLen);
+    size_t cut = 0;
+    for (int i = 0;i<20;i++) cut += ce->row[i].size + 1;
+    filterOne(ce, 0, 20, "true", all + cut, allLen - cut);
+    free(all);
+    if (testFailed()) return;
+
+    //A failing command leaves the rows alone
+    all = testText(ce, &allLen);
+    int rows;
+    CHECK(editorFilterRows(ce, 5, 5, "false", &rows) != 0);
+    CHECK(testSame(ce, all, allLen));
+    free(all);
+}
+
+//Rows going through the command are more than COMETTEX_UNDO_BYTES both ways, on top of older
+//changes. Undo gets the old rows back and not just the new ones taken away
+void testFilterUndoTrim(editorConfig *ce){
+    char row[64];
+    int rows = COMETTEX_UNDO_BYTES / 32;
+    for (int i = 0;i<rows;i++){
+        int len = sprintf(row, "line %d of a file too big for undo", i);
+        editorInsertRow(ce, ce->numRows, row, len);
+    }
+    for (int i = 0;i<rows;i += rows / 10){
+        editorInsertText(ce, i, 0, "old ", 4);
+        editorUndoSeal();
+    }
+
+    size_t len;
+    char *want = filterReversed(ce, 0, ce->numRows, &len);
+    filterOne(ce, 0, ce->numRows, "tac", want, len);
+    free(want);
+    if (testFailed()) return;
+
+    //The older changes made room for it
+    CHECK(editorUndo(ce));
+    CHECK(!editorUndo(ce));
+}
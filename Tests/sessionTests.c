@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "tests.h"
+#include "fileIO.h"
+#include "coldRows.h"
+#include "syntaxHighlighting.h"
+#include "languages.h"
+#include "session.h"
+
+static char sessionDir[] = "/tmp/comettexTestXXXXXX";
+
+//The one session file written under the test's cache directory
+static int sessionFile(char *path){
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s/%s", sessionDir, COMETTEX_SESSION_DIR);
+    DIR *d = opendir(dir);
+    if (d == NULL) return 0;
+    struct dirent *de;
+    int found = 0;
+    while ((de = readdir(d)) != NULL){
+        if (de->d_name[0] == '.') continue;
+        snprintf(path, PATH_MAX, "%s/%s", dir, de->d_name);
+        found++;
+    }
+    closedir(d);
+    return found == 1;
+}
+
+static void sessionWrite(const char *path, const char *text, size_t len, struct timespec *mtime){
+    FILE *fp = fopen(path, "w");
+    fwrite(text, 1, len, fp);
+    fclose(fp);
+    if (mtime){
+        struct timespec times[2] = {*mtime, *mtime};
+        utimensat(AT_FDCWD, path, times, 0);
+    }
+}
+
+//Opened from the session: every row cold and with the state it was saved with
+static int sessionLoaded(editorConfig *ce){
+    for (int y = 0;y<ce->numRows;y++){
+        if (ce->row[y].coldBlock == -1) return 0;
+    }
+    return ce->numRows > 0;
+}
+
+static void sessionRun(editorConfig *ce){
+    char file[PATH_MAX];
+    snprintf(file, sizeof(file), "%s/a.c", sessionDir);
+    setenv("XDG_CACHE_HOME", sessionDir, 1);
+    char langs[PATH_MAX];
+    snprintf(langs, sizeof(langs), "%s/languages", sessionDir);
+    editorLanguagesInit(langs);
+
+    //Enough rows for a few blocks, with comments, strings and brackets across rows and no last '\n'
+    static const char *pieces[] = {"int ", "x", "\t", "/*", "*/", "\"s\"", "{", "}", "(", ")", "\n", "\n", "é"};
+    int cap = 64 * 1024;
+    char *text = malloc(cap);
+    int len = 0;
+    while (len < cap - 64){
+        int n;
+        testRandomText(text + len, &n, pieces, sizeof(pieces) / sizeof(pieces[0]), 8);
+        len += n;
+    }
+    text[len++] = 'x';
+    sessionWrite(file, text, len, NULL);
+
+    editorOpen(ce, file);
+    editorSelectSyntaxHighlight(ce);
+    CHECK(ce->syntax != NULL && ce->numRows > COMETTEX_COLD_BLOCK_ROWS * 2);
+    int numRows = ce->numRows;
+    unsigned char *open = malloc(numRows);
+    unsigned char *tabs = malloc(numRows);
+    bracketSummary *brackets = malloc(sizeof(bracketSummary) * numRows);
+    for (int y = 0;y<numRows;y++){
+        open[y] = ce->row[y].hlOpenComment;
+        tabs[y] = ce->row[y].statTabs;
+        brackets[y] = ce->row[y].brackets;
+    }
+    size_t rowsLen;
+    char *rows = testText(ce, &rowsLen);
+    ce->my = numRows / 2;
+    ce->mx = 1;
+    ce->rowOffset = ce->my - 5;
+    editorSessionSave(ce);
+    char session[PATH_MAX];
+    CHECK(sessionFile(session));
+    struct stat st;
+    stat(file, &st);
+    struct timespec mtime = st.st_mtim;
+
+    editorOpen(ce, file);
+    CHECK(sessionLoaded(ce) && ce->numRows == numRows);
+    CHECK(testSame(ce, rows, rowsLen));
+    for (int y = 0;y<numRows;y++){
+        CHECK(ce->row[y].hlOpenComment == open[y] && ce->row[y].statTabs == tabs[y]);
+        CHECK(!memcmp(&ce->row[y].brackets, &brackets[y], sizeof(bracketSummary)));
+    }
+    CHECK(ce->my == numRows / 2 && ce->mx == 1 && ce->rowOffset == ce->my - 5);
+
+    //The same text with another mtime, then the same size and mtime with other text
+    struct timespec later = mtime;
+    later.tv_sec++;
+    sessionWrite(file, text, len, &later);
+    editorOpen(ce, file);
+    CHECK(!sessionLoaded(ce) && testSame(ce, rows, rowsLen));
+    sessionWrite(file, text, len, &mtime);
+    editorOpen(ce, file);
+    CHECK(sessionLoaded(ce));
+
+    char *at = strchr(text, 'x');
+    *at = 'y';
+    sessionWrite(file, text, len, &mtime);
+    editorOpen(ce, file);
+    CHECK(!sessionLoaded(ce) && !testSame(ce, rows, rowsLen));
+    *at = 'x';
+
+    //A session cut short, by a byte or to less than its header, is never read
+    sessionWrite(file, text, len, &mtime);
+    stat(session, &st);
+    truncate(session, st.st_size - 1);
+    editorOpen(ce, file);
+    CHECK(!sessionLoaded(ce) && testSame(ce, rows, rowsLen));
+    truncate(session, 64);
+    editorOpen(ce, file);
+    CHECK(!sessionLoaded(ce) && testSame(ce, rows, rowsLen));
+
+    free(open);
+    free(tabs);
+    free(brackets);
+    free(rows);
+    free(text);
+}
+
+//A file opened, saved with its session and opened again, and the ways a session goes stale
+void testSession(editorConfig *ce){
+    CHECK(mkdtemp(sessionDir) != NULL);
+    char *home = getenv("XDG_CACHE_HOME");
+    if (home) home = strdup(home);
+
+    sessionRun(ce);
+
+    char path[PATH_MAX];
+    if (sessionFile(path)) unlink(path);
+    snprintf(path, sizeof(path), "%s/%s", sessionDir, COMETTEX_SESSION_DIR);
+    rmdir(path);
+    *strrchr(path, '/') = '\0';
+    rmdir(path);
+    snprintf(path, sizeof(path), "%s/a.c", sessionDir);
+    unlink(path);
+    rmdir(sessionDir);
+    if (home) setenv("XDG_CACHE_HOME", home, 1);
+    else unsetenv("XDG_CACHE_HOME");
+    free(home);
+    free(ce->filename);
+    ce->filename = NULL;
+}
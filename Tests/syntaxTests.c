@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tests.h"
+#include "ops.h"
+#include "syntaxHighlighting.h"
+
+static void syntaxRows(editorConfig *ce, int rows){
+    char row[32];
+    for (int i = 0;i<rows;i++){
+        int len = sprintf(row, "int x%d;", i);
+        editorInsertRow(ce, ce->numRows, row, len);
+    }
+}
+
+//Rows inserted or deleted above the rows waiting for highlight move them down or up, and
+//whatever is left of them is still highlighted on the flush
+void testSyntaxDefer(editorConfig *ce){
+    ce->syntax = &HLDB[0];
+    syntaxRows(ce, 20);
+
+    editorDeferSyntax(ce);
+    editorRowAppendString(ce, &ce->row[10], "/*", 2);
+    editorDelRows(ce, 2, 2);
+    editorFlushSyntax(ce);
+    CHECK(ce->row[8].hlOpenComment);
+    CHECK(ce->row[ce->numRows - 1].hlOpenComment);
+
+    editorDeferSyntax(ce);
+    editorRowDelChars(ce, &ce->row[8], ce->row[8].size - 2, 2);
+    editorInsertRow(ce, 0, "a", 1);
+    editorFlushSyntax(ce);
+    CHECK(!ce->row[9].hlOpenComment);
+    CHECK(!ce->row[ce->numRows - 1].hlOpenComment);
+
+    //Deleting into the range only takes what it deletes
+    editorDeferSyntax(ce);
+    editorRowAppendString(ce, &ce->row[10], "/*", 2);
+    editorRowAppendString(ce, &ce->row[11], "x", 1);
+    editorDelRows(ce, 5, 6);
+    editorFlushSyntax(ce);
+    CHECK(!ce->row[5].hlOpenComment);
+    CHECK(!ce->row[ce->numRows - 1].hlOpenComment);
+}
+
+static const char *longPieces[] = {
+    "int ", "foo(", ")", "[", "]", "{", "}", "\t", "/*", "*/", "\"s\\\"\"", "'", "12 ", "return ", "x", " ", "\xc3\xa9", "//",
+};
+#define LONG_PIECES (int)(sizeof(longPieces) / sizeof(longPieces[0]))
+
+//The start of the char x is in
+static int longRowBoundary(erow *row, int x){
+    while (x > 0 && (row->chars[x] & 0xc0) == 0x80) x--;
+    return x;
+}
+
+//Where the long row 1 puts a char every few chars, and the highlight of the screen at a few places
+static int *longRowLook(editorConfig *ce, int *n){
+    erow *row = &ce->row[1];
+    *n = 0;
+    int *look = malloc(sizeof(int) * (row->size / 37 + 1 + 8 * 80));
+    for (int mx = 0;mx<row->size;mx += 37){
+        look[(*n)++] = rowMxToRx(row, mx) * 4096 + rowMxToRb(row, mx) % 4096;
+    }
+    for (int i = 0;i<8;i++){
+        int rx = (i * 7919) % rowMxToRx(row, row->size);
+        editorRowEnsureWindow(ce, row, rx);
+        int rstart = row->longRow ? row->longRow->rstart : 0;
+        for (int c = 0;c<80;c++) look[(*n)++] = editorHlAt(row, rx - rstart + c);
+    }
+    return look;
+}
+
+//What the long row 1 shows after an edit against what it shows done again from scratch
+static void longRowCheck(editorConfig *ce){
+    erow *row = &ce->row[1];
+    bracketSummary br = row->brackets;
+    int open = row->hlOpenComment, below = ce->row[2].hlOpenComment;
+    int n, m;
+    int *look = longRowLook(ce, &n);
+
+    editorUpdateRow(ce, row);
+    int *again = longRowLook(ce, &m);
+    int same = n == m && memcmp(look, again, sizeof(int) * n) == 0;
+    free(look);
+    free(again);
+    CHECK(same);
+    CHECK(br.sum == row->brackets.sum && br.min == row->brackets.min && br.max == row->brackets.max);
+    CHECK(open == row->hlOpenComment && below == ce->row[2].hlOpenComment);
+}
+
+//Edits to a long row only lex and walk the part of it they reach, with and without a syntax
+void testLongRow(editorConfig *ce){
+    char *text = malloc(COMETTEX_LONG_LINE + 4096 + 64);
+    ce->syntax = &HLDB[0];
+    editorInsertRow(ce, 0, "int a;", 6);
+    editorInsertRow(ce, 1, "int b;", 6);
+
+    //The lexer went past the checkpoint after "/" to see there's no '*', it's lexed from before it
+    memset(text, ' ', COMETTEX_LONG_LINE);
+    text[4095] = '/';
+    editorInsertRow(ce, 1, text, COMETTEX_LONG_LINE);
+    editorInsertText(ce, 1, 4096, "*", 1);
+    CHECK(ce->row[1].hlOpenComment && ce->row[2].hlOpenComment);
+    longRowCheck(ce);
+    if (testFailed()) return;
+    editorDelRow(ce, 1);
+
+    int len = 0;
+    while (len < COMETTEX_LONG_LINE + 4096){
+        //A line comment would take everything after it
+        const char *p = longPieces[rand() % (LONG_PIECES - 1)];
+        memcpy(&text[len], p, strlen(p));
+        len += strlen(p);
+    }
+    editorInsertRow(ce, 1, text, len);
+    free(text);
+
+    char buf[64];
+    for (int i = 0;i<400;i++){
+        if (i == 200){
+            ce->syntax = NULL;
+            editorUpdateSyntaxRange(ce, 0, ce->numRows);
+        }
+        erow *row = &ce->row[1];
+        ce->colOffset = rand() % 2 ? 0 : rand() % rowMxToRx(row, row->size);
+        int x = longRowBoundary(row, rand() % row->size);
+        if (rand() % 2){
+            int n;
+            testRandomText(buf, &n, longPieces, LONG_PIECES, 3);
+            editorInsertText(ce, 1, x, buf, n);
+        }else{
+            int end = longRowBoundary(row, x + 1 + rand() % 16);
+            if (end == x) end = x + 1;
+            editorDeleteRange(ce, 1, x, 1, end);
+        }
+        if (i % 4 == 0){
+            longRowCheck(ce);
+            if (testFailed()) return;
+        }
+    }
+}
@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tests.h"
+#include "ops.h"
+#include "coldRows.h"
+
+/*
+ Tests for the editor core, run against libcomettex without a terminal.
+ Each test gets a fresh buffer and the same random seed, so a failure repeats.
+
+ ./tests [NAME]
+ Only the tests with NAME in their name run when it's given.
+*/
+
+typedef struct testCase{
+    const char *name;
+    void (*run)(editorConfig *ce);
+} testCase;
+
+static testCase tests[] = {
+    {"undo round trip", testUndoRoundTrip},
+    {"undo trim", testUndoTrim},
+    {"multi newline", testMultiNewLine},
+    {"diff", testDiff},
+    {"syntax defer", testSyntaxDefer},
+    {"long row", testLongRow},
+    {"wrap tree", testWrapTree},
+    {"bracket tree", testBracketTree},
+    {"symbol pass", testSymbolPass},
+    {"filter undo", testFilterUndo},
+    {"filter undo trim", testFilterUndoTrim},
+    {"lz round trip", testLzRoundTrip},
+    {"cold rows", testColdRows},
+    {"session", testSession},
+};
+
+static int failed = 0;
+
+void die(const char *s){
+    perror(s);
+    exit(1);
+}
+
+void testFail(const char *file, int line, const char *what){
+    printf("  %s:%d: %s\n", file, line, what);
+    failed = 1;
+}
+
+//For helpers that CHECK, the caller has to leave too
+int testFailed(){
+    return failed;
+}
+
+//Replaces the buffer with the rows of text, a last row without '\n' counts too
+void testLoad(editorConfig *ce, const char *text){
+    editorFreeRows(ce);
+    while (*text){
+        const char *end = strchr(text, '\n');
+        size_t len = end ? (size_t)(end - text) : strlen(text);
+        editorInsertRow(ce, ce->numRows, (char *)text, len);
+        text += len + (end != NULL);
+    }
+    ce->dirty = 0;
+}
+
+//The whole buffer with every row ended by '\n'
+char *testText(editorConfig *ce, size_t *len){
+    size_t total = 0;
+    for (int i = 0;i<ce->numRows;i++) total += ce->row[i].size + 1;
+    char *s = malloc(total + 1);
+    char *p = s;
+    for (int i = 0;i<ce->numRows;i++){
+        memcpy(p, editorRowText(&ce->row[i]), ce->row[i].size);
+        p += ce->row[i].size;
+        *p++ = '\n';
+    }
+    *p = '\0';
+    *len = total;
+    return s;
+}
+
+int testSame(editorConfig *ce, const char *text, size_t len){
+    size_t got;
+    char *s = testText(ce, &got);
+    int same = got == len && memcmp(s, text, len) == 0;
+    free(s);
+    return same;
+}
+
+//Up to most pieces picked at random, buf needs room for all of them
+void testRandomText(char *buf, int *len, const char **pieces, int numPieces, int most){
+    int n = rand() % (most + 1);
+    *len = 0;
+    for (int i = 0;i<n;i++){
+        const char *p = pieces[rand() % numPieces];
+        size_t l = strlen(p);
+        memcpy(buf + *len, p, l);
+        *len += l;
+    }
+    buf[*len] = '\0';
+}
+
+int main(int argc, char *argv[]){
+    const char *only = argc > 1 ? argv[1] : NULL;
+    int failures = 0;
+
+    editorColdInit(0);
+    for (unsigned int i = 0;i<sizeof(tests) / sizeof(tests[0]);i++){
+        if (only && !strstr(tests[i].name, only)) continue;
+
+        editorConfig ce;
+        memset(&ce, 0, sizeof(ce));
+        ce.screenRow = 24;
+        ce.screenCol = 80;
+        ce.matchRow = -1;
+        srand(1);
+        failed = 0;
+
+        tests[i].run(&ce);
+        editorFreeRows(&ce);
+        printf("%-20s %s\n", tests[i].name, failed ? "FAIL" : "ok");
+        failures += failed;
+    }
+    return failures != 0;
+}
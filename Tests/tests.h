@@ -0,0 +1,36 @@
+#ifndef TESTS_H_
+#define TESTS_H_
+#include <stddef.h>
+#include "CometTex.h"
+
+//Fails the running test and leaves it, the rest still run
+#define CHECK(cond) do{ \
+    if (!(cond)){ \
+        testFail(__FILE__, __LINE__, #cond); \
+        return; \
+    } \
+}while(0)
+
+void testFail(const char *file, int line, const char *what);
+int testFailed();
+void testLoad(editorConfig *ce, const char *text);
+char *testText(editorConfig *ce, size_t *len);
+int testSame(editorConfig *ce, const char *text, size_t len);
+void testRandomText(char *buf, int *len, const char **pieces, int numPieces, int most);
+
+void testUndoRoundTrip(editorConfig *ce);
+void testUndoTrim(editorConfig *ce);
+void testMultiNewLine(editorConfig *ce);
+void testDiff(editorConfig *ce);
+void testSyntaxDefer(editorConfig *ce);
+void testLongRow(editorConfig *ce);
+void testWrapTree(editorConfig *ce);
+void testBracketTree(editorConfig *ce);
+void testSymbolPass(editorConfig *ce);
+void testFilterUndo(editorConfig *ce);
+void testFilterUndoTrim(editorConfig *ce);
+void testLzRoundTrip(editorConfig *ce);
+void testColdRows(editorConfig *ce);
+void testSession(editorConfig *ce);
+
+#endif
@@ -0,0 +1,254 @@
+#include <stdlib.h>
+#include <string.h>
+#include "tests.h"
+#include "ops.h"
+#include "undo.h"
+#include "coldRows.h"
+#include "wrap.h"
+#include "brackets.h"
+#include "syntaxHighlighting.h"
+#include "symbols.h"
+
+//Random edits of every kind that moves or changes rows, the trees have to follow all of them
+static void treeRandomEdit(editorConfig *ce, const char **pieces, int numPieces){
+    char buf[256];
+    int len;
+    int y = ce->numRows ? rand() % ce->numRows : 0;
+    testRandomText(buf, &len, pieces, numPieces, 6);
+
+    switch (rand() % 10){
+        case 0:
+        case 1:
+        case 2:
+            editorInsertText(ce, y, ce->numRows ? rand() % (ce->row[y].size + 1) : 0, buf, len);
+            break;
+        case 3:
+            if (ce->numRows){
+                int y1 = y + rand() % 3;
+                if (y1 >= ce->numRows) y1 = ce->numRows - 1;
+                editorDeleteRange(ce, y, 0, y1, rand() % (ce->row[y1].size + 1));
+            }
+            break;
+        case 4:
+            editorIndentLines(ce, y, 1 + rand() % 4);
+            break;
+        case 5:
+            editorJoinLines(ce, y, 2);
+            break;
+        case 6:
+            editorUndo(ce);
+            break;
+        case 7:
+            //Many rows at once, enough to split and merge whole nodes
+            editorYankLines(ce, y, 1 + rand() % 300);
+            editorPutLines(ce, ce->numRows ? rand() % ce->numRows : 0, 1 + rand() % 2);
+            break;
+        case 8:
+            editorDelLines(ce, y, 1 + rand() % 300);
+            break;
+        default:
+            editorInsertRow(ce, y, buf, strchr(buf, '\n') ? (size_t)(strchr(buf, '\n') - buf) : (size_t)len);
+            break;
+    }
+}
+
+static int wrapWidthOf(erow *row){
+    char *text = editorRowText(row);
+    int rx = 0;
+    for (int i = 0;i<row->size;i++){
+        if (text[i] == '\t') rx += COMETTEX_TAB_STOP - (rx % COMETTEX_TAB_STOP);
+        else if ((text[i] & 0xc0) != 0x80) rx++;
+    }
+    return rx;
+}
+
+//Every row starts where the lines above add up to, and every line maps back to its row
+static void wrapCheck(editorConfig *ce){
+    int line = 0;
+    for (int y = 0;y<ce->numRows;y++){
+        int w = wrapWidthOf(&ce->row[y]);
+        int n = w ? (w + ce->wrapWidth - 1) / ce->wrapWidth : 1;
+        CHECK(editorWrapLineOf(ce, y) == line);
+        for (int k = 0;k<n;k++){
+            int sub;
+            CHECK(editorWrapRowAt(ce, line + k, &sub) == y && sub == k);
+        }
+        line += n;
+    }
+    CHECK(editorWrapTotal(ce) == line);
+    int sub;
+    CHECK(editorWrapRowAt(ce, line + 3, &sub) == ce->numRows && sub == 3);
+}
+
+void testWrapTree(editorConfig *ce){
+    static const char *pieces[] = {"a", "\t", "bcdefgh", "\n", "xyz ", "\t\t", "0123456789012345678901234"};
+    ce->syntax = &HLDB[0];
+    editorWrapSetWidth(ce, 7);
+    for (int step = 0;step<5000;step++){
+        treeRandomEdit(ce, pieces, sizeof(pieces) / sizeof(pieces[0]));
+        if (rand() % 50 == 0) editorWrapSetWidth(ce, 1 + rand() % 30);
+        if (ce->numRows > 3000) editorDelLines(ce, rand() % 1000, 1500);
+        if (rand() % 20 == 0){
+            wrapCheck(ce);
+            if (testFailed()) return;
+        }
+    }
+}
+
+typedef struct treeBracket{
+    int y;
+    int x;
+    char c;
+} treeBracket;
+
+//Every row keeps what the lexer sees in it, and every bracket matches what pairing them all up
+//finds. Nothing in strings or comments matches
+static void bracketCheck(editorConfig *ce){
+    int n = 0, cap = 1024;
+    treeBracket *b = malloc(sizeof(treeBracket) * cap);
+    for (int y = 0;y<ce->numRows;y++){
+        bracketScan bs = {{0, 0, 0}, malloc(sizeof(int) * 16), 0, 16};
+        editorLexBrackets(ce, &ce->row[y], &bs);
+        char *text = editorRowText(&ce->row[y]);
+        bracketSummary *kept = &ce->row[y].brackets;
+        CHECK(kept->sum == bs.s.sum && kept->min == bs.s.min && kept->max == bs.s.max);
+        for (int k = 0;k<bs.numPos;k++){
+            if (n == cap){
+                cap *= 2;
+                b = realloc(b, sizeof(treeBracket) * cap);
+            }
+            b[n].y = y;
+            b[n].x = bs.pos[k];
+            b[n].c = text[bs.pos[k]];
+            n++;
+        }
+        free(bs.pos);
+    }
+
+    //All kinds count the same, so the pairs are what a stack of the opens makes of them
+    int *pair = malloc(sizeof(int) * (n + 1));
+    int *stack = malloc(sizeof(int) * (n + 1));
+    int depth = 0;
+    for (int i = 0;i<n;i++){
+        pair[i] = -1;
+        if (strchr("([{", b[i].c)){
+            stack[depth++] = i;
+        }else if (depth){
+            int j = stack[--depth];
+            char a = b[j].c, z = b[i].c;
+            if ((a == '(' && z == ')') || (a == '[' && z == ']') || (a == '{' && z == '}')){
+                pair[i] = j;
+                pair[j] = i;
+            }
+        }
+    }
+    free(stack);
+
+    for (int i = 0;i<n;i++){
+        int want = pair[i];
+        int my = -1, mx = -1;
+        int found = editorBracketMatch(ce, b[i].y, b[i].x, &my, &mx);
+        CHECK(found == (want != -1));
+        if (found) CHECK(my == b[want].y && mx == b[want].x);
+    }
+    free(pair);
+
+    for (int t = 0;t<50 && ce->numRows;t++){
+        int y = rand() % ce->numRows;
+        erow *row = &ce->row[y];
+        if (!row->size) continue;
+        int x = rand() % row->size;
+        if (!IS_BRACKET(editorRowText(row)[x])) continue;
+        int seen = 0;
+        for (int i = 0;i<n;i++) seen |= b[i].y == y && b[i].x == x;
+        int my, mx;
+        if (!seen) CHECK(!editorBracketMatch(ce, y, x, &my, &mx));
+    }
+    free(b);
+}
+
+void testBracketTree(editorConfig *ce){
+    static const char *pieces[] = {"(", "{", "[", ")", "}", "]", "\n", "\"(\"", "/*", "*/", "//x(", "a", "'['", "\t", "f(x)", "{\n}"};
+    ce->syntax = &HLDB[0];
+    for (int i = 0;i<600;i++){
+        char buf[64];
+        int len;
+        testRandomText(buf, &len, pieces, 6, 3);
+        editorInsertRow(ce, ce->numRows, buf, len);
+    }
+    for (int step = 0;step<3000;step++){
+        treeRandomEdit(ce, pieces, sizeof(pieces) / sizeof(pieces[0]));
+        if (ce->numRows > 1500) editorDelLines(ce, 0, 150);
+        if (rand() % 30 == 0){
+            bracketCheck(ce);
+            if (testFailed()) return;
+        }
+    }
+
+    //Long rows are only lexed a piece at a time, pairs can be far apart in one
+    char *text = malloc(COMETTEX_LONG_LINE + 64);
+    for (int r = 0;r<2;r++){
+        int len = 0;
+        while (len < COMETTEX_LONG_LINE){
+            //Mostly filler, or every bracket would be lexed a piece over
+            const char *p = (rand() % 64) ? "a" : pieces[rand() % 6];
+            memcpy(&text[len], p, strlen(p));
+            len += strlen(p);
+        }
+        editorInsertRow(ce, rand() % ce->numRows, text, len);
+    }
+    free(text);
+    for (int step = 0;step<3;step++){
+        bracketCheck(ce);
+        if (testFailed()) return;
+        treeRandomEdit(ce, pieces, sizeof(pieces) / sizeof(pieces[0]));
+    }
+}
+
+//Every row the pass looked at against looking at all of them again
+static void symbolCheck(editorConfig *ce){
+    while (editorSymbolsIndex(ce, COMETTEX_SYMBOL_SLICE));
+    int n = ce->numRows;
+    unsigned char *kind = malloc(n);
+    for (int y = 0;y<n;y++){
+        kind[y] = ce->row[y].symKind;
+        editorSymbolsRowChanged(ce, &ce->row[y]);
+    }
+    while (editorSymbolsIndex(ce, COMETTEX_SYMBOL_SLICE));
+    int same = 1;
+    for (int y = 0;y<n;y++){
+        same = same && kind[y] == ce->row[y].symKind && kind[y] != SYMBOL_UNSCANNED;
+    }
+    free(kind);
+    CHECK(same);
+}
+
+//The pass only looks at rows that changed or came in, rows that moved keep what it found
+void testSymbolPass(editorConfig *ce){
+    static const char *pieces[] = {"int f(void){", "}", "\n", "struct s {", "#define X 1", "  x = 1;", "a", "(", "\t", "} t;"};
+    for (int i = 0;i<3000;i++){
+        char buf[128];
+        int len;
+        testRandomText(buf, &len, pieces, 2, 2);
+        editorInsertRow(ce, ce->numRows, buf, len);
+    }
+    while (editorSymbolsIndex(ce, COMETTEX_SYMBOL_SLICE));
+
+    //One row to look at is one row, however far the rest go
+    editorInsertText(ce, 10, 0, "int g(", 6);
+    CHECK(!editorSymbolsIndex(ce, 1));
+    editorInsertRow(ce, 0, "x", 1);
+    editorDelRows(ce, 5, 2);
+    CHECK(!editorSymbolsIndex(ce, 1));
+    CHECK(ce->row[11].symKind == SYMBOL_FUNCTION);
+
+    for (int step = 0;step<1000;step++){
+        treeRandomEdit(ce, pieces, sizeof(pieces) / sizeof(pieces[0]));
+        if (ce->numRows > 3000) editorDelLines(ce, 0, 150);
+        editorSymbolsIndex(ce, rand() % 8);
+        if (rand() % 100 == 0){
+            symbolCheck(ce);
+            if (testFailed()) return;
+        }
+    }
+}
@@ -0,0 +1,187 @@
+#include <stdlib.h>
+#include <string.h>
+#include "tests.h"
+#include "ops.h"
+#include "undo.h"
+#include "replace.h"
+#include "cursors.h"
+
+static const char *pieces[] = {"a", "bc", "\t", "\n", "word ", "é", "\n\n", "{x}"};
+#define NUM_PIECES (int)(sizeof(pieces) / sizeof(pieces[0]))
+
+//One random change of the kinds the editor makes, always at least one undo step if anything changed
+static void undoRandomEdit(editorConfig *ce){
+    char buf[128];
+    int len;
+    int y = ce->numRows ? rand() % ce->numRows : 0;
+    int x = ce->numRows ? rand() % (ce->row[y].size + 1) : 0;
+
+    switch (rand() % 8){
+        case 0:
+            testRandomText(buf, &len, pieces, NUM_PIECES, 6);
+            editorInsertText(ce, y, x, buf, len);
+            break;
+        case 1:
+            if (ce->numRows){
+                int y1 = y + rand() % 3;
+                if (y1 >= ce->numRows) y1 = ce->numRows - 1;
+                int x1 = rand() % (ce->row[y1].size + 1);
+                if (y1 == y && x1 < x) x1 = x;
+                editorDeleteRange(ce, y, x, y1, x1);
+            }
+            break;
+        case 2:
+            if (rand() % 2) editorIndentLines(ce, y, 1 + rand() % 4);
+            else editorOutdentLines(ce, y, 1 + rand() % 4);
+            break;
+        case 3:
+            editorJoinLines(ce, y, 2 + rand() % 2);
+            break;
+        case 4:
+            editorDelLines(ce, y, 1 + rand() % 3);
+            break;
+        case 5:
+            editorYankLines(ce, y, 1 + rand() % 3);
+            editorPutLines(ce, ce->numRows ? rand() % (ce->numRows + 1) : 0, 1 + rand() % 2);
+            break;
+        default:
+            //A run of typing or of backspace is merged into one change until the seal
+            ce->my = y;
+            ce->mx = x;
+            int typing = rand() % 2;
+            for (int i = rand() % 12;i>0;i--){
+                if (!typing) editorDelChar(ce);
+                else if (rand() % 6 == 0) editorInsertNewLine(ce);
+                else editorInsertChar(ce, 'a' + rand() % 5);
+            }
+            break;
+    }
+    editorUndoSeal();
+}
+
+//Every change undone one at a time goes back through the same buffers, and redo comes forward again
+void testUndoRoundTrip(editorConfig *ce){
+    for (int round = 0;round<20;round++){
+        testLoad(ce, "int main(){\n\treturn 0;\n}\n\nstatic int x;\n");
+        int steps = 0;
+        char *snap[101];
+        size_t snapLen[101];
+        snap[0] = testText(ce, &snapLen[0]);
+
+        for (int i = 0;i<100;i++){
+            undoRandomEdit(ce);
+            size_t len;
+            char *s = testText(ce, &len);
+            if (len == snapLen[steps] && memcmp(s, snap[steps], len) == 0){
+                free(s);
+                continue;
+            }
+            steps++;
+            snap[steps] = s;
+            snapLen[steps] = len;
+        }
+
+        for (int i = steps - 1;i>=0;i--){
+            CHECK(editorUndo(ce));
+            CHECK(testSame(ce, snap[i], snapLen[i]));
+        }
+        CHECK(!editorUndo(ce));
+        for (int i = 1;i<=steps;i++){
+            CHECK(editorRedo(ce));
+            CHECK(testSame(ce, snap[i], snapLen[i]));
+        }
+        CHECK(!editorRedo(ce));
+        for (int i = 0;i<=steps;i++) free(snap[i]);
+    }
+}
+
+//A change bigger than COMETTEX_UNDO_BYTES on top of older ones, the older ones make room
+//and the big one is undone whole
+void testUndoTrim(editorConfig *ce){
+    char row[64];
+    memset(row, 'a', sizeof(row));
+    int rows = COMETTEX_UNDO_BYTES / sizeof(row);
+    for (int i = 0;i<rows;i++) editorInsertRow(ce, ce->numRows, row, sizeof(row));
+    for (int i = 0;i<rows;i += rows / 10){
+        editorInsertText(ce, i, 0, "old ", 4);
+        editorUndoSeal();
+    }
+
+    size_t beforeLen;
+    char *before = testText(ce, &beforeLen);
+    int changed;
+    editorReplaceAll(ce, "a", "b", &changed);
+    CHECK(changed == rows);
+    size_t afterLen;
+    char *after = testText(ce, &afterLen);
+
+    undoStats st;
+    editorUndoGetStats(&st);
+    CHECK(st.textBytes > COMETTEX_UNDO_BYTES);
+    CHECK(editorUndo(ce));
+    CHECK(testSame(ce, before, beforeLen));
+    CHECK(editorRedo(ce));
+    CHECK(testSame(ce, after, afterLen));
+
+    //The next change drops the big one whole, never half of it
+    editorInsertText(ce, 0, 0, "new ", 4);
+    editorUndoSeal();
+    CHECK(editorUndo(ce));
+    CHECK(testSame(ce, after, afterLen));
+    CHECK(!editorUndo(ce));
+    free(before);
+    free(after);
+}
+
+static int multiCursorCmp(const void *a, const void *b){
+    const editorCursor *x = a, *y = b;
+    if (x->my != y->my) return y->my - x->my;
+    return y->mx - x->mx;
+}
+
+//A newline at every cursor splits each row once, and comes out as a newline typed at each
+//of them bottom up would, undone and redone as one change
+void testMultiNewLine(editorConfig *ce){
+    char buf[512];
+    for (int round = 0;round<50;round++){
+        int len;
+        testRandomText(buf, &len, pieces, NUM_PIECES, 60);
+        testLoad(ce, buf);
+        if (ce->numRows == 0) continue;
+        ce->my = rand() % ce->numRows;
+        ce->mx = 0;
+        if (editorCursorsFromMatches(ce, rand() % 2 ? "a" : "b") == 0) continue;
+        editorUndoSeal();
+
+        size_t beforeLen;
+        char *before = testText(ce, &beforeLen);
+        int n = ce->numCursors + 1;
+        editorCursor *all = malloc(sizeof(editorCursor) * n);
+        memcpy(all, ce->cursors, sizeof(editorCursor) * ce->numCursors);
+        all[n - 1].my = ce->my;
+        all[n - 1].mx = ce->mx;
+        qsort(all, n, sizeof(editorCursor), multiCursorCmp);
+        editorUndoBeginGroup();
+        for (int i = 0;i<n;i++) editorInsertText(ce, all[i].my, all[i].mx, "\n", 1);
+        editorUndoEndGroup();
+        editorUndoSeal();
+        size_t wantLen;
+        char *want = testText(ce, &wantLen);
+        CHECK(editorUndo(ce));
+        CHECK(testSame(ce, before, beforeLen));
+
+        editorMultiInsertNewLine(ce);
+        editorUndoSeal();
+        CHECK(testSame(ce, want, wantLen));
+        CHECK(ce->mx == 0);
+        CHECK(ce->numCursors == n - 1);
+        for (int i = 0;i<ce->numCursors;i++) CHECK(ce->cursors[i].mx == 0);
+        CHECK(editorUndo(ce));
+        CHECK(testSame(ce, before, beforeLen));
+        CHECK(editorRedo(ce));
+        CHECK(testSame(ce, want, wantLen));
+        free(all);
+        free(before);
+        free(want);
+    }
+}
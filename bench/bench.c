@@ -0,0 +1,320 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "CometTex.h"
+#include "ops.h"
+#include "fileIO.h"
+#include "syntaxHighlighting.h"
+#include "coldRows.h"
+#include "undo.h"
+#include "replace.h"
+
+/*
+ Benchmarks for the editor core, run against libcomettex without a terminal.
+ Files of a few kinds are generated at sizes from 1KB up to --max, then each one is
+ loaded, searched, typed into from a keystroke script, undone, replaced, pasted into and
+ saved. Every operation is timed on its own and reported as latency percentiles.
+
+ ./bench [--max SIZE] [--kinds plain,long,tabs,comments] [--dir DIR] [--budget MB] [--keep]
+ SIZE takes K, M and G suffixes, the default stops at 16M.
+*/
+
+typedef struct samples{
+    const char *name;
+    double *ns;
+    int n;
+    int cap;
+} samples;
+
+typedef struct benchKind{
+    const char *name;
+    //Appends about one line to f, returns the bytes written
+    size_t (*line)(FILE *f, long i);
+} benchKind;
+
+static const char *dir = NULL;
+static int keep = 0;
+
+//Program code, the common case
+static size_t benchLinePlain(FILE *f, long i){
+    return fprintf(f, "    int value%ld = compute(value%ld, \"label %ld\"); // step %ld\n", i, i / 2, i % 97, i);
+}
+
+//Rows far over COMETTEX_LONG_LINE, like minified files or logs
+static size_t benchLineLong(FILE *f, long i){
+    size_t len = 0;
+    for (int k = 0;k<20000;k++) len += fprintf(f, "f(%ld,%d) ", i, k);
+    fputc('\n', f);
+    return len + 1;
+}
+
+static size_t benchLineTabs(FILE *f, long i){
+    return fprintf(f, "\t\t\tkey%ld\t\tvalue\t%ld\t\t\t// %ld\t\n", i, i * 7, i % 13);
+}
+
+//Comments opening on one row and closing rows later, and comment starts inside comments
+static size_t benchLineComments(FILE *f, long i){
+    switch (i % 6){
+        case 0: return fprintf(f, "/* block %ld /* nested start\n", i);
+        case 1: return fprintf(f, "   still comment %ld \"not a string\n", i);
+        case 2: return fprintf(f, "   end */ int x%ld = 1; /* inline */ int y;\n", i);
+        case 3: return fprintf(f, "char *s%ld = \"/* not a comment */\";\n", i);
+        case 4: return fprintf(f, "// line comment %ld /* also ignored\n", i);
+        default: return fprintf(f, "call(%ld); /* */ /**/ x /= 2;\n", i);
+    }
+}
+
+static benchKind kinds[] = {
+    {"plain", benchLinePlain},
+    {"long", benchLineLong},
+    {"tabs", benchLineTabs},
+    {"comments", benchLineComments},
+};
+
+#define BENCH_KINDS (sizeof(kinds) / sizeof(kinds[0]))
+
+void die(const char *s){
+    perror(s);
+    exit(1);
+}
+
+static double benchNow(){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void samplesAdd(samples *s, double ns){
+    if (s->n == s->cap){
+        s->cap = s->cap ? s->cap * 2 : 64;
+        s->ns = realloc(s->ns, sizeof(double) * s->cap);
+    }
+    s->ns[s->n++] = ns;
+}
+
+static int benchCmp(const void *a, const void *b){
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double samplesPct(samples *s, double p){
+    int i = (int)(p * s->n + 0.999999) - 1;
+    if (i < 0) i = 0;
+    if (i >= s->n) i = s->n - 1;
+    return s->ns[i];
+}
+
+static const char *benchFmtTime(double ns, char *buf){
+    if (ns < 1e3) sprintf(buf, "%.0fns", ns);
+    else if (ns < 1e6) sprintf(buf, "%.1fus", ns / 1e3);
+    else if (ns < 1e9) sprintf(buf, "%.2fms", ns / 1e6);
+    else sprintf(buf, "%.2fs", ns / 1e9);
+    return buf;
+}
+
+static const char *benchFmtSize(long long size, char *buf){
+    if (size >= 1LL << 30) sprintf(buf, "%lldG", size >> 30);
+    else if (size >= 1 << 20) sprintf(buf, "%lldM", size >> 20);
+    else sprintf(buf, "%lldK", size >> 10);
+    return buf;
+}
+
+static void samplesReport(samples *s){
+    if (s->n == 0) return;
+    qsort(s->ns, s->n, sizeof(double), benchCmp);
+    char a[32], b[32], c[32], d[32];
+    printf("  %-8s %7d %10s %10s %10s %10s\n", s->name, s->n,
+        benchFmtTime(samplesPct(s, 0.5), a), benchFmtTime(samplesPct(s, 0.9), b),
+        benchFmtTime(samplesPct(s, 0.99), c), benchFmtTime(s->ns[s->n - 1], d));
+    free(s->ns);
+    s->ns = NULL;
+    s->n = s->cap = 0;
+}
+
+static long long benchParseSize(const char *s){
+    char *end;
+    long long n = strtoll(s, &end, 10);
+    switch (*end){
+        case 'k': case 'K': return n << 10;
+        case 'm': case 'M': return n << 20;
+        case 'g': case 'G': return n << 30;
+    }
+    return n;
+}
+
+static void benchGenerate(const char *path, benchKind *k, long long size){
+    FILE *f = fopen(path, "w");
+    if (f == NULL) die(path);
+    long long written = 0;
+    for (long i = 0; written < size;i++) written += k->line(f, i);
+    if (fclose(f) != 0) die(path);
+}
+
+static void benchOpen(editorConfig *ce, char *path){
+    editorOpen(ce, path);
+    editorSelectSyntaxHighlight(ce);
+    ce->my = ce->mx = 0;
+    ce->rowOffset = ce->colOffset = 0;
+}
+
+//Find next, like the search prompt going down one match at a time
+static void benchFindNext(editorConfig *ce, const char *query){
+    for (int i = 1;i<=ce->numRows;i++){
+        int y = (ce->my + i) % ce->numRows;
+        char *text = editorRowText(&ce->row[y]);
+        char *match = strstr(text, query);
+        if (match){
+            ce->my = y;
+            ce->mx = match - text;
+            return;
+        }
+    }
+}
+
+//A keystroke as the insert mode handler applies it, '\r' is enter and 127 backspace
+static void benchKey(editorConfig *ce, int c){
+    if (c == '\r') editorInsertNewLine(ce);
+    else if (c == 127) editorDelChar(ce);
+    else editorInsertChar(ce, c);
+    //The main loop trims after every key
+    editorColdTrim(ce);
+}
+
+static const char *script =
+    "for (int i = 0; i < n; i++){\r"
+    "\tsum += values[i]; /* running total */\r"
+    "}\r"
+    "typo\x7f\x7f\x7f\x7f"
+    "char *msg = \"done\";\r";
+
+static void benchFile(char *path, long long size, benchKind *k){
+    editorConfig ce;
+    memset(&ce, 0, sizeof(ce));
+    ce.screenRow = 50;
+    ce.screenCol = 120;
+    ce.matchRow = -1;
+
+    samples load = {"load"}, find = {"find"}, type = {"type"}, undo = {"undo"};
+    samples replace = {"replace"}, put = {"put"}, save = {"save"};
+
+    //Small files are loaded a few times so the percentiles mean something
+    int loads = size <= (1 << 20) ? 10 : 1;
+    for (int i = 0;i<loads;i++){
+        double t = benchNow();
+        benchOpen(&ce, path);
+        samplesAdd(&load, benchNow() - t);
+    }
+
+    for (int i = 0;i<200;i++){
+        double t = benchNow();
+        benchFindNext(&ce, "7");
+        samplesAdd(&find, benchNow() - t);
+    }
+
+    //Type the script a few times in the middle of the file
+    ce.my = ce.numRows / 2;
+    ce.mx = 0;
+    editorUndoSeal();
+    for (int r = 0;r<20;r++){
+        for (const char *p = script; *p;p++){
+            double t = benchNow();
+            benchKey(&ce, (unsigned char)*p);
+            samplesAdd(&type, benchNow() - t);
+        }
+    }
+    editorUndoSeal();
+    for (int i = 0;i<100;i++){
+        double t = benchNow();
+        int done = editorUndo(&ce);
+        samplesAdd(&undo, benchNow() - t);
+        if (!done) break;
+    }
+
+    for (int i = 0;i<4;i++){
+        int rows;
+        double t = benchNow();
+        if (i % 2 == 0) editorReplaceAll(&ce, "1", "one", &rows);
+        else editorReplaceAll(&ce, "one", "1", &rows);
+        samplesAdd(&replace, benchNow() - t);
+    }
+
+    //1000 rows, or what the file has, yanked once and put again and again
+    editorYankLines(&ce, 0, 1000);
+    for (int i = 0;i<10;i++){
+        double t = benchNow();
+        editorPutLines(&ce, ce.numRows / 2, 1);
+        samplesAdd(&put, benchNow() - t);
+    }
+
+    char out[4096];
+    snprintf(out, sizeof(out), "%s.out", path);
+    free(ce.filename);
+    ce.filename = strdup(out);
+    int saves = size <= (1 << 20) ? 10 : 1;
+    for (int i = 0;i<saves;i++){
+        double t = benchNow();
+        if (editorWriteFile(&ce) == -1) die(out);
+        samplesAdd(&save, benchNow() - t);
+    }
+    if (!keep) unlink(out);
+
+    samplesReport(&load);
+    samplesReport(&find);
+    samplesReport(&type);
+    samplesReport(&undo);
+    samplesReport(&replace);
+    samplesReport(&put);
+    samplesReport(&save);
+
+    editorFreeRows(&ce);
+    free(ce.filename);
+}
+
+int main(int argc, char *argv[]){
+    long long max = 16LL << 20;
+    const char *only = NULL;
+    size_t budget = 0;
+
+    for (int i = 1;i<argc;i++){
+        if (!strcmp(argv[i], "--max") && i + 1 < argc) max = benchParseSize(argv[++i]);
+        else if (!strcmp(argv[i], "--kinds") && i + 1 < argc) only = argv[++i];
+        else if (!strcmp(argv[i], "--dir") && i + 1 < argc) dir = argv[++i];
+        else if (!strcmp(argv[i], "--budget") && i + 1 < argc) budget = (size_t)atol(argv[++i]) * 1024 * 1024;
+        else if (!strcmp(argv[i], "--keep")) keep = 1;
+        else{
+            fprintf(stderr, "Usage: %s [--max SIZE] [--kinds plain,long,tabs,comments] [--dir DIR] [--budget MB] [--keep]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    char tmp[] = "/tmp/comettex-bench-XXXXXX";
+    if (dir == NULL){
+        dir = mkdtemp(tmp);
+        if (dir == NULL) die("mkdtemp");
+    }
+    editorColdInit(budget);
+
+    long long sizes[] = {1LL << 10, 64LL << 10, 1LL << 20, 16LL << 20, 256LL << 20, 1LL << 30};
+    for (unsigned int k = 0;k<BENCH_KINDS;k++){
+        if (only && !strstr(only, kinds[k].name)) continue;
+        for (unsigned int s = 0;s<sizeof(sizes) / sizeof(sizes[0]);s++){
+            if (sizes[s] > max) break;
+
+            char path[4096], sz[32];
+            benchFmtSize(sizes[s], sz);
+            snprintf(path, sizeof(path), "%s/%s-%s.c", dir, kinds[k].name, sz);
+            benchGenerate(path, &kinds[k], sizes[s]);
+
+            printf("%s %s\n", kinds[k].name, sz);
+            printf("  %-8s %7s %10s %10s %10s %10s\n", "op", "count", "p50", "p90", "p99", "max");
+            benchFile(path, sizes[s], &kinds[k]);
+            fflush(stdout);
+
+            if (!keep) unlink(path);
+        }
+    }
+    if (!keep && dir == tmp) rmdir(dir);
+    return 0;
+}
@@ -13,6 +13,9 @@
 #include <unistd.h>
 #include <time.h>
 #include <sys/ioctl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
 #include "CometTex.h"
 #include "appendBuffer.h"
 #include "rawmode.h"
@@ -20,6 +23,24 @@
 #include "fileIO.h"
 #include "command.h"
 #include "syntaxHighlighting.h"
+#include "utf8.h"
+#include "coldRows.h"
+#include "undo.h"
+#include "cursors.h"
+#include "macro.h"
+#include "perf.h"
+#include "stats.h"
+#include "wrap.h"
+#include "symbols.h"
+#include "brackets.h"
+#include "server.h"
+#include "session.h"
+#include "diff.h"
+#include "window.h"
+
+static editorConfig E;
+//Latency numbers in the status bar, :perf toggles them
+static int perfHud = 0;
 
 void die(const char *s){
     //Clear the entire screen
@@ -30,14 +51,51 @@ void die(const char *s){
     exit(1);
 }
 
+//Where the cursor goes on the screen, worked out by editorScroll
+static int cursorScreenRow = 0;
+static int cursorScreenCol = 0;
+
+//Scrolling with soft wrap, the screen moves by screen lines instead of rows
+static void editorScrollWrapped(){
+    int w = E.wrapWidth;
+    int line = editorWrapLineOf(&E, E.my);
+    int col = E.rx;
+    if (E.my < E.numRows){
+        //The end of a row exactly wrapWidth wide stays on its last line
+        int sub = E.rx / w;
+        int lines = editorWrapRowLines(&E, &E.row[E.my]);
+        if (sub >= lines) sub = lines - 1;
+        line += sub;
+        col -= sub * w;
+    }
+
+    if (line < E.lineOffset){
+        E.lineOffset = line;
+    }
+    if (line >= E.lineOffset + E.screenRow){
+        E.lineOffset = line - E.screenRow + 1;
+    }
+    int sub;
+    E.rowOffset = editorWrapRowAt(&E, E.lineOffset, &sub);
+    E.colOffset = 0;
+    cursorScreenRow = line - E.lineOffset;
+    cursorScreenCol = col;
+}
+
 void editorScroll(){
     //Editor's render X is 0
     E.rx = 0;
     
     if (E.my < E.numRows){
+        editorRowThaw(&E, &E.row[E.my]);
         E.rx = rowMxToRx(&E.row[E.my], E.mx);
     }
 
+    if (E.wrapWidth){
+        editorScrollWrapped();
+        return;
+    }
+
     //Vertical Scrolling
     if (E.my < E.rowOffset){
         E.rowOffset = E.my;
@@ -47,18 +105,188 @@ void editorScroll(){
     }
     //Horizontal Scrolling
     if (E.rx < E.colOffset){
-        E.colOffset = E.mx;
+        E.colOffset = E.rx;
     }
     if (E.rx >= E.colOffset + E.screenCol){
         E.colOffset = E.rx - E.screenCol + 1;
     }
+    cursorScreenRow = E.my - E.rowOffset;
+    cursorScreenCol = E.rx - E.colOffset;
+}
+
+//The cursor's bracket and the one it pairs with, found once a frame. Rows are -1 for none
+static int bracketRow[2] = {-1, -1};
+static int bracketMx[2];
+
+static void editorFindBracketPair(){
+    bracketRow[0] = bracketRow[1] = -1;
+    if (editorBracketMatch(&E, E.my, E.mx, &bracketRow[1], &bracketMx[1])){
+        bracketRow[0] = E.my;
+        bracketMx[0] = E.mx;
+    }
+}
+
+//Draws render columns [left, left + screenCol) of a row. The search match, the bracket pair and
+//the extra cursors only show in the current window
+static void editorDrawRowSlice(struct abuf *ab, int fileRow, int left, int current){
+    erow *row = &E.row[fileRow];
+    editorRowThaw(&E, row);
+    editorRowEnsureWindow(&E, row, left);
+
+    //Start from the char under left, it can begin left of the screen
+    int mx = rowRxtoMx(row, left);
+    int col = rowMxToRx(row, mx);
+    int rbstart = row->longRow ? row->longRow->rbstart : 0;
+    int rb = rowMxToRb(row, mx) - rbstart;
+    int end = left + E.screenCol;
+    char *c = row->render;
+
+    //The search match is drawn on top of the row's spans
+    int matchFrom = -1, matchTo = -1;
+    if (current && fileRow == E.matchRow){
+        matchFrom = rowMxToRb(row, E.matchMx) - rbstart;
+        matchTo = rowMxToRb(row, E.matchMx + E.matchLen) - rbstart;
+    }
+
+    //The bracket under the cursor and its pair
+    int pairRb[2] = {-1, -1};
+    for (int k = 0;k<2;k++){
+        if (current && fileRow == bracketRow[k]) pairRb[k] = rowMxToRb(row, bracketMx[k]) - rbstart;
+    }
+
+    //Extra cursors on this row, drawn inverted
+    int ci = current ? editorCursorsFirstOnRow(&E, fileRow) : E.numCursors;
+    while (ci < E.numCursors && E.cursors[ci].my == fileRow && rowMxToRb(row, E.cursors[ci].mx) - rbstart < rb) ci++;
+    int cursorRb = (ci < E.numCursors && E.cursors[ci].my == fileRow) ? rowMxToRb(row, E.cursors[ci].mx) - rbstart : -1;
+
+    //First span that isn't over yet
+    hlSpan *sp = row->hl;
+    int si = 0;
+    int lo = 0, hi = row->numHl;
+    while (lo < hi){
+        int mid = (lo + hi) / 2;
+        if (sp[mid].start + sp[mid].len <= rb) lo = mid + 1;
+        else hi = mid;
+    }
+    si = lo;
+
+    //Chars with the same color are appended together
+    int runStart = rb, runLen = 0;
+    int curColor = -1;
+    while (rb < row->rsize && col < end){
+        int cp;
+        int n = utf8Decode(&c[rb], row->rsize - rb, &cp);
+        int ctrl = cp < 32 || cp == 127 || (cp >= 0x80 && cp < 0xA0);
+        int w = ctrl ? 1 : utf8CharWidth(cp);
+
+        while (si < row->numHl && sp[si].start + sp[si].len <= rb) si++;
+        int hl = (si < row->numHl && sp[si].start <= rb) ? sp[si].hl : HL_NORMAL;
+        if ((rb >= matchFrom && rb < matchTo) || rb == pairRb[0] || rb == pairRb[1]) hl = HL_MATCH;
+        int color = (hl == HL_NORMAL) ? -1 : editorSyntaxToColor(hl);
+
+        int isCursor = (rb == cursorRb);
+        if (ctrl || isCursor || col < left || col + w > end || color != curColor){
+            abAppend(ab, &c[runStart], runLen);
+            runLen = 0;
+        }
+        if (isCursor){
+            ci++;
+            cursorRb = (ci < E.numCursors && E.cursors[ci].my == fileRow) ? rowMxToRb(row, E.cursors[ci].mx) - rbstart : -1;
+        }
+
+        if (col < left || col + w > end){
+            //A wide char cut by the edge of the screen, fill what's visible of it
+            int from = (col < left) ? left : col;
+            int to = (col + w > end) ? end : col + w;
+            while (from++ < to) abAppend(ab, " ", 1);
+        }else if (ctrl){
+            char s = (cp >= 0 && cp <= 26) ? '@' + cp : '?';
+            abAppend(ab, "\x1b[7m", 4);//Invert the colors
+            abAppend(ab, &s, 1);
+            abAppend(ab, "\x1b[m", 3);//Invert the colors back to normal
+            //"\x1b[m" turns off all text formatting even text colors
+            //So let's change it to the current color again
+            if (curColor != -1){
+                char buf[16];
+                int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", curColor);
+                abAppend(ab, buf, clen);
+            }
+        }else{
+            if (color != curColor){
+                curColor = color;
+                if (color == -1){
+                    abAppend(ab, "\x1b[39m", 5);
+                }else{
+                    char buf[16];
+                    int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", color);
+                    abAppend(ab, buf, clen);
+                }
+            }
+            if (isCursor){
+                abAppend(ab, "\x1b[7m", 4);
+                abAppend(ab, &c[rb], n);
+                abAppend(ab, "\x1b[27m", 5);
+            }else{
+                if (runLen == 0) runStart = rb;
+                runLen += n;
+            }
+        }
+        col += w;
+        rb += n;
+    }
+    abAppend(ab, &c[runStart], runLen);
+    //A cursor at the end of the row sits on the cell after it
+    if (rb == cursorRb && rb == row->rsize && col < end && col >= left){
+        abAppend(ab, "\x1b[7m \x1b[27m", 10);
+    }
+    abAppend(ab, "\x1b[39m", 5);
 }
 
-void editorDrawRow(struct abuf *ab){
-    for(int i = 0;i<E.screenRow;i++){
-        int fileRow = i + E.rowOffset;
+//The diff marker of a row, only on the first screen line it takes
+static void editorDrawGutter(struct abuf *ab, int fileRow, int first){
+    int mark = (first && fileRow < E.numRows) ? editorDiffMark(&E, fileRow) : DIFF_NONE;
+    switch (mark & DIFF_KIND_MASK){
+        case DIFF_ADDED: abAppend(ab, "\x1b[32m+", 6); break;
+        case DIFF_MODIFIED: abAppend(ab, "\x1b[33m~", 6); break;
+        default:
+            if (mark & DIFF_DELETED_BELOW) abAppend(ab, "\x1b[31m_", 6);
+            else if (mark & DIFF_DELETED_ABOVE) abAppend(ab, "\x1b[31m\xe2\x80\xbe", 8);
+            else{
+                abAppend(ab, "  ", 2);
+                return;
+            }
+    }
+    abAppend(ab, "\x1b[39m ", 6);
+}
+
+//Draws the text of window w, returns the row after the last one it shows
+int editorDrawRow(struct abuf *ab, int w){
+    editorWindow *win = &E.windows[w];
+    char pos[32];
+    int posLen = snprintf(pos, sizeof(pos), "\x1b[%d;1H", win->top + 1);
+    abAppend(ab, pos, posLen);
+
+    //With soft wrap each screen line is the next slice of a row, starting from the top line
+    int wrapRow = 0, wrapSub = 0;
+    if (E.wrapWidth) editorWindowTopRow(&E, w, &wrapRow, &wrapSub);
+
+    int fileRow = win->rowOffset;
+    for(int i = 0;i<win->height;i++){
+        fileRow = i + win->rowOffset;
+        int left = win->colOffset;
+        int first = 1;
+        if (E.wrapWidth){
+            first = (wrapSub == 0);
+            fileRow = wrapRow;
+            left = wrapSub * E.wrapWidth;
+            if (wrapRow < E.numRows && ++wrapSub >= editorWrapRowLines(&E, &E.row[wrapRow])){
+                wrapRow++;
+                wrapSub = 0;
+            }
+        }
+        editorDrawGutter(ab, fileRow, first);
         if (fileRow >= E.numRows){
-            if (E.numRows == 0 && i == E.screenRow / 3){
+            if (E.numRows == 0 && i == win->height / 3){
                 char welcome[124];
                 int welcomeLen = snprintf(welcome, sizeof(welcome), "CometTex Editor -- Version %s", "0.0.1");
                 if (welcomeLen > E.screenCol){
@@ -75,62 +303,48 @@ void editorDrawRow(struct abuf *ab){
                 abAppend(ab, "~", 1);
             }
         }else{
-            int len = E.row[fileRow].rsize - E.colOffset;
-            if (len < 0) len = 0;
-            if (len > E.screenCol) len = E.screenCol;
-            char *c = &E.row[fileRow].render[E.colOffset];
-            unsigned char *hl = &E.row[fileRow].hl[E.colOffset];
-            int curColor = -1;
-            for (int i = 0;i<len;i++){
-                if (iscntrl(c[i])){
-                    char s = (c[i] <= 26) ? '@' + c[i] : '?';
-                    abAppend(ab, "\x1b[7m", 4);//Invert the colors
-                    abAppend(ab, &s, 1);
-                    abAppend(ab, "\x1b[m", 3);//Invert the colors back to normal
-                    //"\x1b[m" turns off all text formatting even text colors
-                    //So let's change it to the current color again
-                    if (curColor != -1){
-                        char buf[16];
-                        int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", curColor);
-                        abAppend(ab, buf, clen);
-                    }
-
-                }else if (hl[i] == HL_NORMAL){
-                    if (curColor != -1){
-                        abAppend(ab, "\x1b[39m", 5);
-                        curColor = -1;
-                    }
-                    abAppend(ab, &c[i], 1);
-                }else{
-                    int color = editorSyntaxToColor(hl[i]);
-                    if (color != curColor){
-                        curColor = color;
-                        char buf[16];
-                        int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", color);
-                        abAppend(ab, buf, clen);
-                    }
-                    abAppend(ab, &c[i], 1);
-                }
-            }
-            abAppend(ab, "\x1b[39m", 5);
+            editorDrawRowSlice(ab, fileRow, left, w == E.curWindow);
         }
 
         abAppend(ab, "\x1b[K", 3);
         abAppend(ab, "\r\n", 2);
     }
+    return (fileRow >= E.numRows) ? INT_MAX : fileRow + 1;
 }
 
-void editorDrawStatusBar(struct abuf *ab){
-    abAppend(ab, "\x1b[7m", 4);
+//The status bar under window w, the current window's is the bright one
+void editorDrawStatusBar(struct abuf *ab, int w){
+    editorWindow *win = &E.windows[w];
+    int current = (w == E.curWindow);
+    char pos[32];
+    int posLen = snprintf(pos, sizeof(pos), "\x1b[%d;1H", win->top + win->height + 1);
+    abAppend(ab, pos, posLen);
+    if (current){
+        abAppend(ab, "\x1b[7m", 4);
+    }else{
+        abAppend(ab, "\x1b[2;7m", 6);
+    }
     char status[80], rstatus[80];
 
     int len = snprintf(status, sizeof(status), "%.20s - %d lines %s", E.filename ? E.filename : "[No Name]", E.numRows, E.dirty ? "(modified)" : "");
-    int rlen = snprintf(rstatus, sizeof(rstatus), "%s | %d, %d",E.syntax ? E.syntax->fileType : "no ft", E.my + 1, E.rx);
+    int rlen;
+    if (perfHud && current){
+        //Key to paint latency over the last frames, and what the last frame wrote
+        perfStats st;
+        editorPerfGetStats(&st);
+        rlen = snprintf(rstatus, sizeof(rstatus), "p50 %.2fms p99 %.2fms %zuB/frame | %d, %d",
+            st.p50 / 1e6, st.p99 / 1e6, st.lastBytes, win->my + 1, win->rx);
+    }else{
+        rlen = snprintf(rstatus, sizeof(rstatus), "%s | %d, %d",E.syntax ? E.syntax->fileType : "no ft", win->my + 1, win->rx);
+    }
+    if (rlen >= (int)sizeof(rstatus)) rlen = sizeof(rstatus) - 1;
 
-    if (len > E.screenCol) len = E.screenCol;
+    //The bars go over the gutter too
+    int width = E.screenCol + COMETTEX_DIFF_GUTTER;
+    if (len > width) len = width;
     abAppend(ab, status, len);
-    while (len < E.screenCol){
-        if (E.screenCol - len == rlen){
+    while (len < width){
+        if (width - len == rlen){
             abAppend(ab, rstatus, rlen);
             break;
         }else{
@@ -139,37 +353,55 @@ void editorDrawStatusBar(struct abuf *ab){
         }
     }
     abAppend(ab, "\x1b[m", 3);
-    abAppend(ab, "\r\n", 2);
 }
 
 void editorDrawMessageBar(struct abuf *ab){
+    editorWindow *last = &E.windows[E.numWindows - 1];
+    char pos[32];
+    int posLen = snprintf(pos, sizeof(pos), "\x1b[%d;1H", last->top + last->height + 2);
+    abAppend(ab, pos, posLen);
     abAppend(ab, "\x1b[K", 3);
     int msgLen = strlen(E.statusMsg);
-    if (msgLen > E.screenCol) msgLen = E.screenCol;
+    if (msgLen > E.screenCol + COMETTEX_DIFF_GUTTER) msgLen = E.screenCol + COMETTEX_DIFF_GUTTER;
     if (msgLen && time(NULL) - E.statusMsg_time < 5){
         abAppend(ab, E.statusMsg, msgLen);
     }
 }
 
+//Set while a macro replays, nothing is drawn until it's done
+static int replaying = 0;
+
 void editorRefreshScreen(){
+    if (replaying) return;
     editorScroll();
+    editorWindowSync(&E);
 
     struct abuf ab = ABUF_INIT;
 
     abAppend(&ab, "\x1b[?25l", 6);
-    abAppend(&ab, "\x1b[H", 3);
 
-    editorDrawRow(&ab);
-    editorDrawStatusBar(&ab);
+    editorFindBracketPair();
+    editorDiffUpdate(&E);
+    long long t = editorPerfBegin();
+    //Other windows are only drawn again when what they show changed
+    for (int w = 0;w<E.numWindows;w++){
+        if (editorWindowNeedsDraw(&E, w)) editorWindowDrawn(&E, w, editorDrawRow(&ab, w));
+        editorDrawStatusBar(&ab, w);
+    }
+    editorDamageClear(&E);
+    editorPerfEnd(PERF_DRAW, t);
     editorDrawMessageBar(&ab);
 
     char buf[32];
-    snprintf(buf, sizeof(buf), "\x1b[%d;%dH", (E.my - E.rowOffset) + 1, (E.rx - E.colOffset) + 1);
+    snprintf(buf, sizeof(buf), "\x1b[%d;%dH", E.windows[E.curWindow].top + cursorScreenRow + 1, cursorScreenCol + COMETTEX_DIFF_GUTTER + 1);
     abAppend(&ab, buf, strlen(buf));
 
     abAppend(&ab, "\x1b[?25h", 6);
 
+    t = editorPerfBegin();
     write(STDOUT_FILENO, ab.b, ab.len);
+    editorPerfEnd(PERF_WRITE, t);
+    editorPerfFrame(ab.len);
     abFree(&ab);
 }
 
@@ -206,7 +438,7 @@ char *editorPrompt(char *prompt, void (*callback)(char *, int)){
                 if (callback) callback(buf, c);
                 return buf;
             }
-        }else if (!iscntrl(c) && c < 128){
+        }else if ((c < 128 && !iscntrl(c)) || (c >= 128 && c < 256)){
             if (bufLen == bufSize - 1){
                 bufSize *= 2;
                 buf = realloc(buf, bufSize);
@@ -221,11 +453,12 @@ char *editorPrompt(char *prompt, void (*callback)(char *, int)){
 
 void editorMoveCursor(int key){
     erow *row = (E.my >= E.numRows) ? NULL : &E.row[E.my];
+    if (row) editorRowThaw(&E, row);
 
     switch(key){
         case ARROW_LEFT:
             if (E.mx != 0){
-                E.mx--;
+                E.mx = utf8PrevChar(row->chars, E.mx);
             }else if (E.my > 0){
                 E.my--;
                 E.mx = E.row[E.my].size;
@@ -233,7 +466,7 @@ void editorMoveCursor(int key){
             break;
         case ARROW_RIGHT:
             if (row && E.mx < row->size){
-                E.mx++;
+                E.mx = utf8NextChar(row->chars, row->size, E.mx);
             }else if (row && E.mx == row->size){
                 E.my++;
                 E.mx = 0;
@@ -258,18 +491,63 @@ void editorMoveCursor(int key){
     }
 }
 
+//Moves the cursor n times in one go. Going up or down is a jump and a single clamp
+void editorMoveCursorBy(int key, int n){
+    if (key == ARROW_UP || key == ARROW_DOWN){
+        E.my += (key == ARROW_UP) ? -n : n;
+        if (E.my < 0) E.my = 0;
+        if (E.my > E.numRows) E.my = E.numRows;
+
+        int rowlen = (E.my < E.numRows) ? E.row[E.my].size : 0;
+        if (E.mx > rowlen) E.mx = rowlen;
+        return;
+    }
+    while (n--){
+        int mx = E.mx, my = E.my;
+        editorMoveCursor(key);
+        if (E.mx == mx && E.my == my) break;
+    }
+}
+
+//Page up and down, times pages at once
+void editorMovePage(int key, int times){
+    if (E.wrapWidth){
+        //A page is a screen of lines, which can be far fewer rows. The cursor keeps its column on the screen
+        long long line = editorWrapLineOf(&E, E.my) + (E.rx / E.wrapWidth);
+        line += (long long)((key == PAGE_UP) ? -E.screenRow : E.screenRow) * times;
+        if (line < 0) line = 0;
+        int total = editorWrapTotal(&E);
+        if (line > total) line = total;
+
+        int sub;
+        int col = E.rx % E.wrapWidth;
+        E.my = editorWrapRowAt(&E, line, &sub);
+        E.mx = 0;
+        if (E.my < E.numRows){
+            erow *row = &E.row[E.my];
+            editorRowThaw(&E, row);
+            E.mx = rowRxtoMx(row, sub * E.wrapWidth + col);
+        }
+        return;
+    }
+    if (key == PAGE_UP){
+        //Bring cursor to top of the screen, then a screen further up
+        E.my = E.rowOffset;
+        editorMoveCursorBy(ARROW_UP, E.screenRow * times);
+    }else{
+        //Bring cursor to bottom of screen, then a screen further down
+        E.my = E.rowOffset + E.screenRow - 1;
+        if (E.my > E.numRows) E.my = E.numRows;
+        editorMoveCursorBy(ARROW_DOWN, E.screenRow * times);
+    }
+}
+
 void editorFindCallback(char *query, int key){
     static int last_match = -1;
     static int direction = 1;
 
-    static int saved_hl_line;
-    static char *saved_hl = NULL;
-
-    if (saved_hl){
-        memcpy(E.row[saved_hl_line].hl, saved_hl, E.row[saved_hl_line].rsize);
-        free(saved_hl);
-        saved_hl = NULL;
-    }
+    //Drop the old match, the next one is set below
+    E.matchRow = -1;
 
     if (key == '\r' || key == '\x1b'){
         last_match = -1;
@@ -292,24 +570,57 @@ void editorFindCallback(char *query, int key){
         if (cur == -1) cur = E.numRows - 1;
         else if (cur == E.numRows) cur = 0;
 
+        //Search chars since render is only a window on long rows
         erow *row = &E.row[cur];
-        char *match = strstr(row->render, query);
+        char *text = editorRowText(row);
+        char *match = strstr(text, query);
         if (match){
             last_match = cur;
             E.my = cur;
-            E.mx = rowRxtoMx(row, match - row->render);
+            E.mx = match - text;
+            //Past the end so editorScroll brings the match to the top
             E.rowOffset = E.numRows;
+            E.lineOffset = INT_MAX;
 
-            saved_hl_line = cur;
-            saved_hl = malloc(row->rsize);
-            memcpy(saved_hl, row->hl, row->rsize);
-            //Highlight the matches
-            memset(&row->hl[match - row->render], HL_MATCH, strlen(query));
+            E.matchRow = cur;
+            E.matchMx = E.mx;
+            E.matchLen = strlen(query);
             break;
         }
     }
 }
 
+void editorSave(editorConfig *ce){
+    if (ce->filename == NULL){
+        ce->filename = editorPrompt("Save as: %s (ESC to cancel", NULL);
+        if (ce->filename == NULL){
+            editorSetStatusMessage("Save aborted");
+            return;
+        }
+        editorSelectSyntaxHighlight(ce);
+    }
+
+    long long len = editorWriteFile(ce);
+    if (len == -1){
+        editorSetStatusMessage("Can't Save! I/O error %s", strerror(errno));
+        return;
+    }
+    editorSetStatusMessage("%lld bytes written to disk", len);
+    editorSessionSave(ce);
+}
+
+//The cursor is kept for next time too, so the session is written on the way out as well
+static void editorSaveSessionAtExit(){
+    editorSessionSave(&E);
+}
+
+static char *lastSearch = NULL;
+
+void editorTogglePerfHud(){
+    perfHud = !perfHud;
+    editorPerfEnable(perfHud);
+}
+
 void editorFind(){
     int saved_mx = E.mx;
     int saved_my = E.my;
@@ -318,6 +629,61 @@ void editorFind(){
 
     char *query = editorPrompt("Search: %s (ESC to cancel)", editorFindCallback);
 
+    if (query){
+        //Kept for Ctrl+N, cursors on every match
+        free(lastSearch);
+        lastSearch = query;
+    }else{
+        E.mx = saved_mx;
+        E.my = saved_my;
+        E.colOffset = saved_colOff;
+        E.rowOffset = saved_rowOff;
+    }
+}
+
+void editorSymbolCallback(char *query, int key){
+    static int matches[COMETTEX_SYMBOL_MATCHES];
+    static int numMatches = 0;
+    static int current = 0;
+
+    E.matchRow = -1;
+
+    if (key == '\r' || key == '\x1b'){
+        numMatches = 0;
+        current = 0;
+        return;
+    }else if (key == ARROW_RIGHT || key == ARROW_DOWN){
+        if (numMatches) current = (current + 1) % numMatches;
+    }else if (key == ARROW_LEFT || key == ARROW_UP){
+        if (numMatches) current = (current + numMatches - 1) % numMatches;
+    }else{
+        numMatches = editorSymbolsMatch(&E, query, matches, COMETTEX_SYMBOL_MATCHES);
+        current = 0;
+    }
+    if (numMatches == 0) return;
+
+    editorSymbol *sym = &E.symbols[matches[current]];
+    E.my = sym->row;
+    E.mx = sym->off;
+    E.rowOffset = E.numRows;
+    E.lineOffset = INT_MAX;
+
+    E.matchRow = sym->row;
+    E.matchMx = sym->off;
+    E.matchLen = sym->len;
+}
+
+//Goes to a function, type or #define by a fuzzy match of its name
+void editorJumpToSymbol(){
+    int saved_mx = E.mx;
+    int saved_my = E.my;
+    int saved_colOff = E.colOffset;
+    int saved_rowOff = E.rowOffset;
+
+    //Whatever the background pass hasn't got to yet, usually nothing
+    editorSymbolsIndex(&E, INT_MAX);
+    char *query = editorPrompt("Symbol: %s (Use ESC/Arrows/Enter)", editorSymbolCallback);
+
     if (query){
         free(query);
     }else{
@@ -328,7 +694,36 @@ void editorFind(){
     }
 }
 
+//Set by SIGWINCH, the next idle call picks up the new size
+static volatile sig_atomic_t windowResized = 0;
+
+static void editorWindowChanged(int sig){
+    (void)sig;
+    windowResized = 1;
+}
+
+//Called while waiting for a key, does background work a slice at a time until one comes
+void editorIdle(){
+    if (windowResized){
+        windowResized = 0;
+        int rows;
+        if (getWindowSize(&rows, &E.screenCol) != -1){
+            //Everything but the message bar is windows
+            editorWindowsLayout(&E, rows - 1);
+            E.screenCol -= COMETTEX_DIFF_GUTTER;
+            if (E.wrapWidth) editorWrapSetWidth(&E, E.screenCol);
+            editorRefreshScreen();
+        }
+    }
+    struct pollfd in = {STDIN_FILENO, POLLIN, 0};
+    while (editorSymbolsIndex(&E, COMETTEX_SYMBOL_SLICE)){
+        if (poll(&in, 1, 0) > 0) break;
+    }
+}
+
 void enterInsertMode(int key){
+    //Everything typed until ESC is one change for undo
+    editorUndoSeal();
     switch (key) {
         case 'i':
             E.mode = 0;
@@ -363,11 +758,108 @@ void enterInsertMode(int key){
     }
 }
 
+void processKeypressNormal();
+void ProcessKeypressInsert();
+
+static int lastMacro = 0;
+
+//Runs the macro in reg times over. Its keys go through the usual handlers from the key queue,
+//with the screen not drawn and the highlighting left for the end
+void editorReplayMacro(int reg, int times){
+    int n;
+    int *keys = editorMacroKeys(reg, &n);
+    if (keys == NULL || n == 0){
+        editorSetStatusMessage("Nothing recorded in @%c", reg);
+        return;
+    }
+    lastMacro = reg;
+
+    replaying = 1;
+    editorDeferSyntax(&E);
+    for (int t = 0;t<times;t++){
+        editorQueueKeys(keys, n);
+        while (editorKeysQueued()){
+            if (E.mode == MODE_NORMAL){
+                processKeypressNormal();
+            }else{
+                ProcessKeypressInsert();
+            }
+        }
+        editorColdTrim(&E);
+    }
+    editorFlushSyntax(&E);
+    replaying = 0;
+}
+
 void processKeypressNormal(){
     static int quit_times = COMETTEX_QUIT_TIMES;
+    //Count typed in front of a command, 500 in 500dd
+    static int count = 0;
+    //Operator waiting for the rest of the command, the first d of dd
+    static int pending = 0;
+    static int pendingCount = 0;
 
     int c = editorReadKey();
 
+    //0 is only part of a count once one has started
+    if ((c >= '1' && c <= '9') || (c == '0' && count > 0)){
+        if (count < 100000000) count = count * 10 + (c - '0');
+        return;
+    }
+    int given = (count > 0);
+    int n = given ? count : 1;
+    count = 0;
+    //Each normal mode command is its own change for undo
+    editorUndoSeal();
+
+    if (pending){
+        int op = pending;
+        pending = 0;
+        if (op == 'q'){
+            editorMacroStart(c);
+            if (editorMacroRecording()) editorSetStatusMessage("recording @%c", c);
+            return;
+        }
+        if (op == '@'){
+            //Macros don't run other macros
+            if (replaying) return;
+            if (c == '@') c = lastMacro;
+            editorReplayMacro(c, pendingCount * n);
+            return;
+        }
+        //Operators only work on whole rows for now, dd yy >> << !!
+        if (c != op) return;
+
+        //Each one changes the rows in one pass, however many there are
+        int lines = pendingCount * n;
+        switch (op){
+            case 'd':
+                editorDelLines(&E, E.my, lines);
+                break;
+            case 'y':
+                editorYankLines(&E, E.my, lines);
+                editorSetStatusMessage("%d lines yanked", editorYankedLines());
+                return;
+            case '>':
+                editorIndentLines(&E, E.my, lines);
+                break;
+            case '<':
+                editorOutdentLines(&E, E.my, lines);
+                break;
+            case '!':
+                {
+                    char *cmd = editorPrompt("!%s", NULL);
+                    if (cmd == NULL) return;
+                    editorFilterCommand(&E, E.my, lines, cmd);
+                    free(cmd);
+                }
+                break;
+        }
+        if (E.my >= E.numRows) E.my = E.numRows ? E.numRows - 1 : 0;
+        E.mx = 0;
+        return;
+    }
+
     switch(c){
         case CTRL_KEY('q'):
             if (E.dirty && quit_times > 0){
@@ -390,6 +882,15 @@ void processKeypressNormal(){
             editorFind();
             break;
 
+        case CTRL_KEY('g'):
+            editorJumpToSymbol();
+            break;
+
+        case CTRL_KEY('w'):
+            //To the next window down, round to the top
+            editorWindowFocus(&E, (E.curWindow + 1) % E.numWindows);
+            break;
+
         case CTRL_KEY('x'):
             editorSave(&E);
             //Clear the entire screen
@@ -419,27 +920,122 @@ void processKeypressNormal(){
         
         case PAGE_UP:
         case PAGE_DOWN:
-            {
-                if (c == PAGE_UP){
-                    //Bring cursor to top of the screen. Keeping it's x value if the line length is the same/bigger
-                    E.my = E.rowOffset;
-                }else if (c == PAGE_DOWN){
-                    //Bring cursor to bottom of screen. Keeping it's x value if the line length is the same/bigger
-                    E.my = E.rowOffset + E.screenRow - 1;
-                    if (E.my > E.numRows) E.my = E.numRows;
-                }
-                int t = E.screenRow;
-                while(t--){
-                    editorMoveCursor(c == PAGE_UP ? ARROW_UP : ARROW_DOWN);
-                }
-            }
+            editorMovePage(c, n);
             break;
         case ARROW_UP:
         case ARROW_DOWN:
         case ARROW_LEFT:
         case ARROW_RIGHT:
-            editorMoveCursor(c);
+            editorMoveCursorBy(c, n);
+            break;
+        case 'h':
+            editorMoveCursorBy(ARROW_LEFT, n);
+            break;
+        case 'j':
+            editorMoveCursorBy(ARROW_DOWN, n);
+            break;
+        case 'k':
+            editorMoveCursorBy(ARROW_UP, n);
+            break;
+        case 'l':
+            editorMoveCursorBy(ARROW_RIGHT, n);
             break;
+        case 'G':
+            //Go to row n, or the last row without a count
+            E.my = given ? n - 1 : E.numRows - 1;
+            if (E.my > E.numRows - 1) E.my = E.numRows - 1;
+            if (E.my < 0) E.my = 0;
+            E.mx = 0;
+            break;
+
+        case 'x':
+            //n chars from the cursor, never past the end of the row
+            if (E.my < E.numRows){
+                erow *row = &E.row[E.my];
+                editorRowThaw(&E, row);
+                int end = E.mx;
+                while (n-- && end < row->size) end = utf8NextChar(row->chars, row->size, end);
+                editorDeleteRange(&E, E.my, E.mx, E.my, end);
+            }
+            break;
+        case 'd':
+        case 'y':
+        case '>':
+        case '<':
+        case '!':
+            pending = c;
+            pendingCount = n;
+            return;
+        case 'p':
+        case 'P':
+            {
+                //p puts below the cursor row, P above it
+                int at = (c == 'p' && E.my < E.numRows) ? E.my + 1 : E.my;
+                editorPutLines(&E, at, n);
+                E.my = (at < E.numRows) ? at : E.numRows - 1;
+                if (E.my < 0) E.my = 0;
+                E.mx = 0;
+            }
+            break;
+        case 'J':
+            editorJoinLines(&E, E.my, given ? n : 2);
+            break;
+        case '%':
+            //To the bracket pairing with the one under the cursor
+            {
+                int y, x;
+                if (editorBracketMatch(&E, E.my, E.mx, &y, &x)){
+                    E.my = y;
+                    E.mx = x;
+                }
+            }
+            break;
+
+        case 'q':
+            if (editorMacroRecording()){
+                editorMacroStop();
+                editorSetStatusMessage("");
+                break;
+            }
+            //Macros can't be recorded from inside one
+            if (replaying) break;
+            pending = c;
+            pendingCount = n;
+            return;
+        case '@':
+            pending = c;
+            pendingCount = n;
+            return;
+
+        case CTRL_KEY('n'):
+            if (lastSearch == NULL){
+                editorSetStatusMessage("Search for something first");
+            }else{
+                int found = editorCursorsFromMatches(&E, lastSearch);
+                editorSetStatusMessage("%d cursors", found);
+            }
+            break;
+        case CTRL_KEY('v'):
+            //A cursor on each of the next n rows, at the same column
+            editorCursorsColumn(&E, n);
+            editorSetStatusMessage("%d cursors", E.numCursors + 1);
+            break;
+        case '\x1b':
+            editorClearCursors(&E);
+            break;
+
+        case ':':
+            {
+                char *cmd = editorPrompt(":%s", NULL);
+                if (cmd){
+                    editorCommand(&E, cmd);
+                    free(cmd);
+                    if (E.my >= E.numRows) E.my = E.numRows;
+                    if (E.my < E.numRows && E.mx > E.row[E.my].size) E.mx = E.row[E.my].size;
+                }
+            }
+            break;
+
         case 'i':
         case 'I':
         case 'a':
@@ -448,6 +1044,23 @@ void processKeypressNormal(){
         case 'O':
             enterInsertMode(c);
             break;
+
+        case 'u':
+            while (n--){
+                if (!editorUndo(&E)){
+                    editorSetStatusMessage("Already at oldest change");
+                    break;
+                }
+            }
+            break;
+        case CTRL_KEY('r'):
+            while (n--){
+                if (!editorRedo(&E)){
+                    editorSetStatusMessage("Already at newest change");
+                    break;
+                }
+            }
+            break;
         default:
 
             break;
@@ -463,7 +1076,8 @@ void ProcessKeypressInsert(){
 
     switch(c){
         case '\r':
-            editorInsertNewLine(&E);
+            if (E.numCursors) editorMultiInsertNewLine(&E);
+            else editorInsertNewLine(&E);
             break;
         case CTRL_KEY('q'):
             if (E.dirty && quit_times > 0){
@@ -484,6 +1098,10 @@ void ProcessKeypressInsert(){
             editorFind();
             break;
 
+        case CTRL_KEY('g'):
+            editorJumpToSymbol();
+            break;
+
         case CTRL_KEY('x'):
             editorSave(&E);
             write(STDOUT_FILENO, "\x1b[2J", 4);
@@ -503,24 +1121,17 @@ void ProcessKeypressInsert(){
         case BACKSPACE:
         case CTRL_KEY('h'):
         case DEL_KEY:
+            if (E.numCursors){
+                editorMultiDelChar(&E, c == DEL_KEY);
+                break;
+            }
             if (c == DEL_KEY) editorMoveCursor(ARROW_RIGHT);
             editorDelChar(&E);
             break;
         
         case PAGE_UP:
         case PAGE_DOWN:
-            {
-                if (c == PAGE_UP){
-                    E.my = E.rowOffset;
-                }else if (c == PAGE_DOWN){
-                    E.my = E.rowOffset + E.screenRow - 1;
-                    if (E.my > E.numRows) E.my = E.numRows;
-                }
-                int t = E.screenRow;
-                while(t--){
-                    editorMoveCursor(c == PAGE_UP ? ARROW_UP : ARROW_DOWN);
-                }
-            }
+            editorMovePage(c, 1);
             break;
         case ARROW_UP:
         case ARROW_DOWN:
@@ -531,10 +1142,16 @@ void ProcessKeypressInsert(){
         
         case CTRL_KEY('l'):
         case '\x1b':
+            editorUndoSeal();
             E.mode = 1;
             break;
         default:
-            editorInsertChar(&E,c);
+            if (E.numCursors){
+                char ch = c;
+                editorMultiInsert(&E, &ch, 1);
+            }else{
+                editorInsertChar(&E,c);
+            }
             break;
     }
 
@@ -548,7 +1165,41 @@ void initEditor(){
     E.rowOffset = 0;
     E.colOffset = 0;
     E.numRows = 0;
+    E.rowCap = 0;
     E.row = NULL;
+    E.matchRow = -1;
+    E.hlDefer = 0;
+    E.hlDirtyFrom = 0;
+    E.hlDirtyTo = 0;
+    E.wrapWidth = 0;
+    E.lineOffset = 0;
+    E.rowTree = NULL;
+    E.symbols = NULL;
+    E.numSymbols = 0;
+    E.symbolsCap = 0;
+    E.symbolNames = NULL;
+    E.symbolNamesLen = 0;
+    E.symbolNamesCap = 0;
+    E.symbolsValid = 0;
+    E.diffBase = NULL;
+    E.numDiffBase = 0;
+    E.diffBaseCap = 0;
+    E.diffRows = NULL;
+    E.numDiffRows = 0;
+    E.diffRowsCap = 0;
+    E.diffHunks = NULL;
+    E.numDiffHunks = 0;
+    E.diffHunksCap = 0;
+    E.diffDirty = 0;
+    E.windows = NULL;
+    E.numWindows = 0;
+    E.curWindow = 0;
+    E.damageFrom = 0;
+    E.damageTo = 0;
+    E.bracketCacheValid = 0;
+    E.cursors = NULL;
+    E.numCursors = 0;
+    E.cursorCap = 0;
     E.mode = 1;
     E.dirty = 0;
     E.filename = NULL;
@@ -556,33 +1207,72 @@ void initEditor(){
     E.statusMsg_time = 0;
     E.syntax = NULL;
 
-    //char* result = searchConfigFile("COMETTEX_VERSION");
+    //Memory budget in MB for the row buffers, rows away from the screen get compressed past it
+    char *budget = getenv("COMETTEX_MEMORY_BUDGET");
+    editorColdInit(budget ? (size_t)atol(budget) * 1024 * 1024 : 0);
+
+    //Trace file to write from the start, :trace does the same once running
+    char *trace = getenv("COMETTEX_TRACE");
+    if (trace && editorPerfTraceStart(trace) == -1) die("COMETTEX_TRACE");
 
-    if (getWindowSize(&E.screenRow, &E.screenCol) == -1) die("getWindowSize");
-    E.screenRow -= 2;
+    int rows;
+    if (getWindowSize(&rows, &E.screenCol) == -1) die("getWindowSize");
+    E.screenCol -= COMETTEX_DIFF_GUTTER;
+    //Everything but the message bar is windows, one to start with
+    editorWindowsLayout(&E, rows - 1);
 }
 
 int main(int argc, char *argv[]){
-    if (argc != 2) {
-        fprintf(stderr,"Usage: ./CometTex <filename>\n");
+    if (argc == 3 && !strcmp(argv[1], "--stats")){
+        //Loads the file and prints what it costs, no terminal needed
+        E.matchRow = -1;
+        E.screenRow = 24;
+        E.screenCol = 80;
+        editorOpen(&E, argv[2]);
+        editorSelectSyntaxHighlight(&E);
+        editorPrintStats(&E, stdout);
+        return 0;
+    }
+    char *filename = argv[argc - 1];
+    if (argc == 3 && !strcmp(argv[1], "--server")){
+        //Comes back only in the process that runs the editor, on the server's pty
+        editorServe(filename);
+    }else if (argc == 2){
+        //A server already has the file open, this terminal just shows it
+        if (editorAttach(filename) != -1) return 0;
+    }else{
+        fprintf(stderr,"Usage: ./CometTex <filename>\n       ./CometTex --server <filename>\n       ./CometTex --stats <filename>\n");
         exit(1);
     }
-    
+
     //Set all variables needed to the default
     initEditor();
     //If they gave a file name open the file
-    editorOpen(&E,argv[1]);
+    editorOpen(&E,filename);
+    editorSelectSyntaxHighlight(&E);
+    atexit(editorSaveSessionAtExit);
     enableRawMode(&E);
-    editorSetStatusMessage("HELP: Ctrl+S = save | CTRL+F find | Ctrl+Q = quit");
+    //SA_RESTART so a resize doesn't fail the read waiting for a key
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = editorWindowChanged;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGWINCH, &sa, NULL);
+    editorSetStatusMessage("HELP: Ctrl+S = save | CTRL+F find | Ctrl+G symbol | Ctrl+Q = quit");
 
     while (1){
         //Refresh the screen every frame
         editorRefreshScreen();
         if (E.mode == MODE_NORMAL) {
+            int dirty = E.dirty;
             processKeypressNormal();
+            //Normal mode edits only know about the main cursor, the others would be stale
+            if (E.dirty != dirty) editorClearCursors(&E);
         } else {
             ProcessKeypressInsert();
         }
+        editorPerfEnd(PERF_KEY, editorPerfKeyAt());
+        editorColdTrim(&E);
     }
     return 0;
 }
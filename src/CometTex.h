@@ -7,18 +7,107 @@
 #define COMETTEX_VERSION "0.0.1"
 #define COMETTEX_QUIT_TIMES 3;
 #define COMETTEX_TAB_STOP 4
+//Every how many chars a row stores its render column
+#define COMETTEX_RX_CHECKPOINT 128
+//Rows this long only render and highlight a window around colOffset
+#define COMETTEX_LONG_LINE (1 << 16)
+//Extra render columns kept on each side of the visible part of a long row
+#define COMETTEX_LONG_LINE_MARGIN 1024
+//Every how many chars a long row stores its lexer state
+#define COMETTEX_HL_CHECKPOINT 4096
 #define CTRL_KEY(c) ((c) & 0x1f)
 
+typedef struct rxCheckpoint {
+    int mx; //A char start, about COMETTEX_RX_CHECKPOINT chars after the one before
+    int rx; //Its render column
+    int rb; //Its byte offset in the fully rendered row
+} rxCheckpoint;
+
+//A run of render bytes with the same highlight, bytes outside any span are HL_NORMAL
+typedef struct hlSpan {
+    int start;
+    unsigned short len;
+    unsigned char hl;
+} hlSpan;
+
+//Brackets of a run of rows outside strings and comments, opens count 1 and closes -1.
+//min is the lowest the count gets going forward and max the highest going backward
+typedef struct bracketSummary {
+    int sum;
+    int min;
+    int max;
+} bracketSummary;
+
+//What only a row of COMETTEX_LONG_LINE chars or more keeps, a shorter one's render is the whole row
+typedef struct longRow {
+    //render only holds chars[mstart..mend), starting at render column rstart
+    //and at byte rbstart of the full render
+    int mstart;
+    int mend;
+    int rstart;
+    int rbstart;
+    //Lexer state about every COMETTEX_HL_CHECKPOINT chars
+    struct hlCheckpoint *hlCheckpoints;
+    int numHlCheckpoints;
+} longRow;
+
 typedef struct erow {
     int idx;
     int size;
     int rsize;
+    int numHl;
     char *chars;
     char *render;
-    unsigned char *hl;
-    int hlOpenComment;
+    hlSpan *hl;
+    //Set from when a long row is rendered until it's shorter or frozen, NULL for the rest
+    longRow *longRow;
+    //Cached column widths, about one checkpoint every COMETTEX_RX_CHECKPOINT chars
+    //NULL when the row is ASCII without tabs, mx, rx and render bytes are the same then
+    rxCheckpoint *rxCheckpoints;
+    int numRxCheckpoints;
+    //Block holding the text of a frozen row, -1 for a normal row. See coldRows.c
+    int coldBlock;
+    int coldOff;
+    //What the row was last counted as in editorConfig.stats, see editorRowAccount
+    int statText;
+    int statRender;
+    int statHl;
+    //Screen lines the row takes with soft wrap on, 0 until worked out. See wrap.c
+    int wrapLines;
+    //Set with the highlight, the same lexer decides what's in a string. See brackets.c
+    bracketSummary brackets;
+    //The byte sized fields go last, together, so none of them is padded out to an int
+    unsigned char hlOpenComment;
+    unsigned char isAscii;
+    //render points into chars instead of its own buffer when there's no tab to expand
+    unsigned char renderShared;
+    //Its line length and tab density buckets plus one, 0 before it's been counted
+    unsigned char statLen;
+    unsigned char statTabs;
+    //Kind of definition on the row, SYMBOL_UNSCANNED until the symbol pass gets to it. See symbols.c
+    unsigned char symKind;
 } erow;
 
+//Rows by length: empty, then 1, 2-3, 4-7 and so on up to 2^30 and over
+#define COMETTEX_STATS_LEN_BUCKETS 32
+//Rows by share of tabs in their chars: none, then up to 10%, 20% ... 100%
+#define COMETTEX_STATS_TAB_BUCKETS 11
+
+//What the rows cost, kept up to date by ops.c as rows change. Bytes are what was asked
+//from the row allocator, its own rounding and bookkeeping are counted by rowAlloc.c
+typedef struct bufferStats {
+    size_t textBytes;   //chars of rows that aren't cold, with their '\0'
+    size_t renderBytes; //render buffers that aren't shared with chars, and rx checkpoints
+    size_t hlBytes;     //Highlight spans and lexer checkpoints
+    long long lenHist[COMETTEX_STATS_LEN_BUCKETS];
+    long long tabHist[COMETTEX_STATS_TAB_BUCKETS];
+} bufferStats;
+
+typedef struct editorCursor {
+    int mx;
+    int my;
+} editorCursor;
+
 typedef struct editorConfig{
     int mx,my;
     int rx;
@@ -27,7 +116,65 @@ typedef struct editorConfig{
     int screenRow;
     int screenCol;
     int numRows;
+    int rowCap;
     erow *row;
+    //The current search match, drawn over the row's highlight
+    int matchRow;
+    int matchMx;
+    int matchLen;
+    //Cursors besides mx,my, sorted by row then char. See cursors.c
+    editorCursor *cursors;
+    int numCursors;
+    int cursorCap;
+    //While set, highlighting only marks rows [hlDirtyFrom, hlDirtyTo) to be done later
+    int hlDefer;
+    int hlDirtyFrom;
+    int hlDirtyTo;
+    bufferStats stats;
+    //Soft wrap, rows are cut every wrapWidth columns. 0 when off
+    int wrapWidth;
+    //The screen line at the top of the screen while wrapping, counted from the first row
+    int lineOffset;
+    //B+ tree over the rows for the sums of their wrapLines, see rowTree.c. NULL until needed
+    struct rowTree *rowTree;
+    //Symbol index, see symbols.c
+    struct editorSymbol *symbols;
+    int numSymbols;
+    int symbolsCap;
+    char *symbolNames;
+    int symbolNamesLen;
+    int symbolNamesCap;
+    int symbolsValid;
+    //The last bracket matched at (bracketCacheY, bracketCacheX) and the one it pairs with,
+    //until a row's brackets change or rows come and go. See brackets.c
+    int bracketCacheValid;
+    int bracketCacheY;
+    int bracketCacheX;
+    int bracketCacheFound;
+    int bracketCacheMy;
+    int bracketCacheMx;
+    //Diff against the saved file, see diff.c. The hashes of its rows, the hashes of the rows
+    //of the buffer lined up with row, and the hunks where the buffer differs. Rows
+    //[diffFrom, diffTo) changed since the hunks were worked out
+    unsigned long long *diffBase;
+    int numDiffBase;
+    int diffBaseCap;
+    unsigned long long *diffRows;
+    int numDiffRows;
+    int diffRowsCap;
+    struct diffHunk *diffHunks;
+    int numDiffHunks;
+    int diffHunksCap;
+    int diffFrom;
+    int diffTo;
+    int diffDirty;
+    //Split windows on the buffer, see window.c. The current one's cursor and viewport are mx, my
+    //and the rest above. Rows [damageFrom, damageTo) draw differently since the last frame
+    struct editorWindow *windows;
+    int numWindows;
+    int curWindow;
+    int damageFrom;
+    int damageTo;
     int mode;
     int dirty;
     char *filename;
@@ -55,12 +202,16 @@ enum editorKey{
     PAGE_DOWN
 };
 
-static editorConfig E;
-
+//Terminal front end, see CometTex.c
+//die is the one the core calls too, a program using the core library without it brings its own
 void die(const char *s);
 char *editorPrompt(char *prompt, void (*callback)(char *, int));
 void editorSetStatusMessage(const char *fmt, ...);
 void editorFind();
+void editorJumpToSymbol();
+void editorIdle();
+void editorSave(editorConfig *ce);
+void editorTogglePerfHud();
 void initEditor();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include <stdlib.h>
+#include "CometTex.h"
+#include "syntaxHighlighting.h"
+#include "coldRows.h"
+#include "brackets.h"
+#include "rowTree.h"
+
+/*
+ Bracket pairs. Every row keeps a summary of its brackets outside strings and comments,
+ worked out by the lexer along with the highlight so it's only redone for rows that were
+ highlighted again. All kinds count the same, ( [ and { as 1 and ) ] and } as -1.
+
+ A bracket open at depth d is closed in the first row below where d plus the row's min
+ gets to 0, with d moving by the sum of every row in between. The row tree keeps the same
+ summaries over runs of rows, see rowTree.c, so finding that row is a walk down the tree
+ however far it is, and rows coming and going don't cost a rebuild. Going up to the
+ opening bracket is the same with max.
+
+ Only the row at either end is lexed again, for where exactly the brackets are. A long row
+ keeps a summary for each piece between its lexer checkpoints too, so only the piece with
+ the bracket in it is lexed. When the two don't pair up, like ( and ], there is no match.
+ The last match is kept until the cursor moves or a row's brackets change, it's asked for
+ every frame.
+*/
+
+//The brackets of a followed by b
+bracketSummary editorBracketJoin(bracketSummary a, bracketSummary b){
+    bracketSummary s;
+    s.sum = a.sum + b.sum;
+    s.min = (a.min < a.sum + b.min) ? a.min : a.sum + b.min;
+    s.max = (b.max > b.sum + a.max) ? b.max : b.sum + a.max;
+    return s;
+}
+
+//Called by the lexer for every bracket it finds outside strings and comments
+void editorBracketSee(bracketScan *bs, int c, int at){
+    int d = (c == '(' || c == '[' || c == '{') ? 1 : -1;
+    bs->s.sum += d;
+    if (bs->s.sum < bs->s.min) bs->s.min = bs->s.sum;
+    bs->s.max = (bs->s.max + d > 0) ? bs->s.max + d : 0;
+
+    if (bs->pos == NULL) return;
+    if (bs->numPos == bs->posCap){
+        bs->posCap = bs->posCap ? bs->posCap * 2 : 16;
+        bs->pos = realloc(bs->pos, sizeof(int) * bs->posCap);
+    }
+    bs->pos[bs->numPos++] = at;
+}
+
+//Every bracket counts, for rows with no syntax
+void editorBracketScanText(bracketScan *bs, const char *s, int len){
+    for (int i = 0;i<len;i++){
+        if (IS_BRACKET(s[i])) editorBracketSee(bs, s[i], i);
+    }
+}
+
+//The row was highlighted again, bs is what the lexer found in it
+void editorBracketsRowChanged(editorConfig *ce, erow *row, bracketScan *bs){
+    //Brackets can move inside the row without the summary changing
+    ce->bracketCacheValid = 0;
+    bracketSummary *old = &row->brackets;
+    if (old->sum == bs->s.sum && old->min == bs->s.min && old->max == bs->s.max) return;
+    row->brackets = bs->s;
+    editorRowTreeChanged(ce, row->idx, ROWTREE_BRACKETS);
+}
+
+//Rows were inserted or deleted, the row tree follows them on its own
+void editorBracketsRowsMoved(editorConfig *ce){
+    ce->bracketCacheValid = 0;
+}
+
+//First row from from on under nd, whose first row is start, where *need gets closed. Rows
+//passed move *need. -1 if none
+static int brDescendForward(editorConfig *ce, rowNode *nd, int start, int from, int *need){
+    if (start + nd->rows <= from) return -1;
+    if (from <= start && *need + nd->brackets.min > 0){
+        *need += nd->brackets.sum;
+        return -1;
+    }
+    if (nd->leaf){
+        for (int y = (from > start) ? from : start;y<start + nd->rows;y++){
+            if (*need + ce->row[y].brackets.min <= 0) return y;
+            *need += ce->row[y].brackets.sum;
+        }
+        return -1;
+    }
+    for (int i = 0;i<nd->numChildren;i++){
+        int y = brDescendForward(ce, nd->child[i], start, from, need);
+        if (y != -1) return y;
+        start += nd->child[i]->rows;
+    }
+    return -1;
+}
+
+//Last row up to to under nd where *need opens are found, going backward
+static int brDescendBackward(editorConfig *ce, rowNode *nd, int start, int to, int *need){
+    int end = start + nd->rows;
+    if (start > to) return -1;
+    if (end - 1 <= to && nd->brackets.max < *need){
+        *need -= nd->brackets.sum;
+        return -1;
+    }
+    if (nd->leaf){
+        for (int y = (to < end - 1) ? to : end - 1;y>=start;y--){
+            if (ce->row[y].brackets.max >= *need) return y;
+            *need -= ce->row[y].brackets.sum;
+        }
+        return -1;
+    }
+    for (int i = nd->numChildren - 1;i>=0;i--){
+        end -= nd->child[i]->rows;
+        int y = brDescendBackward(ce, nd->child[i], end, to, need);
+        if (y != -1) return y;
+    }
+    return -1;
+}
+
+//The first row from from down that closes need open brackets, -1 when none does.
+//need is left at what's still open going into that row
+static int brFindForward(editorConfig *ce, int from, int *need){
+    if (from >= ce->numRows) return -1;
+    return brDescendForward(ce, editorRowTreeRoot(ce, ROWTREE_BRACKETS), 0, from, need);
+}
+
+//The same going up from from for need unmatched closing brackets
+static int brFindBackward(editorConfig *ce, int from, int *need){
+    if (from < 0) return -1;
+    return brDescendBackward(ce, editorRowTreeRoot(ce, ROWTREE_BRACKETS), 0, from, need);
+}
+
+//Through the brackets bs found after the one at k, or before it going backward, for the
+//one that closes need. Its char, -1 if none does
+static int brScan(const char *text, bracketScan *bs, int k, int forward, int *need){
+    for (k += forward ? 1 : -1;k >= 0 && k < bs->numPos;k += forward ? 1 : -1){
+        int o = text[bs->pos[k]];
+        *need += ((o == '(' || o == '[' || o == '{') == forward) ? 1 : -1;
+        if (*need == 0) return bs->pos[k];
+    }
+    return -1;
+}
+
+//The same through the pieces of a row after piece k, or before it, lexing only the piece
+//need gets closed in. Pieces passed move need
+static int brScanPieces(editorConfig *ce, erow *row, int k, int forward, int *need, bracketScan *bs){
+    int n = editorBracketPieces(row);
+    for (k += forward ? 1 : -1;k >= 0 && k < n;k += forward ? 1 : -1){
+        bracketSummary s = editorBracketPiece(row, k);
+        if (forward ? *need + s.min > 0 : s.max < *need){
+            *need += forward ? s.sum : -s.sum;
+            continue;
+        }
+        bs->s.sum = bs->s.min = bs->s.max = 0;
+        bs->numPos = 0;
+        editorLexBracketPiece(ce, row, k, bs);
+        return brScan(editorRowText(row), bs, forward ? -1 : bs->numPos, forward, need);
+    }
+    return -1;
+}
+
+static int brPairs(int open, int close){
+    return (open == '(' && close == ')') || (open == '[' && close == ']') || (open == '{' && close == '}');
+}
+
+/*
+ The bracket pairing with the one at char x of row y, in *my and *mx. Returns 0 when there
+ is no bracket there, it's in a string or comment, or it has no match
+*/
+int editorBracketMatch(editorConfig *ce, int y, int x, int *my, int *mx){
+    if (y < 0 || y >= ce->numRows || x < 0 || x >= ce->row[y].size) return 0;
+    if (ce->bracketCacheValid && ce->bracketCacheY == y && ce->bracketCacheX == x){
+        if (!ce->bracketCacheFound) return 0;
+        *my = ce->bracketCacheMy;
+        *mx = ce->bracketCacheMx;
+        return 1;
+    }
+    erow *row = &ce->row[y];
+    char *text = editorRowText(row);
+    int c = text[x];
+    if (!IS_BRACKET(c)) return 0;
+
+    //The piece of the row with the bracket in it first
+    bracketScan bs = {{0, 0, 0}, malloc(sizeof(int) * 16), 0, 16};
+    int piece = editorBracketPieceAt(row, x);
+    editorLexBracketPiece(ce, row, piece, &bs);
+    int k = 0;
+    while (k < bs.numPos && bs.pos[k] != x) k++;
+
+    int forward = (c == '(' || c == '[' || c == '{');
+    int need = 1;
+    int found = -1;
+    int m = y;
+    if (k < bs.numPos){
+        found = brScan(text, &bs, k, forward, &need);
+        if (found == -1) found = brScanPieces(ce, row, piece, forward, &need, &bs);
+        if (found == -1){
+            m = forward ? brFindForward(ce, y + 1, &need) : brFindBackward(ce, y - 1, &need);
+            if (m != -1){
+                row = &ce->row[m];
+                text = editorRowText(row);
+                found = brScanPieces(ce, row, forward ? -1 : editorBracketPieces(row), forward, &need, &bs);
+            }
+        }
+    }
+    free(bs.pos);
+
+    int o = (found != -1) ? text[found] : 0;
+    ce->bracketCacheValid = 1;
+    ce->bracketCacheY = y;
+    ce->bracketCacheX = x;
+    ce->bracketCacheFound = found != -1 && (forward ? brPairs(c, o) : brPairs(o, c));
+    ce->bracketCacheMy = m;
+    ce->bracketCacheMx = found;
+    if (!ce->bracketCacheFound) return 0;
+    *my = m;
+    *mx = found;
+    return 1;
+}
@@ -0,0 +1,22 @@
+#ifndef BRACKETS_C_
+#define BRACKETS_C_
+#include "CometTex.h"
+
+#define IS_BRACKET(c) ((c) == '(' || (c) == ')' || (c) == '[' || (c) == ']' || (c) == '{' || (c) == '}')
+
+//What the lexer found in a row, and where if pos is given
+typedef struct bracketScan{
+    bracketSummary s;
+    int *pos;
+    int numPos;
+    int posCap;
+} bracketScan;
+
+bracketSummary editorBracketJoin(bracketSummary a, bracketSummary b);
+void editorBracketSee(bracketScan *bs, int c, int at);
+void editorBracketScanText(bracketScan *bs, const char *s, int len);
+void editorBracketsRowChanged(editorConfig *ce, erow *row, bracketScan *bs);
+void editorBracketsRowsMoved(editorConfig *ce);
+int editorBracketMatch(editorConfig *ce, int y, int x, int *my, int *mx);
+
+#endif
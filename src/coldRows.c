@@ -0,0 +1,278 @@
+#include <stdlib.h>
+#include <string.h>
+#include "CometTex.h"
+#include "ops.h"
+#include "lz.h"
+#include "rowAlloc.h"
+#include "coldRows.h"
+#include "window.h"
+
+/*
+ Memory budget mode. When the row buffers go over the budget, rows away from the
+ screen are frozen: their text is packed into a block compressed with lz.c and
+ everything the row owns (chars, render, highlight, checkpoints) is freed.
+ A cold row keeps its size and hlOpenComment, and coldBlock/coldOff say where its text is.
+
+ Reading a cold row (search, save, highlighting) goes through a small LRU of decompressed
+ blocks. Anything that draws or edits a row thaws it first, which makes it a normal row again.
+
+ Rows opened from a session (see session.c) start out cold too, without a budget their
+ blocks are kept as they are and read straight from data.
+*/
+
+typedef struct coldBlock{
+    char *data;
+    int compLen;    //rawLen for a block that isn't compressed
+    int rawLen;
+    int liveRows;
+    int packed;
+} coldBlock;
+
+typedef struct coldCache{
+    int block;
+    char *raw;
+    int rawLen;
+    unsigned long lastUse;
+} coldCache;
+
+static size_t budget = 0;
+static coldBlock *blocks = NULL;
+static int numBlocks = 0;
+static coldCache cache[COMETTEX_COLD_CACHE];
+static unsigned long useClock = 0;
+//Where editorColdTrim goes on looking for rows to freeze
+static int scanRow = 0;
+static coldStats stats;
+
+void editorColdInit(size_t b){
+    budget = b;
+    for (int i = 0;i<COMETTEX_COLD_CACHE;i++) cache[i].block = -1;
+}
+
+int editorColdEnabled(){
+    return budget != 0;
+}
+
+static void editorColdDropBlock(int b){
+    for (int i = 0;i<COMETTEX_COLD_CACHE;i++){
+        if (cache[i].block == b){
+            stats.cacheBytes -= cache[i].rawLen;
+            free(cache[i].raw);
+            cache[i].raw = NULL;
+            cache[i].block = -1;
+        }
+    }
+    stats.compressedBytes -= blocks[b].compLen;
+    stats.rawBytes -= blocks[b].rawLen;
+    stats.numBlocks--;
+    free(blocks[b].data);
+    blocks[b].data = NULL;
+}
+
+//The decompressed text of a block, from the cache if it's there
+static char *editorColdBlockText(int b){
+    //Touches nothing, so rows of these can be read from more than one thread
+    if (!blocks[b].packed) return blocks[b].data;
+    useClock++;
+    int victim = 0;
+    for (int i = 0;i<COMETTEX_COLD_CACHE;i++){
+        if (cache[i].block == b){
+            cache[i].lastUse = useClock;
+            return cache[i].raw;
+        }
+        if (cache[i].block == -1 || (cache[victim].block != -1 && cache[i].lastUse < cache[victim].lastUse)){
+            victim = i;
+        }
+    }
+
+    coldCache *c = &cache[victim];
+    if (c->block != -1){
+        stats.cacheBytes -= c->rawLen;
+        free(c->raw);
+    }
+    c->raw = malloc(blocks[b].rawLen);
+    c->rawLen = blocks[b].rawLen;
+    c->block = b;
+    c->lastUse = useClock;
+    stats.cacheBytes += c->rawLen;
+    if (lzDecompress(blocks[b].data, blocks[b].compLen, c->raw, c->rawLen) != c->rawLen){
+        die("Cold row block is corrupt");
+    }
+    return c->raw;
+}
+
+/*
+ The text of a row whether it's cold or not, always '\0' terminated
+ For a cold row it's only good until the next block has to be decompressed
+*/
+char *editorRowText(erow *row){
+    if (row->coldBlock == -1) return row->chars;
+    return editorColdBlockText(row->coldBlock) + row->coldOff;
+}
+
+static void editorColdRelease(erow *row){
+    coldBlock *b = &blocks[row->coldBlock];
+    b->liveRows--;
+    stats.coldRows--;
+    if (b->liveRows == 0) editorColdDropBlock(row->coldBlock);
+    row->coldBlock = -1;
+}
+
+//Gives a cold row its buffers back so it can be drawn or edited
+void editorRowThaw(editorConfig *ce, erow *row){
+    if (row->coldBlock == -1) return;
+
+    char *text = editorRowText(row);
+    row->chars = rowAlloc(row->size + 1);
+    memcpy(row->chars, text, row->size + 1);
+    editorColdRelease(row);
+    editorUpdateRow(ce, row);
+}
+
+//A cold row is going away
+void editorRowFreeCold(erow *row){
+    if (row->coldBlock != -1) editorColdRelease(row);
+}
+
+static int editorRowVisible(editorConfig *ce, int at){
+    if (at == ce->my || (at >= ce->rowOffset && at < ce->rowOffset + ce->screenRow)) return 1;
+    //The other windows keep theirs in their editorWindow
+    for (int w = 0;w<ce->numWindows;w++){
+        editorWindow *win = &ce->windows[w];
+        if (w != ce->curWindow && at >= win->rowOffset && at < win->rowOffset + win->height) return 1;
+    }
+    return 0;
+}
+
+static int editorColdNewBlock(char *data, int compLen, int rawLen, int rows){
+    //Reuse the slot of a block that's gone
+    int b = 0;
+    while (b < numBlocks && blocks[b].data != NULL) b++;
+    if (b == numBlocks){
+        blocks = realloc(blocks, sizeof(coldBlock) * (numBlocks + 1));
+        numBlocks++;
+    }
+    blocks[b].data = data;
+    blocks[b].compLen = compLen;
+    blocks[b].rawLen = rawLen;
+    blocks[b].liveRows = rows;
+    blocks[b].packed = 0;
+    stats.compressedBytes += compLen;
+    stats.rawBytes += rawLen;
+    stats.numBlocks++;
+    stats.coldRows += rows;
+    return b;
+}
+
+static size_t editorHotBytes();
+
+/*
+ Takes text, rawLen bytes from malloc holding rows '\0' terminated one after the other, as
+ a block for rows cold rows and returns it. It's compressed once the budget is used up
+*/
+int editorColdAddBlock(char *text, int rawLen, int rows){
+    if (!budget || editorHotBytes() + stats.compressedBytes + rawLen <= budget){
+        return editorColdNewBlock(text, rawLen, rawLen, rows);
+    }
+
+    char *comp = malloc(lzCompressBound(rawLen));
+    int compLen = lzCompress(text, rawLen, comp);
+    free(text);
+    int b = editorColdNewBlock(realloc(comp, compLen), compLen, rawLen, rows);
+    blocks[b].packed = 1;
+    return b;
+}
+
+//Freezes the rows of [from, to) that aren't cold yet or on screen, as few blocks as it takes
+void editorFreezeRows(editorConfig *ce, int from, int to){
+    int at = from;
+    while (at < to){
+        //Collect one block worth of rows
+        int rows[COMETTEX_COLD_BLOCK_ROWS];
+        int n = 0;
+        int rawLen = 0;
+        while (at < to && n < COMETTEX_COLD_BLOCK_ROWS && (n == 0 || rawLen + ce->row[at].size + 1 <= COMETTEX_COLD_BLOCK_BYTES)){
+            erow *row = &ce->row[at];
+            if (row->coldBlock == -1 && !editorRowVisible(ce, at)){
+                rows[n++] = at;
+                rawLen += row->size + 1;
+            }
+            at++;
+        }
+        if (n == 0) continue;
+
+        char *raw = malloc(rawLen);
+        int off = 0;
+        for (int i = 0;i<n;i++){
+            erow *row = &ce->row[rows[i]];
+            memcpy(&raw[off], row->chars, row->size + 1);
+            off += row->size + 1;
+        }
+
+        char *comp = malloc(lzCompressBound(rawLen));
+        int compLen = lzCompress(raw, rawLen, comp);
+        free(raw);
+
+        int b = editorColdNewBlock(realloc(comp, compLen), compLen, rawLen, n);
+        blocks[b].packed = 1;
+
+        off = 0;
+        for (int i = 0;i<n;i++){
+            erow *row = &ce->row[rows[i]];
+            //The row keeps its size and stays in the histograms, only its buffers go
+            editorRowFreeBuffers(row);
+            row->chars = NULL;
+            row->render = NULL;
+            row->renderShared = 0;
+            row->rsize = 0;
+            row->hl = NULL;
+            row->numHl = 0;
+            row->rxCheckpoints = NULL;
+            row->numRxCheckpoints = 0;
+            row->coldBlock = b;
+            row->coldOff = off;
+            editorRowAccount(ce, row);
+            off += row->size + 1;
+        }
+    }
+}
+
+static size_t editorHotBytes(){
+    rowAllocStats st;
+    rowAllocGetStats(&st);
+    return st.liveBytes + st.largeBytes;
+}
+
+//Freezes rows, going around the buffer, until the hot rows fit in the budget again
+void editorColdTrim(editorConfig *ce){
+    if (!budget || ce->numRows == 0) return;
+
+    int scanned = 0;
+    while (editorHotBytes() > budget && scanned < ce->numRows){
+        if (scanRow >= ce->numRows) scanRow = 0;
+        int to = scanRow + COMETTEX_COLD_BLOCK_ROWS;
+        if (to > ce->numRows) to = ce->numRows;
+        editorFreezeRows(ce, scanRow, to);
+        scanned += to - scanRow;
+        scanRow = to;
+    }
+}
+
+void editorColdReset(){
+    for (int i = 0;i<numBlocks;i++) free(blocks[i].data);
+    free(blocks);
+    blocks = NULL;
+    numBlocks = 0;
+    for (int i = 0;i<COMETTEX_COLD_CACHE;i++){
+        free(cache[i].raw);
+        cache[i].raw = NULL;
+        cache[i].block = -1;
+    }
+    scanRow = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+void editorColdGetStats(coldStats *st){
+    *st = stats;
+    st->budget = budget;
+}
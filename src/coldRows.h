@@ -0,0 +1,32 @@
+#ifndef COLDROWS_C_
+#define COLDROWS_C_
+#include <stddef.h>
+#include "CometTex.h"
+
+//Rows frozen together, and how much raw text a block can hold
+#define COMETTEX_COLD_BLOCK_ROWS 512
+#define COMETTEX_COLD_BLOCK_BYTES (64 * 1024)
+//How many decompressed blocks are kept around
+#define COMETTEX_COLD_CACHE 8
+
+typedef struct coldStats{
+    size_t budget;
+    size_t compressedBytes;
+    size_t rawBytes;
+    size_t cacheBytes;
+    int numBlocks;
+    int coldRows;
+} coldStats;
+
+void editorColdInit(size_t budget);
+int editorColdEnabled();
+char *editorRowText(erow *row);
+void editorRowThaw(editorConfig *ce, erow *row);
+void editorRowFreeCold(erow *row);
+void editorFreezeRows(editorConfig *ce, int from, int to);
+int editorColdAddBlock(char *text, int rawLen, int rows);
+void editorColdTrim(editorConfig *ce);
+void editorColdReset();
+void editorColdGetStats(coldStats *st);
+
+#endif
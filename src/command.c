@@ -1,9 +1,18 @@
+#include <errno.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
 #include "ops.h"
 #include "fileIO.h"
 #include "command.h"
 #include "CometTex.h"
+#include "replace.h"
+#include "perf.h"
+#include "stats.h"
+#include "wrap.h"
+#include "filter.h"
+#include "undo.h"
+#include "window.h"
 
 void commandPrompt(editorConfig *ce, char *n){
     editorInsertChar(ce,n[0]);
@@ -23,4 +32,164 @@ void commandPrompt(editorConfig *ce, char *n){
             exit(0);
             break;
     }
-}
\ No newline at end of file
+}
+
+//Splits the next part of s/find/repl/ off at the delimiter, \ escapes it
+static char *commandField(char **p, char delim){
+    char *start = *p;
+    char *out = start;
+    char *in = start;
+    while (*in && *in != delim){
+        if (in[0] == '\\' && (in[1] == delim || in[1] == '\\')) in++;
+        *out++ = *in++;
+    }
+    if (*in == delim) in++;
+    *out = '\0';
+    *p = in;
+    return start;
+}
+
+//:trace file starts a Chrome trace of every frame, :trace alone stops it
+static void commandTrace(char *arg){
+    while (*arg == ' ') arg++;
+    if (*arg == '\0'){
+        if (!editorPerfTracing()){
+            editorSetStatusMessage("Not tracing");
+            return;
+        }
+        editorPerfTraceStop();
+        editorSetStatusMessage("Trace written");
+        return;
+    }
+    if (editorPerfTraceStart(arg) == -1){
+        editorSetStatusMessage("Can't write trace to %s: %s", arg, strerror(errno));
+        return;
+    }
+    editorSetStatusMessage("Tracing to %s", arg);
+}
+
+//Filters rows [at, at + n) through cmd and says how it went
+void editorFilterCommand(editorConfig *ce, int at, int n, char *cmd){
+    while (*cmd == ' ') cmd++;
+    if (*cmd == '\0'){
+        editorSetStatusMessage("No command to filter through");
+        return;
+    }
+    int rows;
+    int code = editorFilterRows(ce, at, n, cmd, &rows);
+    if (code == -1){
+        editorSetStatusMessage("Can't run %s: %s", cmd, strerror(errno));
+    }else if (code != 0){
+        editorSetStatusMessage("%s exited with %d, nothing changed", cmd, code);
+    }else{
+        //Undo keeps it however big, but only until the next change makes room
+        undoStats st;
+        editorUndoGetStats(&st);
+        if (st.textBytes > COMETTEX_UNDO_BYTES){
+            editorSetStatusMessage("%d lines filtered into %d, too big to undo after the next change", n, rows);
+        }else{
+            editorSetStatusMessage("%d lines filtered into %d", n, rows);
+        }
+        ce->my = (at < ce->numRows) ? at : ce->numRows;
+        ce->mx = 0;
+    }
+}
+
+//Reads the rows a command goes over off the front of it: % for all of them, N or N,M
+//counting from 1, or the cursor row when there's none. Returns 0 when they don't exist
+static int commandRange(editorConfig *ce, char **p, int *at, int *n){
+    char *s = *p;
+    if (*s == '%'){
+        *p = s + 1;
+        *at = 0;
+        *n = ce->numRows;
+        return ce->numRows > 0;
+    }
+    long from = ce->my + 1, to = ce->my + 1;
+    if (*s >= '0' && *s <= '9'){
+        from = to = strtol(s, &s, 10);
+        if (*s == ','){
+            s++;
+            to = strtol(s, &s, 10);
+        }
+    }
+    *p = s;
+    if (from < 1 || to < from || from > ce->numRows) return 0;
+    if (to > ce->numRows) to = ce->numRows;
+    *at = from - 1;
+    *n = to - from + 1;
+    return 1;
+}
+
+//Runs a line typed after :
+//s/find/repl/ replaces every match, perf toggles the latency HUD, trace [file] traces frames,
+//mem shows what the buffer costs, wrap toggles soft wrap, [range]!cmd filters rows through cmd,
+//split, close and only open and close windows
+void editorCommand(editorConfig *ce, char *cmd){
+    if (!strcmp(cmd, "split") || !strcmp(cmd, "sp")){
+        if (!editorWindowSplit(ce)) editorSetStatusMessage("No room for another window");
+        return;
+    }
+    if (!strcmp(cmd, "close")){
+        if (!editorWindowClose(ce)) editorSetStatusMessage("Can't close the last window");
+        return;
+    }
+    if (!strcmp(cmd, "only")){
+        if (!editorWindowOnly(ce)) editorSetStatusMessage("Already only one window");
+        return;
+    }
+    if (!strcmp(cmd, "wrap")){
+        editorWrapSetWidth(ce, ce->wrapWidth ? 0 : ce->screenCol);
+        editorSetStatusMessage(ce->wrapWidth ? "Soft wrap on" : "Soft wrap off");
+        return;
+    }
+    if (!strcmp(cmd, "mem")){
+        char summary[sizeof(ce->statusMsg)];
+        editorMemorySummary(ce, summary, sizeof(summary));
+        editorSetStatusMessage("%s", summary);
+        return;
+    }
+    if (!strcmp(cmd, "perf")){
+        editorTogglePerfHud();
+        return;
+    }
+    if (!strncmp(cmd, "trace", 5) && (cmd[5] == '\0' || cmd[5] == ' ')){
+        commandTrace(cmd + 5);
+        return;
+    }
+
+    char *p = cmd;
+    int at, lines;
+    char *range = p;
+    int exists = commandRange(ce, &range, &at, &lines);
+    if (*range == '!'){
+        if (exists){
+            editorFilterCommand(ce, at, lines, range + 1);
+        }else{
+            editorSetStatusMessage("No such lines");
+        }
+        return;
+    }
+
+    if (*p == '%') p++;
+    if (*p != 's' || p[1] == '\0' || p[1] == ' '){
+        editorSetStatusMessage("Not a command: %s", cmd);
+        return;
+    }
+    char delim = p[1];
+    p += 2;
+    char *find = commandField(&p, delim);
+    char *repl = commandField(&p, delim);
+    if (*find == '\0'){
+        editorSetStatusMessage("Nothing to find");
+        return;
+    }
+
+    int rows;
+    int n = editorReplaceAll(ce, find, repl, &rows);
+    if (n == 0){
+        editorSetStatusMessage("Pattern not found: %s", find);
+    }else{
+        editorSetStatusMessage("%d substitutions on %d lines", n, rows);
+    }
+}
@@ -2,5 +2,7 @@
 #define COMMAND_C_
 
 void commandPrompt(editorConfig *ce, char *n);
+void editorCommand(editorConfig *ce, char *cmd);
+void editorFilterCommand(editorConfig *ce, int at, int n, char *cmd);
 
 #endif
\ No newline at end of file
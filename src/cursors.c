@@ -0,0 +1,274 @@
+#include <stdlib.h>
+#include <string.h>
+#include "CometTex.h"
+#include "ops.h"
+#include "rowAlloc.h"
+#include "coldRows.h"
+#include "undo.h"
+#include "utf8.h"
+#include "cursors.h"
+
+/*
+ Extra cursors. mx,my stays the main cursor, the others live in ce->cursors sorted by
+ row and then char. An edit is applied to the main cursor and all the others at once:
+ the cursors are grouped per row, every row is rebuilt once with all its edits and gets
+ a single editorUpdateRow, and the whole thing is one change for undo.
+*/
+
+static int editorCursorCmp(const void *a, const void *b){
+    const editorCursor *x = a, *y = b;
+    if (x->my != y->my) return x->my - y->my;
+    return x->mx - y->mx;
+}
+
+void editorClearCursors(editorConfig *ce){
+    ce->numCursors = 0;
+}
+
+void editorAddCursor(editorConfig *ce, int my, int mx){
+    if (ce->numCursors == ce->cursorCap){
+        ce->cursorCap = ce->cursorCap ? ce->cursorCap * 2 : 16;
+        ce->cursors = realloc(ce->cursors, sizeof(editorCursor) * ce->cursorCap);
+    }
+    ce->cursors[ce->numCursors].my = my;
+    ce->cursors[ce->numCursors].mx = mx;
+    ce->numCursors++;
+}
+
+//Sorts the extra cursors and drops the ones sitting on another cursor
+static void editorCursorsNormalize(editorConfig *ce){
+    if (ce->numCursors == 0) return;
+    qsort(ce->cursors, ce->numCursors, sizeof(editorCursor), editorCursorCmp);
+    int n = 0;
+    for (int i = 0;i<ce->numCursors;i++){
+        editorCursor *c = &ce->cursors[i];
+        if (c->my == ce->my && c->mx == ce->mx) continue;
+        if (n > 0 && c->my == ce->cursors[n - 1].my && c->mx == ce->cursors[n - 1].mx) continue;
+        ce->cursors[n++] = *c;
+    }
+    ce->numCursors = n;
+}
+
+//Every cursor, the main one included, sorted. *mainIdx says which one is mx,my
+static editorCursor *editorCursorsAll(editorConfig *ce, int *n, int *mainIdx){
+    editorCursor *all = malloc(sizeof(editorCursor) * (ce->numCursors + 1));
+    int k = 0;
+    int placed = 0;
+    for (int i = 0;i<ce->numCursors;i++){
+        editorCursor *c = &ce->cursors[i];
+        if (!placed && editorCursorCmp(&(editorCursor){ce->mx, ce->my}, c) < 0){
+            *mainIdx = k;
+            all[k].mx = ce->mx;
+            all[k++].my = ce->my;
+            placed = 1;
+        }
+        all[k++] = *c;
+    }
+    if (!placed){
+        *mainIdx = k;
+        all[k].mx = ce->mx;
+        all[k++].my = ce->my;
+    }
+    *n = k;
+    return all;
+}
+
+static void editorCursorsSet(editorConfig *ce, editorCursor *all, int n, int mainIdx){
+    ce->mx = all[mainIdx].mx;
+    ce->my = all[mainIdx].my;
+    ce->numCursors = 0;
+    for (int i = 0;i<n;i++){
+        if (i != mainIdx) editorAddCursor(ce, all[i].my, all[i].mx);
+    }
+    editorCursorsNormalize(ce);
+    free(all);
+}
+
+//A cursor on every match of query, the main one on the first match from the cursor on
+int editorCursorsFromMatches(editorConfig *ce, const char *query){
+    size_t len = strlen(query);
+    if (len == 0) return 0;
+
+    editorClearCursors(ce);
+    int mainSet = 0;
+    int n = 0;
+    for (int y = 0;y<ce->numRows;y++){
+        char *text = editorRowText(&ce->row[y]);
+        char *p = text;
+        while ((p = strstr(p, query)) != NULL){
+            int x = p - text;
+            if (!mainSet && (y > ce->my || (y == ce->my && x >= ce->mx))){
+                ce->my = y;
+                ce->mx = x;
+                mainSet = 1;
+            }else{
+                editorAddCursor(ce, y, x);
+            }
+            n++;
+            p += len;
+        }
+    }
+    if (!mainSet && ce->numCursors){
+        //Every match is above the cursor, take the first one
+        ce->my = ce->cursors[0].my;
+        ce->mx = ce->cursors[0].mx;
+    }
+    editorCursorsNormalize(ce);
+    return n;
+}
+
+//A cursor on each of the n rows below, at the same column as the main cursor
+void editorCursorsColumn(editorConfig *ce, int n){
+    if (ce->my >= ce->numRows) return;
+    erow *row = &ce->row[ce->my];
+    editorRowThaw(ce, row);
+    int rx = rowMxToRx(row, ce->mx);
+
+    for (int y = ce->my + 1; y <= ce->my + n && y < ce->numRows;y++){
+        row = &ce->row[y];
+        editorRowThaw(ce, row);
+        editorAddCursor(ce, y, rowRxtoMx(row, rx));
+    }
+    editorCursorsNormalize(ce);
+}
+
+//Index of the first cursor on row y or after it
+int editorCursorsFirstOnRow(editorConfig *ce, int y){
+    int lo = 0, hi = ce->numCursors;
+    while (lo < hi){
+        int mid = (lo + hi) / 2;
+        if (ce->cursors[mid].my < y) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+//Inserts s, which has no newline, at every cursor
+void editorMultiInsert(editorConfig *ce, const char *s, int len){
+    int n, mainIdx;
+    editorCursor *all = editorCursorsAll(ce, &n, &mainIdx);
+
+    editorUndoBeginGroup();
+    for (int i = 0;i<n;){
+        int y = all[i].my;
+        int j = i;
+        while (j < n && all[j].my == y) j++;
+        if (y >= ce->numRows){
+            i = j;
+            continue;
+        }
+
+        //The new row is built once with every insert in it
+        erow *row = &ce->row[y];
+        editorRowThaw(ce, row);
+        int size = row->size + (j - i) * len;
+        char *buf = rowAlloc(size + 1);
+        char *p = buf;
+        int from = 0;
+        for (int k = i;k<j;k++){
+            int x = all[k].mx > row->size ? row->size : all[k].mx;
+            memcpy(p, &row->chars[from], x - from);
+            p += x - from;
+            editorUndoRecordInsert(ce, y, p - buf, s, len);
+            memcpy(p, s, len);
+            p += len;
+            from = x;
+            all[k].mx = p - buf;
+        }
+        memcpy(p, &row->chars[from], row->size - from + 1);
+
+        rowFree(row->chars, row->size + 1);
+        row->chars = buf;
+        row->size = size;
+        editorUpdateRow(ce, row);
+        i = j;
+    }
+    editorUndoEndGroup();
+    ce->dirty++;
+
+    editorCursorsSet(ce, all, n, mainIdx);
+}
+
+//Deletes the char before every cursor, or after it when forward
+//Cursors at the edge of their row don't join rows
+void editorMultiDelChar(editorConfig *ce, int forward){
+    int n, mainIdx;
+    editorCursor *all = editorCursorsAll(ce, &n, &mainIdx);
+
+    editorUndoBeginGroup();
+    for (int i = 0;i<n;){
+        int y = all[i].my;
+        int j = i;
+        while (j < n && all[j].my == y) j++;
+        if (y >= ce->numRows){
+            i = j;
+            continue;
+        }
+
+        erow *row = &ce->row[y];
+        editorRowThaw(ce, row);
+        char *buf = rowAlloc(row->size + 1);
+        char *p = buf;
+        int from = 0;
+        for (int k = i;k<j;k++){
+            int x = all[k].mx > row->size ? row->size : all[k].mx;
+            if (x < from) x = from;
+            int a = forward ? x : utf8PrevChar(row->chars, x);
+            int b = forward ? utf8NextChar(row->chars, row->size, x) : x;
+            if (a < from) a = from;
+            memcpy(p, &row->chars[from], a - from);
+            p += a - from;
+            editorUndoRecordDelete(ce, y, p - buf, &row->chars[a], b - a);
+            from = b;
+            all[k].mx = p - buf;
+        }
+        memcpy(p, &row->chars[from], row->size - from + 1);
+
+        int size = (p - buf) + row->size - from;
+        rowFree(row->chars, row->size + 1);
+        row->chars = rowRealloc(buf, row->size + 1, size + 1);
+        row->size = size;
+        editorUpdateRow(ce, row);
+        i = j;
+    }
+    editorUndoEndGroup();
+    ce->dirty++;
+
+    editorCursorsSet(ce, all, n, mainIdx);
+}
+
+//Splits the row at every cursor, each row once with all its splits. Goes bottom up so
+//the rows above don't move
+void editorMultiInsertNewLine(editorConfig *ce){
+    int n, mainIdx;
+    editorCursor *all = editorCursorsAll(ce, &n, &mainIdx);
+
+    int rows = ce->numRows;
+    int *xs = malloc(sizeof(int) * n);
+    editorUndoBeginGroup();
+    for (int j = n;j > 0;){
+        int y = all[j - 1].my;
+        int i = j;
+        while (i > 0 && all[i - 1].my == y) i--;
+        if (y < rows){
+            for (int k = i;k<j;k++) xs[k - i] = all[k].mx;
+            editorSplitRow(ce, y, xs, j - i);
+        }
+        j = i;
+    }
+    editorUndoEndGroup();
+    free(xs);
+
+    //Every cursor lands at the start of its new row, pushed down by the splits above it
+    int shift = 0;
+    for (int k = 0;k<n;k++){
+        if (all[k].my >= rows){
+            all[k].my = ce->numRows;
+            continue;
+        }
+        shift++;
+        all[k].my += shift;
+        all[k].mx = 0;
+    }
+    editorCursorsSet(ce, all, n, mainIdx);
+}
@@ -0,0 +1,14 @@
+#ifndef CURSORS_C_
+#define CURSORS_C_
+#include "CometTex.h"
+
+void editorClearCursors(editorConfig *ce);
+void editorAddCursor(editorConfig *ce, int my, int mx);
+int editorCursorsFromMatches(editorConfig *ce, const char *query);
+void editorCursorsColumn(editorConfig *ce, int n);
+int editorCursorsFirstOnRow(editorConfig *ce, int y);
+void editorMultiInsert(editorConfig *ce, const char *s, int len);
+void editorMultiDelChar(editorConfig *ce, int forward);
+void editorMultiInsertNewLine(editorConfig *ce);
+
+#endif
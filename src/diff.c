@@ -0,0 +1,299 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "CometTex.h"
+#include "coldRows.h"
+#include "diff.h"
+#include "window.h"
+
+/*
+ Diff against the saved file, for the gutter. diffRows holds a hash of the text of every
+ row and diffBase the hashes of the file's rows as it was opened or last saved, so comparing
+ rows is comparing two numbers and the file is never read again.
+
+ Where the buffer differs is a sorted list of hunks. Between them rows are the same as the
+ file's, shifted by however many rows the hunks before added. An edit only marks the rows
+ it touched in [diffFrom, diffTo), and before drawing editorDiffUpdate diffs just those
+ rows plus any hunk they touch, against the rows of the file between the hunks either side
+ of them. That's Myers' diff on the hashes, and for a keystroke it's a row or two.
+
+ The hunks are all the gutter reads, editorDiffMark finds the ones at a row.
+*/
+
+//Eight bytes at a time, every row of a file goes through it when it's opened
+static unsigned long long diffHash(const char *s, int len){
+    unsigned long long h = 0x9e3779b97f4a7c15ULL ^ (unsigned long long)len;
+    int i = 0;
+    for (;i + 8 <= len;i += 8){
+        unsigned long long w;
+        memcpy(&w, s + i, 8);
+        h = (h ^ w) * 0xff51afd7ed558ccdULL;
+        h ^= h >> 32;
+    }
+    unsigned long long w = 0;
+    memcpy(&w, s + i, len - i);
+    h = (h ^ w) * 0xff51afd7ed558ccdULL;
+    return h ^ (h >> 29);
+}
+
+static void diffMarkDirty(editorConfig *ce, int from, int to){
+    if (!ce->diffDirty){
+        ce->diffFrom = from;
+        ce->diffTo = to;
+        ce->diffDirty = 1;
+        return;
+    }
+    if (from < ce->diffFrom) ce->diffFrom = from;
+    if (to > ce->diffTo) ce->diffTo = to;
+}
+
+//The row's text changed, it's looked at again if its hash did. Thawing a row comes here too
+void editorDiffRowChanged(editorConfig *ce, erow *row){
+    unsigned long long h = diffHash(row->chars, row->size);
+    if (h == ce->diffRows[row->idx]) return;
+    ce->diffRows[row->idx] = h;
+    diffMarkDirty(ce, row->idx, row->idx + 1);
+}
+
+//Where row x of the buffer is after n rows are inserted (n > 0) or deleted (n < 0) at at
+static int diffMoveRow(int x, int at, int n){
+    if (n >= 0) return (x < at) ? x : x + n;
+    if (x <= at) return x;
+    return (x >= at - n) ? x + n : at;
+}
+
+//The hashes move with the rows, new rows have none until they're looked at
+static void diffMoveHashes(editorConfig *ce, int at, int n){
+    if (n > 0){
+        if (ce->numDiffRows + n > ce->diffRowsCap){
+            ce->diffRowsCap = ce->diffRowsCap ? ce->diffRowsCap : 64;
+            while (ce->numDiffRows + n > ce->diffRowsCap) ce->diffRowsCap *= 2;
+            ce->diffRows = realloc(ce->diffRows, sizeof(unsigned long long) * ce->diffRowsCap);
+        }
+        memmove(&ce->diffRows[at + n], &ce->diffRows[at], sizeof(unsigned long long) * (ce->numDiffRows - at));
+        memset(&ce->diffRows[at], 0, sizeof(unsigned long long) * n);
+    }else{
+        memmove(&ce->diffRows[at], &ce->diffRows[at - n], sizeof(unsigned long long) * (ce->numDiffRows - at + n));
+    }
+    ce->numDiffRows += n;
+}
+
+//Rows were inserted or deleted at at, the hunks after them move and the rows around get diffed
+void editorDiffRowsMoved(editorConfig *ce, int at, int n){
+    diffMoveHashes(ce, at, n);
+    for (int i = 0;i<ce->numDiffHunks;i++){
+        diffHunk *h = &ce->diffHunks[i];
+        int end = diffMoveRow(h->cur + h->curLen, at, n);
+        h->cur = diffMoveRow(h->cur, at, n);
+        h->curLen = end - h->cur;
+    }
+    if (ce->diffDirty){
+        ce->diffFrom = diffMoveRow(ce->diffFrom, at, n);
+        ce->diffTo = diffMoveRow(ce->diffTo, at, n);
+    }
+    diffMarkDirty(ce, at, at + (n > 0 ? n : 0));
+}
+
+static void diffClear(editorConfig *ce){
+    ce->numDiffHunks = 0;
+    ce->diffDirty = 0;
+    editorDamageRows(ce, 0, INT_MAX);
+    if (ce->numRows > ce->diffBaseCap){
+        ce->diffBaseCap = ce->numRows;
+        ce->diffBase = realloc(ce->diffBase, sizeof(unsigned long long) * ce->diffBaseCap);
+    }
+    ce->numDiffBase = ce->numRows;
+}
+
+//The buffer was just read from the file, it's what everything is compared to from now on
+void editorDiffReset(editorConfig *ce){
+    diffClear(ce);
+    for (int i = 0;i<ce->numRows;i++){
+        erow *row = &ce->row[i];
+        ce->diffRows[i] = diffHash(editorRowText(row), row->size);
+        ce->diffBase[i] = ce->diffRows[i];
+    }
+}
+
+//The buffer was just written to the file, nothing differs anymore
+void editorDiffSaved(editorConfig *ce){
+    diffClear(ce);
+    memcpy(ce->diffBase, ce->diffRows, sizeof(unsigned long long) * ce->numRows);
+}
+
+static void diffAddEdit(diffHunk **out, int *num, int *cap, int x, int y, int deleted){
+    diffHunk *h = *num ? &(*out)[*num - 1] : NULL;
+    if (h == NULL || h->base + h->baseLen != x || h->cur + h->curLen != y){
+        if (*num == *cap){
+            *cap = *cap ? *cap * 2 : 16;
+            *out = realloc(*out, sizeof(diffHunk) * *cap);
+        }
+        h = &(*out)[(*num)++];
+        h->base = x;
+        h->cur = y;
+        h->baseLen = h->curLen = 0;
+    }
+    if (deleted) h->baseLen++;
+    else h->curLen++;
+}
+
+/*
+ Myers' diff of the file's rows a[0, n) against the buffer's b[0, m). Appends the hunks to
+ out, offset by aOff and bOff, and returns 0, or -1 when it takes more than
+ COMETTEX_DIFF_MAX_EDITS rows added and deleted
+*/
+static int diffMyers(const unsigned long long *a, int n, const unsigned long long *b, int m,
+    int aOff, int bOff, diffHunk **out, int *num, int *cap){
+    int max = n + m;
+    if (max > COMETTEX_DIFF_MAX_EDITS) max = COMETTEX_DIFF_MAX_EDITS;
+    int *v = malloc(sizeof(int) * (2 * max + 2));
+    v[max + 1] = 0;
+    //v for every d is kept for going back: d's values for k in [-d, d] start at trace[d * d]
+    int *trace = NULL;
+    size_t traceCap = 0;
+
+    int found = -1;
+    for (int d = 0;d<=max && found == -1;d++){
+        for (int k = -d;k<=d;k += 2){
+            int x = (k == -d || (k != d && v[max + k - 1] < v[max + k + 1])) ? v[max + k + 1] : v[max + k - 1] + 1;
+            int y = x - k;
+            while (x < n && y < m && a[x] == b[y]){
+                x++;
+                y++;
+            }
+            v[max + k] = x;
+            if (x >= n && y >= m){
+                found = d;
+                break;
+            }
+        }
+        size_t need = (size_t)(d + 1) * (d + 1);
+        if (need > traceCap){
+            traceCap = need * 2;
+            trace = realloc(trace, sizeof(int) * traceCap);
+        }
+        memcpy(trace + (size_t)d * d, v + max - d, sizeof(int) * (2 * d + 1));
+    }
+    free(v);
+    if (found == -1){
+        free(trace);
+        return -1;
+    }
+
+    //Back from the end, the edits come out last first
+    int *edits = malloc(sizeof(int) * 3 * (found + 1));
+    int x = n, y = m;
+    for (int d = found;d>0;d--){
+        int *prev = trace + (size_t)(d - 1) * (d - 1) + (d - 1);
+        int k = x - y;
+        int down = (k == -d || (k != d && prev[k - 1] < prev[k + 1]));
+        int pk = down ? k + 1 : k - 1;
+        int px = prev[pk];
+        int py = px - pk;
+        edits[3 * (d - 1)] = px;
+        edits[3 * (d - 1) + 1] = py;
+        edits[3 * (d - 1) + 2] = !down;
+        x = px;
+        y = py;
+    }
+    for (int d = 0;d<found;d++){
+        diffAddEdit(out, num, cap, aOff + edits[3 * d], bOff + edits[3 * d + 1], edits[3 * d + 2]);
+    }
+    free(edits);
+    free(trace);
+    return 0;
+}
+
+//Diffs the rows changed since last time, and the hunks they touch, again
+void editorDiffUpdate(editorConfig *ce){
+    if (!ce->diffDirty) return;
+    ce->diffDirty = 0;
+
+    int s = ce->diffFrom, e = ce->diffTo;
+    if (s < 0) s = 0;
+    if (e > ce->numRows) e = ce->numRows;
+    if (s > e) s = e;
+
+    //The hunks touching [s, e] go, and the window grows to cover them
+    diffHunk *hunks = ce->diffHunks;
+    int i = 0;
+    while (i < ce->numDiffHunks && hunks[i].cur + hunks[i].curLen < s) i++;
+    int j = i;
+    while (j < ce->numDiffHunks && hunks[j].cur <= e){
+        if (hunks[j].cur < s) s = hunks[j].cur;
+        if (hunks[j].cur + hunks[j].curLen > e) e = hunks[j].cur + hunks[j].curLen;
+        j++;
+    }
+
+    //The file's rows in the same place, between the hunks either side
+    int bs = s, be = ce->numDiffBase - (ce->numRows - e);
+    if (i > 0) bs = hunks[i - 1].base + hunks[i - 1].baseLen + (s - hunks[i - 1].cur - hunks[i - 1].curLen);
+    if (j < ce->numDiffHunks) be = hunks[j].base - (hunks[j].cur - e);
+    if (bs < 0) bs = 0;
+    if (bs > ce->numDiffBase) bs = ce->numDiffBase;
+    if (be < bs) be = bs;
+    if (be > ce->numDiffBase) be = ce->numDiffBase;
+
+    //The marks from the row before to the one after can change
+    editorDamageRows(ce, (s > 0) ? s - 1 : 0, e + 1);
+
+    //What's the same at either end doesn't need diffing
+    int cs = s, ce_ = e;
+    while (cs < ce_ && bs < be && ce->diffRows[cs] == ce->diffBase[bs]){
+        cs++;
+        bs++;
+    }
+    while (cs < ce_ && bs < be && ce->diffRows[ce_ - 1] == ce->diffBase[be - 1]){
+        ce_--;
+        be--;
+    }
+
+    diffHunk *found = NULL;
+    int numFound = 0, foundCap = 0;
+    if (cs < ce_ || bs < be){
+        if (diffMyers(ce->diffBase + bs, be - bs, ce->diffRows + cs, ce_ - cs, bs, cs, &found, &numFound, &foundCap) == -1){
+            //Too different to be worth lining up, it's all one change
+            numFound = 0;
+            diffAddEdit(&found, &numFound, &foundCap, bs, cs, 1);
+            found[0].baseLen = be - bs;
+            found[0].curLen = ce_ - cs;
+        }
+    }
+
+    //Hunks [i, j) make way for what was found
+    int total = ce->numDiffHunks - (j - i) + numFound;
+    if (total > ce->diffHunksCap){
+        ce->diffHunksCap = total * 2;
+        ce->diffHunks = realloc(ce->diffHunks, sizeof(diffHunk) * ce->diffHunksCap);
+    }
+    hunks = ce->diffHunks;
+    memmove(&hunks[i + numFound], &hunks[j], sizeof(diffHunk) * (ce->numDiffHunks - j));
+    memcpy(&hunks[i], found, sizeof(diffHunk) * numFound);
+    ce->numDiffHunks = total;
+    free(found);
+}
+
+//What the gutter shows for row y: the kind of the hunk it's in, and whether rows of the
+//file were deleted right after it or, for the first row, before it
+int editorDiffMark(editorConfig *ce, int y){
+    //The first hunk that ends at y or after it
+    int lo = 0, hi = ce->numDiffHunks;
+    while (lo < hi){
+        int mid = (lo + hi) / 2;
+        if (ce->diffHunks[mid].cur + ce->diffHunks[mid].curLen < y) lo = mid + 1;
+        else hi = mid;
+    }
+
+    int mark = DIFF_NONE;
+    for (int i = lo;i<ce->numDiffHunks && ce->diffHunks[i].cur <= y + 1;i++){
+        diffHunk *h = &ce->diffHunks[i];
+        if (h->curLen == 0){
+            if (h->baseLen == 0) continue;
+            if (h->cur == y + 1) mark |= DIFF_DELETED_BELOW;
+            else if (h->cur == 0 && y == 0) mark |= DIFF_DELETED_ABOVE;
+        }else if (y >= h->cur && y < h->cur + h->curLen){
+            mark |= (y - h->cur < h->baseLen) ? DIFF_MODIFIED : DIFF_ADDED;
+        }
+    }
+    return mark;
+}
@@ -0,0 +1,36 @@
+#ifndef DIFF_C_
+#define DIFF_C_
+#include "CometTex.h"
+
+//Columns left of the text for the markers
+#define COMETTEX_DIFF_GUTTER 2
+//Past this many rows added and deleted in one window it's all one change
+#define COMETTEX_DIFF_MAX_EDITS 1024
+
+//What editorDiffMark says about a row, the kind in the low bits plus the deleted bits
+enum editorDiffKind{
+    DIFF_NONE = 0,
+    DIFF_ADDED,
+    DIFF_MODIFIED,
+};
+#define DIFF_KIND_MASK 0x3
+//Rows of the saved file were deleted right after this row, or before the first row
+#define DIFF_DELETED_BELOW 0x4
+#define DIFF_DELETED_ABOVE 0x8
+
+//Rows [cur, cur + curLen) of the buffer stand where [base, base + baseLen) of the saved file were
+typedef struct diffHunk{
+    int cur;
+    int curLen;
+    int base;
+    int baseLen;
+} diffHunk;
+
+void editorDiffRowChanged(editorConfig *ce, erow *row);
+void editorDiffRowsMoved(editorConfig *ce, int at, int n);
+void editorDiffReset(editorConfig *ce);
+void editorDiffSaved(editorConfig *ce);
+void editorDiffUpdate(editorConfig *ce);
+int editorDiffMark(editorConfig *ce, int y);
+
+#endif
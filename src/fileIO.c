@@ -1,55 +1,17 @@
 #include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include "ops.h"
 #include "CometTex.h"
 #include "syntaxHighlighting.h"
-
-#define COMETTEX_CONFIG_FILENAME "comettex.con"
-
-//-------------------Function currently Does not Work----------------
-// char searchConfigFile(char* _n){
-//     FILE *f = fopen("src/comettex.con", "r");
-//     if (!f) die("fopen config:");
-
-//     char *result = NULL;
-//     char *l = NULL;
-//     size_t lCap = 0;
-//     ssize_t lLen;
-//     char p[124][124];
-//     int i = 0, c = 0, j = 0;
-//     while ((lLen = getline(&l, &lCap, f)) != -1){
-//         if (!strncmp(l,_n,strlen(_n))){
-//             int h = 1;
-//             int len = 1;
-//             int found = 0;
-//             while (l[strlen(_n) + len] != '\0'){
-//                 if (l[strlen(_n) + len] != ':' && !found){
-//                     h++;
-//                 }else{
-//                     found = 1;
-//                 }
-//                 len++;
-//             }
-//             //PROBLEM
-//             result = getSubString(l,result,h,len);
-//         }
-//         if (*l == ' ' || *l == '\0'){
-//             p[c][j] = '\0';
-//             j=0;
-//             c++;
-//         }else{
-//             p[c][j] = _n[i];
-//             j++;
-//         }
-//         i++;
-//     }
-//     fclose(f);
-//     die("Couldn't find config defination");
-// }
+#include "rowAlloc.h"
+#include "coldRows.h"
+#include "session.h"
+#include "diff.h"
 
 int getSubString(char* src,char* dest, int from, int to){
     int length = 0;
@@ -89,7 +51,7 @@ char *editorRowsToString(editorConfig *ce, int *_buflen){
 
     char *p = buf;
     for (int i = 0;i<ce->numRows;i++){
-        memcpy(p, ce->row[i].chars, ce->row[i].size);
+        memcpy(p, editorRowText(&ce->row[i]), ce->row[i].size);
         p += ce->row[i].size;
         *p = '\n';
         p++;
@@ -100,6 +62,7 @@ char *editorRowsToString(editorConfig *ce, int *_buflen){
 void editorOpen(editorConfig *ce, char *_filename){
     FILE *fp;
 
+    editorFreeRows(ce);
     ce->dirty = 0;
     free(ce->filename);
     size_t fnlen = strlen(_filename)+1;
@@ -112,6 +75,27 @@ void editorOpen(editorConfig *ce, char *_filename){
             perror("Opening file");
             exit(1);
         }
+        //A new file, nothing to read
+        editorDiffReset(ce);
+        return;
+    }
+
+    //Get the arena for all the rows in one go. A bit more than the file for the size class rounding
+    //With a memory budget only the budget's worth will ever be hot at once
+    struct stat st;
+    if (fstat(fileno(fp), &st) == 0){
+        //Opened the same way before, nothing needs going over
+        if (editorSessionOpen(ce, fileno(fp), &st)){
+            fclose(fp);
+            editorDiffReset(ce);
+            ce->dirty = 0;
+            return;
+        }
+        size_t reserve = st.st_size + st.st_size / 4;
+        coldStats cs;
+        editorColdGetStats(&cs);
+        if (cs.budget && reserve > cs.budget) reserve = cs.budget;
+        rowAllocReserve(reserve);
     }
 
     char *line = NULL;
@@ -121,40 +105,68 @@ void editorOpen(editorConfig *ce, char *_filename){
         if (linelen && (line[linelen-1] == '\n' || line[linelen-1] == '\r'))
             line[--linelen] = '\0';
         editorInsertRow(ce, ce->numRows,line,linelen);
+        //Freeze as we go so the whole file is never expanded at once
+        if (ce->numRows % COMETTEX_COLD_BLOCK_ROWS == 0) editorColdTrim(ce);
     }
     free(line);
     fclose(fp);
+    editorColdTrim(ce);
+    editorDiffReset(ce);
     ce->dirty = 0;
 }
 
-void editorSave(editorConfig *ce){
-    if (ce->filename == NULL){
-        ce->filename = editorPrompt("Save as: %s (ESC to cancel", NULL);
-        if (ce->filename == NULL){
-            editorSetStatusMessage("Save aborted");
-            return;
+static int writeAll(int fd, const char *buf, size_t len){
+    while (len > 0){
+        ssize_t n = write(fd, buf, len);
+        if (n == -1){
+            if (errno == EINTR) continue;
+            return -1;
         }
-        editorSelectSyntaxHighlight(ce);
+        buf += n;
+        len -= n;
     }
+    return 0;
+}
 
+//Writes every row followed by a \n through one small buffer
+static int editorWriteRows(editorConfig *ce, int fd){
+    char buf[64 * 1024];
+    size_t used = 0;
+    for (int i = 0;i<ce->numRows;i++){
+        char *text = editorRowText(&ce->row[i]);
+        size_t size = ce->row[i].size;
+        if (used + size + 1 > sizeof(buf)){
+            if (writeAll(fd, buf, used) == -1) return -1;
+            used = 0;
+        }
+        if (size + 1 > sizeof(buf)){
+            if (writeAll(fd, text, size) == -1) return -1;
+            buf[used++] = '\n';
+        }else{
+            memcpy(&buf[used], text, size);
+            used += size;
+            buf[used++] = '\n';
+        }
+    }
+    return writeAll(fd, buf, used);
+}
 
-    int len;
-    char *buf = editorRowsToString(ce,&len);
+//Writes every row to ce->filename, returns the bytes written or -1 with errno set
+long long editorWriteFile(editorConfig *ce){
+    //Rows are written as they are, cold ones straight from their block, so the file is never copied whole
+    long long len = 0;
+    for (int i = 0;i<ce->numRows;i++) len += ce->row[i].size + 1;
 
     int fd = open(ce->filename, O_RDWR | O_CREAT, 0644);
-    if (fd != -1){
-        if (ftruncate(fd, len) != -1){
-            if (write(fd, buf, len) == len){
-                close(fd);
-                free(buf);
-                ce->dirty = 0;
-                editorSetStatusMessage("%d bytes written to disk", len);
-                return;
-            }
-        }
-       close(fd);
+    if (fd == -1) return -1;
+    if (ftruncate(fd, len) == -1 || editorWriteRows(ce, fd) == -1){
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
     }
-
-    free(buf);
-    editorSetStatusMessage("Can't Save! I/O error %s", strerror(errno));
-}
\ No newline at end of file
+    close(fd);
+    editorDiffSaved(ce);
+    ce->dirty = 0;
+    return len;
+}
@@ -5,7 +5,6 @@
 int getSubString(char* src,char* dest, int from, int to);
 char *editorRowsToString(editorConfig *ce, int *buflen);
 void editorOpen(editorConfig *ce, char *filename);
-void editorSave(editorConfig *ce);
-char *searchConfigFile(char *n);
+long long editorWriteFile(editorConfig *ce);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,253 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include "CometTex.h"
+#include "ops.h"
+#include "rowAlloc.h"
+#include "coldRows.h"
+#include "filter.h"
+
+/*
+ Filtering rows through a command, :%!sort or 5!!jq . and the like. The command runs under
+ /bin/sh with a pipe on each end. The rows go into one a batch at a time with writev,
+ straight from the rows (a '\n' after each), and whatever comes out of the other is cut into
+ lines as it comes. Both pipes are polled together, so a command that writes before it's
+ read everything, like most do, can't block on a full pipe while we block on the other.
+
+ Each line comes out already in a row sized buffer, and only if the command exits 0 do they
+ go in place of the rows with one editorSpliceRows. Otherwise the rows are left as they were.
+*/
+
+typedef struct filterOut{
+    char **lines;
+    int *lens;
+    int num;
+    int cap;
+    char *part;     //The line that hasn't seen its '\n' yet
+    int partLen;
+} filterOut;
+
+static void filterAddLine(filterOut *out, char *line, int len){
+    if (len > 0 && line[len - 1] == '\r'){
+        line = rowRealloc(line, len + 1, len);
+        len--;
+        line[len] = '\0';
+    }
+    if (out->num == out->cap){
+        out->cap = out->cap ? out->cap * 2 : 256;
+        out->lines = realloc(out->lines, sizeof(char *) * out->cap);
+        out->lens = realloc(out->lens, sizeof(int) * out->cap);
+    }
+    out->lines[out->num] = line;
+    out->lens[out->num] = len;
+    out->num++;
+}
+
+//Adds len bytes to the end of the unfinished line
+static void filterAddPart(filterOut *out, const char *s, int len){
+    if (out->part == NULL){
+        out->part = rowAlloc(len + 1);
+    }else{
+        out->part = rowRealloc(out->part, out->partLen + 1, out->partLen + len + 1);
+    }
+    memcpy(out->part + out->partLen, s, len);
+    out->partLen += len;
+    out->part[out->partLen] = '\0';
+}
+
+//Cuts what was read into lines, the tail waits in part for the rest of its line
+static void filterTake(filterOut *out, const char *s, int len){
+    const char *end = s + len;
+    const char *nl;
+    while ((nl = memchr(s, '\n', end - s)) != NULL){
+        if (out->part){
+            filterAddPart(out, s, nl - s);
+            filterAddLine(out, out->part, out->partLen);
+            out->part = NULL;
+            out->partLen = 0;
+        }else{
+            char *line = rowAlloc(nl - s + 1);
+            memcpy(line, s, nl - s);
+            line[nl - s] = '\0';
+            filterAddLine(out, line, nl - s);
+        }
+        s = nl + 1;
+    }
+    if (s < end) filterAddPart(out, s, end - s);
+}
+
+static void filterOutFree(filterOut *out){
+    for (int i = 0;i<out->num;i++) rowFree(out->lines[i], out->lens[i] + 1);
+    if (out->part) rowFree(out->part, out->partLen + 1);
+    free(out->lines);
+    free(out->lens);
+}
+
+/*
+ Writes the next batch of rows from row *y, *x chars into it (x == size is only its '\n'
+ left). Cold rows are read in place, so a batch stops at a second cold block: reading one
+ can push the one before out of the cache
+*/
+static ssize_t filterWriteRows(editorConfig *ce, int fd, int *y, int *x, int end){
+    static const char nl = '\n';
+    struct iovec iov[COMETTEX_FILTER_BATCH * 2];
+    int n = 0;
+    int coldBlock = -1;
+    for (int j = *y;j<end && n + 2 <= COMETTEX_FILTER_BATCH * 2;j++){
+        erow *row = &ce->row[j];
+        if (row->coldBlock != -1){
+            if (coldBlock != -1 && row->coldBlock != coldBlock) break;
+            coldBlock = row->coldBlock;
+        }
+        int from = (j == *y) ? *x : 0;
+        if (from < row->size){
+            iov[n].iov_base = editorRowText(row) + from;
+            iov[n].iov_len = row->size - from;
+            n++;
+        }
+        iov[n].iov_base = (void *)&nl;
+        iov[n].iov_len = 1;
+        n++;
+    }
+
+    ssize_t w = writev(fd, iov, n);
+    if (w <= 0) return w;
+    //Move past what went, a row at a time
+    size_t left = w;
+    while (left > 0){
+        size_t rest = ce->row[*y].size - *x + 1;
+        if (left < rest){
+            *x += left;
+            break;
+        }
+        left -= rest;
+        (*y)++;
+        *x = 0;
+    }
+    return w;
+}
+
+static pid_t filterSpawn(const char *cmd, int *in, int *out){
+    int inPipe[2], outPipe[2];
+    if (pipe2(inPipe, O_CLOEXEC) == -1) return -1;
+    if (pipe2(outPipe, O_CLOEXEC) == -1){
+        close(inPipe[0]);
+        close(inPipe[1]);
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0){
+        //Nothing of it can go to the terminal, the editor owns that
+        int null = open("/dev/null", O_WRONLY);
+        dup2(inPipe[0], STDIN_FILENO);
+        dup2(outPipe[1], STDOUT_FILENO);
+        if (null != -1) dup2(null, STDERR_FILENO);
+        signal(SIGPIPE, SIG_DFL);
+        execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+        _exit(127);
+    }
+    close(inPipe[0]);
+    close(outPipe[1]);
+    if (pid == -1){
+        close(inPipe[1]);
+        close(outPipe[0]);
+        return -1;
+    }
+    fcntl(inPipe[1], F_SETFL, O_NONBLOCK);
+    *in = inPipe[1];
+    *out = outPipe[0];
+    return pid;
+}
+
+/*
+ Runs rows [at, at + n) through cmd and puts what it prints in their place. Returns the
+ command's exit status, the rows are only replaced on 0, or -1 with errno set when it
+ couldn't be run. *rowsOut is how many rows came out
+*/
+int editorFilterRows(editorConfig *ce, int at, int n, const char *cmd, int *rowsOut){
+    *rowsOut = 0;
+    if (at < 0 || at >= ce->numRows || n <= 0){
+        errno = EINVAL;
+        return -1;
+    }
+    if (n > ce->numRows - at) n = ce->numRows - at;
+
+    //A command that stops reading early makes the writes fail with EPIPE, not kill us
+    struct sigaction ign, oldPipe;
+    memset(&ign, 0, sizeof(ign));
+    ign.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &ign, &oldPipe);
+
+    int in, outFd;
+    pid_t pid = filterSpawn(cmd, &in, &outFd);
+    if (pid == -1){
+        int err = errno;
+        sigaction(SIGPIPE, &oldPipe, NULL);
+        errno = err;
+        return -1;
+    }
+
+    filterOut out;
+    memset(&out, 0, sizeof(out));
+    char buf[COMETTEX_FILTER_READ];
+    int y = at, x = 0;
+    while (outFd != -1){
+        struct pollfd fds[2];
+        int nfds = 0;
+        fds[nfds].fd = outFd;
+        fds[nfds++].events = POLLIN;
+        if (in != -1){
+            fds[nfds].fd = in;
+            fds[nfds++].events = POLLOUT;
+        }
+        if (poll(fds, nfds, -1) == -1){
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (in != -1 && fds[1].revents){
+            ssize_t w = filterWriteRows(ce, in, &y, &x, at + n);
+            if ((w == -1 && errno != EAGAIN && errno != EINTR) || y == at + n){
+                close(in);
+                in = -1;
+            }
+        }
+        if (fds[0].revents){
+            ssize_t r = read(outFd, buf, sizeof(buf));
+            if (r > 0){
+                filterTake(&out, buf, r);
+            }else if (r == 0 || errno != EINTR){
+                close(outFd);
+                outFd = -1;
+            }
+        }
+    }
+    if (in != -1) close(in);
+    if (outFd != -1) close(outFd);
+
+    int status;
+    while (waitpid(pid, &status, 0) == -1 && errno == EINTR);
+    sigaction(SIGPIPE, &oldPipe, NULL);
+    int code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+
+    //A last line without a '\n' is still a line
+    if (out.part){
+        filterAddLine(&out, out.part, out.partLen);
+        out.part = NULL;
+    }
+    if (code == 0){
+        editorSpliceRows(ce, at, n, out.lines, out.lens, out.num);
+        *rowsOut = out.num;
+        out.num = 0;
+    }
+    filterOutFree(&out);
+    return code;
+}
@@ -0,0 +1,12 @@
+#ifndef FILTER_C_
+#define FILTER_C_
+#include "CometTex.h"
+
+//Rows written to the command per writev
+#define COMETTEX_FILTER_BATCH 64
+//Read from the command at a time
+#define COMETTEX_FILTER_READ (64 * 1024)
+
+int editorFilterRows(editorConfig *ce, int at, int n, const char *cmd, int *rowsOut);
+
+#endif
@@ -0,0 +1,553 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "syntaxHighlighting.h"
+#include "languages.h"
+
+/*
+ Language definitions. Every language is a NAME.lang file in the language directory:
+
+   # Lines starting with # are comments
+   name: python
+   match: .py .pyw SConstruct
+   comment: #
+   multiline: """ """
+   keywords: if elif else for while return def class
+   types: int str float bool
+   imports: import from
+   highlight: numbers strings
+
+ match takes extensions, starting with a dot, and whole file names.
+
+ Nothing is parsed at startup. What file type goes with which definition file is kept in
+ a binary cache: a hash table of every extension and file name, the definition files and
+ their mtimes, all offsets into one block so it's mmapped and used as it is. It's built again
+ when the directory or one of the files in it has a different mtime, which is a stat per
+ language at startup, and opening a file only parses the one definition it needs.
+
+ The definitions compiled in, HLDB, come after the directory so a file there can replace them.
+*/
+
+#define LANG_CACHE_MAGIC "CTLANG1"
+
+typedef struct langCacheHeader{
+    char magic[8];
+    long long dirMtime;
+    long long dirMtimeNs;
+    int dir;        //The directory this is for, offsets are into the strings after the slots
+    int numLangs;
+    int numSlots;   //A power of two
+    int stringsLen;
+} langCacheHeader;
+
+typedef struct langCacheEntry{
+    int file;
+    long long mtime;
+    long long mtimeNs;
+} langCacheEntry;
+
+typedef struct langCacheSlot{
+    unsigned int hash;
+    int pattern;
+    int lang;       //-1 for an empty slot
+} langCacheSlot;
+
+static char *langDir = NULL;
+static int langInit = 0;
+//The cache, either mmapped or built in memory when it couldn't be written
+static char *cache = NULL;
+static size_t cacheLen = 0;
+static int cacheMapped = 0;
+static langCacheHeader *header = NULL;
+static langCacheEntry *entries = NULL;
+static langCacheSlot *slots = NULL;
+static char *strings = NULL;
+//Definitions parsed so far, by entry
+static struct editorSyntax **loaded = NULL;
+//Same table for HLDB
+static langCacheSlot builtinSlots[64];
+static int builtinReady = 0;
+
+static unsigned int langHash(const char *s){
+    unsigned int h = 2166136261u;
+    while (*s){
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static char *langPath(const char *env, const char *sub, const char *name){
+    const char *base = getenv(env);
+    char *path;
+    if (base && *base){
+        path = malloc(strlen(base) + strlen(name) + 2);
+        sprintf(path, "%s/%s", base, name);
+        return path;
+    }
+    const char *home = getenv("HOME");
+    if (home == NULL) return NULL;
+    path = malloc(strlen(home) + strlen(sub) + strlen(name) + 3);
+    sprintf(path, "%s/%s/%s", home, sub, name);
+    return path;
+}
+
+static int langStrCmp(const void *a, const void *b){
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+//Splits value into the words separated by spaces, in place, NULL terminated
+static char **langWords(char *value, int *n){
+    int cap = 8;
+    char **words = malloc(sizeof(char *) * cap);
+    *n = 0;
+    char *p = value;
+    while (*p){
+        while (*p && isspace((unsigned char)*p)) *p++ = '\0';
+        if (*p == '\0') break;
+        if (*n + 1 == cap){
+            cap *= 2;
+            words = realloc(words, sizeof(char *) * cap);
+        }
+        words[(*n)++] = p;
+        while (*p && !isspace((unsigned char)*p)) p++;
+    }
+    words[*n] = NULL;
+    return words;
+}
+
+//Reads the next "key: value" line of f, comments and blank lines are skipped
+static int langNextLine(FILE *f, char **line, size_t *cap, char **key, char **value){
+    while (getline(line, cap, f) != -1){
+        char *p = *line;
+        while (isspace((unsigned char)*p)) p++;
+        if (*p == '#' || *p == '\0') continue;
+        char *colon = strchr(p, ':');
+        if (colon == NULL) continue;
+        *colon = '\0';
+        char *end = colon;
+        while (end > p && isspace((unsigned char)end[-1])) *--end = '\0';
+        *key = p;
+        p = colon + 1;
+        while (isspace((unsigned char)*p)) p++;
+        end = p + strlen(p);
+        while (end > p && isspace((unsigned char)end[-1])) *--end = '\0';
+        *value = p;
+        return 1;
+    }
+    return 0;
+}
+
+static void langUnmap(){
+    if (cacheMapped) munmap(cache, cacheLen);
+    else free(cache);
+    free(loaded);
+    cache = NULL;
+    cacheLen = 0;
+    cacheMapped = 0;
+    header = NULL;
+    loaded = NULL;
+}
+
+//Points the tables into a cache block, 0 if it's not a good one for langDir
+static int langUse(char *block, size_t len){
+    if (len < sizeof(langCacheHeader)) return 0;
+    langCacheHeader *h = (langCacheHeader *)block;
+    if (memcmp(h->magic, LANG_CACHE_MAGIC, sizeof(h->magic)) != 0) return 0;
+    if (h->numLangs < 0 || h->numSlots <= 0 || (h->numSlots & (h->numSlots - 1)) || h->stringsLen <= 0) return 0;
+    size_t need = sizeof(langCacheHeader) + sizeof(langCacheEntry) * h->numLangs + sizeof(langCacheSlot) * h->numSlots + h->stringsLen;
+    if (need != len) return 0;
+
+    char *p = block + sizeof(langCacheHeader);
+    entries = (langCacheEntry *)p;
+    p += sizeof(langCacheEntry) * h->numLangs;
+    slots = (langCacheSlot *)p;
+    p += sizeof(langCacheSlot) * h->numSlots;
+    strings = p;
+    if (strings[h->stringsLen - 1] != '\0' || h->dir < 0 || h->dir >= h->stringsLen) return 0;
+    if (strcmp(&strings[h->dir], langDir) != 0) return 0;
+
+    //Every offset and index is used as is later, and langFind probes until an empty slot
+    for (int i = 0;i<h->numLangs;i++){
+        if (entries[i].file < 0 || entries[i].file >= h->stringsLen) return 0;
+    }
+    int empty = 0;
+    for (int i = 0;i<h->numSlots;i++){
+        if (slots[i].lang == -1){
+            empty = 1;
+            continue;
+        }
+        if (slots[i].lang < -1 || slots[i].lang >= h->numLangs) return 0;
+        if (slots[i].pattern < 0 || slots[i].pattern >= h->stringsLen) return 0;
+    }
+    if (!empty) return 0;
+
+    header = h;
+    loaded = calloc(h->numLangs ? h->numLangs : 1, sizeof(struct editorSyntax *));
+    return 1;
+}
+
+//Good while the directory and every definition in it have the mtimes the cache was built with
+static int langCacheFresh(){
+    struct stat st;
+    if (stat(langDir, &st) == -1) return 0;
+    if (header->dirMtime != (long long)st.st_mtim.tv_sec || header->dirMtimeNs != (long long)st.st_mtim.tv_nsec) return 0;
+
+    char *path = malloc(strlen(langDir) + 2);
+    int fresh = 1;
+    for (int i = 0;i<header->numLangs && fresh;i++){
+        const char *file = strings + entries[i].file;
+        path = realloc(path, strlen(langDir) + strlen(file) + 2);
+        sprintf(path, "%s/%s", langDir, file);
+        fresh = stat(path, &st) == 0 && entries[i].mtime == (long long)st.st_mtim.tv_sec &&
+            entries[i].mtimeNs == (long long)st.st_mtim.tv_nsec;
+    }
+    free(path);
+    return fresh;
+}
+
+static void langLoadCache(){
+    char *path = langPath("XDG_CACHE_HOME", ".cache", "comettex/" COMETTEX_LANG_CACHE);
+    if (path == NULL) return;
+    int fd = open(path, O_RDONLY);
+    free(path);
+    if (fd == -1) return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0){
+        char *block = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (block != MAP_FAILED){
+            cache = block;
+            cacheLen = st.st_size;
+            cacheMapped = 1;
+            if (!langUse(block, st.st_size) || !langCacheFresh()) langUnmap();
+        }
+    }
+    close(fd);
+}
+
+static void langWriteCache(){
+    char *path = langPath("XDG_CACHE_HOME", ".cache", "comettex/" COMETTEX_LANG_CACHE);
+    if (path == NULL) return;
+
+    //Make the directories on the way, the cache is only an optimisation so failing is fine
+    for (char *p = strchr(path + 1, '/'); p; p = strchr(p + 1, '/')){
+        *p = '\0';
+        mkdir(path, 0755);
+        *p = '/';
+    }
+
+    char *tmp = malloc(strlen(path) + 16);
+    sprintf(tmp, "%s.%d", path, (int)getpid());
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd != -1){
+        int ok = write(fd, cache, cacheLen) == (ssize_t)cacheLen;
+        close(fd);
+        if (!ok || rename(tmp, path) == -1) unlink(tmp);
+    }
+    free(tmp);
+    free(path);
+}
+
+//Reads the name and match lines of every definition and builds the cache from them
+static void langBuildCache(){
+    langUnmap();
+
+    struct stat dirSt;
+    DIR *d = opendir(langDir);
+    if (d == NULL || fstat(dirfd(d), &dirSt) == -1){
+        if (d) closedir(d);
+        return;
+    }
+
+    //Sorted so the same directory always gives the same cache, and the first file wins a clash
+    char **files = NULL;
+    int numFiles = 0, filesCap = 0;
+    struct dirent *de;
+    size_t suffixLen = strlen(COMETTEX_LANG_SUFFIX);
+    while ((de = readdir(d)) != NULL){
+        size_t len = strlen(de->d_name);
+        if (de->d_name[0] == '.' || len <= suffixLen || strcmp(de->d_name + len - suffixLen, COMETTEX_LANG_SUFFIX)) continue;
+        if (numFiles == filesCap){
+            filesCap = filesCap ? filesCap * 2 : 64;
+            files = realloc(files, sizeof(char *) * filesCap);
+        }
+        files[numFiles++] = strdup(de->d_name);
+    }
+    closedir(d);
+    qsort(files, numFiles, sizeof(char *), langStrCmp);
+
+    //Strings and patterns are collected first, the block is laid out once their sizes are known
+    size_t strCap = 4096, strLen = 0;
+    char *strs = malloc(strCap);
+    int *patterns = NULL, *patternLang = NULL;
+    int numPatterns = 0, patternCap = 0;
+    langCacheEntry *ents = malloc(sizeof(langCacheEntry) * (numFiles ? numFiles : 1));
+    int numLangs = 0;
+
+    #define LANG_ADD_STRING(s, off) do{ \
+        size_t l_ = strlen(s) + 1; \
+        while (strLen + l_ > strCap) strCap *= 2; \
+        strs = realloc(strs, strCap); \
+        memcpy(strs + strLen, s, l_); \
+        off = strLen; \
+        strLen += l_; \
+    }while (0)
+
+    int dirOff;
+    LANG_ADD_STRING(langDir, dirOff);
+
+    char *line = NULL;
+    size_t lineCap = 0;
+    char *pathBuf = malloc(strlen(langDir) + 2);
+    for (int i = 0;i<numFiles;i++){
+        pathBuf = realloc(pathBuf, strlen(langDir) + strlen(files[i]) + 2);
+        sprintf(pathBuf, "%s/%s", langDir, files[i]);
+        FILE *f = fopen(pathBuf, "r");
+        struct stat st;
+        if (f == NULL || fstat(fileno(f), &st) == -1){
+            if (f) fclose(f);
+            continue;
+        }
+
+        char *key, *value;
+        while (langNextLine(f, &line, &lineCap, &key, &value)){
+            if (strcmp(key, "match") != 0) continue;
+            int n;
+            char **words = langWords(value, &n);
+            for (int w = 0;w<n;w++){
+                if (numPatterns == patternCap){
+                    patternCap = patternCap ? patternCap * 2 : 256;
+                    patterns = realloc(patterns, sizeof(int) * patternCap);
+                    patternLang = realloc(patternLang, sizeof(int) * patternCap);
+                }
+                LANG_ADD_STRING(words[w], patterns[numPatterns]);
+                patternLang[numPatterns++] = numLangs;
+            }
+            free(words);
+            break;
+        }
+        fclose(f);
+
+        LANG_ADD_STRING(files[i], ents[numLangs].file);
+        ents[numLangs].mtime = st.st_mtim.tv_sec;
+        ents[numLangs].mtimeNs = st.st_mtim.tv_nsec;
+        numLangs++;
+    }
+    #undef LANG_ADD_STRING
+    free(line);
+    free(pathBuf);
+    for (int i = 0;i<numFiles;i++) free(files[i]);
+    free(files);
+
+    //Half empty at most so probes stay short
+    int numSlots = 16;
+    while (numSlots < numPatterns * 2) numSlots *= 2;
+
+    cacheLen = sizeof(langCacheHeader) + sizeof(langCacheEntry) * numLangs + sizeof(langCacheSlot) * numSlots + strLen;
+    cache = calloc(1, cacheLen);
+    cacheMapped = 0;
+    langCacheHeader *h = (langCacheHeader *)cache;
+    memcpy(h->magic, LANG_CACHE_MAGIC, sizeof(h->magic));
+    h->dirMtime = dirSt.st_mtim.tv_sec;
+    h->dirMtimeNs = dirSt.st_mtim.tv_nsec;
+    h->dir = dirOff;
+    h->numLangs = numLangs;
+    h->numSlots = numSlots;
+    h->stringsLen = strLen;
+
+    char *p = cache + sizeof(langCacheHeader);
+    memcpy(p, ents, sizeof(langCacheEntry) * numLangs);
+    p += sizeof(langCacheEntry) * numLangs;
+    langCacheSlot *sl = (langCacheSlot *)p;
+    for (int i = 0;i<numSlots;i++) sl[i].lang = -1;
+    for (int i = 0;i<numPatterns;i++){
+        unsigned int hash = langHash(strs + patterns[i]);
+        unsigned int k = hash & (numSlots - 1);
+        int dup = 0;
+        while (sl[k].lang != -1){
+            if (sl[k].hash == hash && !strcmp(strs + sl[k].pattern, strs + patterns[i])) dup = 1;
+            k = (k + 1) & (numSlots - 1);
+        }
+        if (dup) continue;
+        sl[k].hash = hash;
+        sl[k].pattern = patterns[i];
+        sl[k].lang = patternLang[i];
+    }
+    p += sizeof(langCacheSlot) * numSlots;
+    memcpy(p, strs, strLen);
+
+    free(strs);
+    free(patterns);
+    free(patternLang);
+    free(ents);
+
+    langUse(cache, cacheLen);
+    langWriteCache();
+}
+
+//Turns a definition file into an editorSyntax, NULL if it can't be read
+static struct editorSyntax *langParse(const char *path){
+    FILE *f = fopen(path, "r");
+    if (f == NULL) return NULL;
+
+    struct editorSyntax *s = calloc(1, sizeof(struct editorSyntax));
+    char **empty = calloc(1, sizeof(char *));
+    s->fileMatch = s->keywords = s->importwords = empty;
+    //Types are keywords ending in | for the lexer, they're added after the keywords
+    char **types = NULL;
+    int numTypes = 0, numKeywords = 0;
+
+    char *line = NULL;
+    size_t lineCap = 0;
+    char *key, *value;
+    while (langNextLine(f, &line, &lineCap, &key, &value)){
+        int n;
+        //The words point into this copy, it lives as long as the definition
+        char **words = langWords(strdup(value), &n);
+        if (!strcmp(key, "name") && n){
+            s->fileType = words[0];
+        }else if (!strcmp(key, "match")){
+            s->fileMatch = words;
+            continue;
+        }else if (!strcmp(key, "keywords")){
+            s->keywords = words;
+            numKeywords = n;
+            continue;
+        }else if (!strcmp(key, "types")){
+            types = words;
+            numTypes = n;
+            continue;
+        }else if (!strcmp(key, "imports")){
+            s->importwords = words;
+            continue;
+        }else if (!strcmp(key, "comment") && n){
+            s->singleCommentStart = words[0];
+        }else if (!strcmp(key, "multiline") && n == 2){
+            s->multiCommentStart = words[0];
+            s->multiCommentEnd = words[1];
+        }else if (!strcmp(key, "highlight")){
+            for (int i = 0;i<n;i++){
+                if (!strcmp(words[i], "numbers")) s->flags |= HL_HIGHLIGHT_NUMBERS;
+                else if (!strcmp(words[i], "strings")) s->flags |= HL_HIGHLIGHT_STRINGS;
+            }
+        }
+        free(words);
+    }
+    free(line);
+    fclose(f);
+
+    if (numTypes){
+        char **all = malloc(sizeof(char *) * (numKeywords + numTypes + 1));
+        memcpy(all, s->keywords, sizeof(char *) * numKeywords);
+        for (int i = 0;i<numTypes;i++){
+            size_t len = strlen(types[i]);
+            all[numKeywords + i] = malloc(len + 2);
+            memcpy(all[numKeywords + i], types[i], len);
+            memcpy(all[numKeywords + i] + len, "|", 2);
+        }
+        all[numKeywords + numTypes] = NULL;
+        if (s->keywords != empty) free(s->keywords);
+        s->keywords = all;
+        free(types);
+    }
+    if (s->fileType == NULL) s->fileType = strdup("?");
+    return s;
+}
+
+//Where the definitions are: dir, or COMETTEX_LANG_DIR, or the comettex/languages config directory
+void editorLanguagesInit(const char *dir){
+    langUnmap();
+    free(langDir);
+    langDir = NULL;
+    if (dir == NULL) dir = getenv("COMETTEX_LANG_DIR");
+    if (dir && *dir) langDir = strdup(dir);
+    else langDir = langPath("XDG_CONFIG_HOME", ".config", "comettex/languages");
+    langInit = 1;
+
+    if (langDir == NULL) return;
+    langLoadCache();
+    if (header == NULL) langBuildCache();
+}
+
+static int langFind(langCacheSlot *sl, int numSlots, const char *base, const char *s){
+    unsigned int hash = langHash(s);
+    unsigned int k = hash & (numSlots - 1);
+    while (sl[k].lang != -1){
+        if (sl[k].hash == hash && !strcmp(base + sl[k].pattern, s)) return sl[k].lang;
+        k = (k + 1) & (numSlots - 1);
+    }
+    return -1;
+}
+
+//The whole file name first, then its extension
+static int langLookup(langCacheSlot *sl, int numSlots, const char *base, const char *filename){
+    const char *name = strrchr(filename, '/');
+    name = name ? name + 1 : filename;
+    int lang = langFind(sl, numSlots, base, name);
+    const char *ext = strrchr(name, '.');
+    if (lang == -1 && ext) lang = langFind(sl, numSlots, base, ext);
+    return lang;
+}
+
+//HLDB goes in a table of its own, with pattern as an index into HLDB's fileMatch strings
+static const char *builtinPatterns[64];
+
+static struct editorSyntax *langBuiltin(const char *filename){
+    int numSlots = sizeof(builtinSlots) / sizeof(builtinSlots[0]);
+    if (!builtinReady){
+        int n = 0;
+        for (int i = 0;i<numSlots;i++) builtinSlots[i].lang = -1;
+        for (unsigned int i = 0;i<HLDBEntries;i++){
+            for (char **m = HLDB[i].fileMatch; *m && n < numSlots / 2;m++){
+                unsigned int hash = langHash(*m);
+                unsigned int k = hash & (numSlots - 1);
+                while (builtinSlots[k].lang != -1) k = (k + 1) & (numSlots - 1);
+                builtinPatterns[n] = *m;
+                builtinSlots[k].hash = hash;
+                builtinSlots[k].pattern = n++;
+                builtinSlots[k].lang = i;
+            }
+        }
+        builtinReady = 1;
+    }
+
+    const char *name = strrchr(filename, '/');
+    name = name ? name + 1 : filename;
+    const char *ext = strrchr(name, '.');
+    for (int pass = 0;pass<2;pass++){
+        const char *s = pass ? ext : name;
+        if (s == NULL) continue;
+        unsigned int hash = langHash(s);
+        unsigned int k = hash & (numSlots - 1);
+        while (builtinSlots[k].lang != -1){
+            if (builtinSlots[k].hash == hash && !strcmp(builtinPatterns[builtinSlots[k].pattern], s)) return &HLDB[builtinSlots[k].lang];
+            k = (k + 1) & (numSlots - 1);
+        }
+    }
+    return NULL;
+}
+
+struct editorSyntax *editorLanguageFor(const char *filename){
+    if (!langInit) editorLanguagesInit(NULL);
+
+    if (header){
+        int lang = langLookup(slots, header->numSlots, strings, filename);
+        if (lang != -1 && loaded[lang] == NULL){
+            const char *file = strings + entries[lang].file;
+            char *path = malloc(strlen(langDir) + strlen(file) + 2);
+            sprintf(path, "%s/%s", langDir, file);
+            loaded[lang] = langParse(path);
+            free(path);
+        }
+        if (lang != -1 && loaded[lang]) return loaded[lang];
+    }
+    return langBuiltin(filename);
+}
@@ -0,0 +1,11 @@
+#ifndef LANGUAGES_C_
+#define LANGUAGES_C_
+
+//Language definitions, one NAME.lang file each
+#define COMETTEX_LANG_SUFFIX ".lang"
+#define COMETTEX_LANG_CACHE "languages.cache"
+
+void editorLanguagesInit(const char *dir);
+struct editorSyntax *editorLanguageFor(const char *filename);
+
+#endif
@@ -0,0 +1,136 @@
+#include <string.h>
+#include <stdint.h>
+#include "lz.h"
+
+/*
+ Small LZ77 codec for cold rows, same idea as an LZ4 block.
+ Each sequence is a token byte (literal count << 4 | match length - 4),
+ extra length bytes when a count is 15 or more, the literals, then a 2 byte offset
+ and the extra match length bytes. The last sequence only has literals.
+*/
+
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 12
+#define LZ_MAX_OFFSET 0xffff
+
+static uint32_t lzRead32(const char *p){
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static int lzHash(uint32_t v){
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static char *lzWriteLen(char *op, int len){
+    while (len >= 255){
+        *op++ = (char)255;
+        len -= 255;
+    }
+    *op++ = (char)len;
+    return op;
+}
+
+//Worst case size of lzCompress output
+int lzCompressBound(int len){
+    return len + len / 255 + 16;
+}
+
+//@returns the compressed size, dst needs lzCompressBound(len) bytes
+int lzCompress(const char *src, int len, char *dst){
+    int table[1 << LZ_HASH_BITS];
+    memset(table, -1, sizeof(table));
+
+    char *op = dst;
+    int anchor = 0;
+    int i = 0;
+    while (i + LZ_MIN_MATCH <= len){
+        uint32_t v = lzRead32(&src[i]);
+        int h = lzHash(v);
+        int ref = table[h];
+        table[h] = i;
+
+        if (ref < 0 || i - ref > LZ_MAX_OFFSET || lzRead32(&src[ref]) != v){
+            i++;
+            continue;
+        }
+
+        int mlen = LZ_MIN_MATCH;
+        while (i + mlen < len && src[ref + mlen] == src[i + mlen]) mlen++;
+
+        int lit = i - anchor;
+        int ml = mlen - LZ_MIN_MATCH;
+        *op++ = (char)(((lit < 15 ? lit : 15) << 4) | (ml < 15 ? ml : 15));
+        if (lit >= 15) op = lzWriteLen(op, lit - 15);
+        memcpy(op, &src[anchor], lit);
+        op += lit;
+
+        int off = i - ref;
+        *op++ = (char)(off & 0xff);
+        *op++ = (char)(off >> 8);
+        if (ml >= 15) op = lzWriteLen(op, ml - 15);
+
+        i += mlen;
+        anchor = i;
+    }
+
+    //Whatever is left goes out as literals
+    int lit = len - anchor;
+    *op++ = (char)((lit < 15 ? lit : 15) << 4);
+    if (lit >= 15) op = lzWriteLen(op, lit - 15);
+    memcpy(op, &src[anchor], lit);
+    op += lit;
+
+    return op - dst;
+}
+
+//@returns rawLen, or -1 if src is corrupt
+int lzDecompress(const char *src, int len, char *dst, int rawLen){
+    const unsigned char *ip = (const unsigned char *)src;
+    const unsigned char *end = ip + len;
+    int o = 0;
+
+    while (ip < end){
+        int token = *ip++;
+
+        int lit = token >> 4;
+        if (lit == 15){
+            int b;
+            do {
+                if (ip >= end) return -1;
+                b = *ip++;
+                lit += b;
+            } while (b == 255);
+        }
+        if (lit > end - ip || lit > rawLen - o) return -1;
+        memcpy(&dst[o], ip, lit);
+        ip += lit;
+        o += lit;
+
+        //The last sequence has no match
+        if (ip >= end) break;
+
+        if (end - ip < 2) return -1;
+        int off = ip[0] | (ip[1] << 8);
+        ip += 2;
+        int mlen = (token & 15);
+        if (mlen == 15){
+            int b;
+            do {
+                if (ip >= end) return -1;
+                b = *ip++;
+                mlen += b;
+            } while (b == 255);
+        }
+        mlen += LZ_MIN_MATCH;
+        if (off == 0 || off > o || mlen > rawLen - o) return -1;
+
+        //Byte by byte since the match can overlap what it's writing
+        for (int k = 0;k<mlen;k++){
+            dst[o] = dst[o - off];
+            o++;
+        }
+    }
+    return (o == rawLen) ? o : -1;
+}
@@ -0,0 +1,8 @@
+#ifndef LZ_C_
+#define LZ_C_
+
+int lzCompressBound(int len);
+int lzCompress(const char *src, int len, char *dst);
+int lzDecompress(const char *src, int len, char *dst, int rawLen);
+
+#endif
@@ -0,0 +1,78 @@
+#include <stdlib.h>
+#include "macro.h"
+
+/*
+ Keystroke macros. While recording, every key read from the terminal is appended to the
+ register. Replaying puts a register on the key queue, editorReadKey hands out queued
+ keys before it reads the terminal, so the key handlers run unchanged.
+*/
+
+typedef struct macroReg{
+    int *keys;
+    int len;
+    int cap;
+} macroReg;
+
+//Registers a to z
+static macroReg regs[26];
+static int recording = 0;
+
+static int *queue = NULL;
+static int queueLen = 0;
+static int queuePos = 0;
+
+static macroReg *macroGetReg(int reg){
+    if (reg < 'a' || reg > 'z') return NULL;
+    return &regs[reg - 'a'];
+}
+
+void editorMacroStart(int reg){
+    macroReg *r = macroGetReg(reg);
+    if (r == NULL) return;
+    r->len = 0;
+    recording = reg;
+}
+
+void editorMacroStop(){
+    macroReg *r = macroGetReg(recording);
+    //The key that stopped the recording was recorded too
+    if (r && r->len > 0) r->len--;
+    recording = 0;
+}
+
+int editorMacroRecording(){
+    return recording;
+}
+
+void editorMacroRecordKey(int key){
+    macroReg *r = macroGetReg(recording);
+    if (r == NULL) return;
+    if (r->len == r->cap){
+        r->cap = r->cap ? r->cap * 2 : 64;
+        r->keys = realloc(r->keys, sizeof(int) * r->cap);
+    }
+    r->keys[r->len++] = key;
+}
+
+int *editorMacroKeys(int reg, int *n){
+    macroReg *r = macroGetReg(reg);
+    *n = r ? r->len : 0;
+    return r ? r->keys : NULL;
+}
+
+//The keys aren't copied, they have to stay around until they're all read
+void editorQueueKeys(int *keys, int n){
+    queue = keys;
+    queueLen = n;
+    queuePos = 0;
+}
+
+int editorQueuedKey(int *key){
+    if (queuePos >= queueLen) return 0;
+    *key = queue[queuePos++];
+    return 1;
+}
+
+int editorKeysQueued(){
+    return queuePos < queueLen;
+}
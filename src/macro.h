@@ -0,0 +1,13 @@
+#ifndef MACRO_C_
+#define MACRO_C_
+
+void editorMacroStart(int reg);
+void editorMacroStop();
+int editorMacroRecording();
+void editorMacroRecordKey(int key);
+int *editorMacroKeys(int reg, int *n);
+void editorQueueKeys(int *keys, int n);
+int editorQueuedKey(int *key);
+int editorKeysQueued();
+
+#endif
@@ -2,167 +2,1052 @@
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
+#include <limits.h>
 #include "CometTex.h"
 #include "syntaxHighlighting.h"
 #include "ops.h"
+#include "utf8.h"
+#include "rowAlloc.h"
+#include "coldRows.h"
+#include "undo.h"
+#include "perf.h"
+#include "wrap.h"
+#include "rowTree.h"
+#include "symbols.h"
+#include "brackets.h"
+#include "diff.h"
+#include "window.h"
+
+//Columns taken by the char at chars[mx] when it starts at column rx. bytes is how long it is in chars
+static int rowCharWidth(erow *row, int mx, int rx, int *bytes){
+    unsigned char c = row->chars[mx];
+    *bytes = 1;
+    if (c == '\t') return COMETTEX_TAB_STOP - (rx % COMETTEX_TAB_STOP);
+    if (c < 0x80 || row->isAscii) return 1;
+
+    int cp;
+    *bytes = utf8Decode(&row->chars[mx], row->size - mx, &cp);
+    return utf8CharWidth(cp);
+}
+
+//Last checkpoint at or before mx
+static int rowCheckpointBefore(erow *row, int mx){
+    int lo = 0, hi = row->numRxCheckpoints - 1;
+    while (lo < hi){
+        int mid = (lo + hi + 1) / 2;
+        if (row->rxCheckpoints[mid].mx <= mx) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
 
 //Row MouseX to RowX
 int rowMxToRx(erow *row, int mx){
-    int rx = 0;
-    for (int i = 0;i<mx;i++){
-        if (row->chars[i] == '\t'){
-            rx += (COMETTEX_TAB_STOP - 1) - (rx % COMETTEX_TAB_STOP);
-        }
-        rx++;
+    if (row->rxCheckpoints == NULL) return mx;
+
+    //Start from the closest checkpoint instead of the beginning of the row
+    rxCheckpoint *cp = &row->rxCheckpoints[rowCheckpointBefore(row, mx)];
+    int rx = cp->rx;
+    int i = cp->mx;
+    while (i < mx){
+        int n;
+        rx += rowCharWidth(row, i, rx, &n);
+        i += n;
     }
     return rx;
 }
 
+//Row MouseX to the byte offset in the fully rendered row
+int rowMxToRb(erow *row, int mx){
+    if (row->rxCheckpoints == NULL) return mx;
+
+    rxCheckpoint *cp = &row->rxCheckpoints[rowCheckpointBefore(row, mx)];
+    int rx = cp->rx;
+    int rb = cp->rb;
+    int i = cp->mx;
+    while (i < mx){
+        int n;
+        int w = rowCharWidth(row, i, rx, &n);
+        //Tabs are rendered as one space per column
+        rb += (row->chars[i] == '\t') ? w : n;
+        rx += w;
+        i += n;
+    }
+    return rb;
+}
+
 //Row RowX to MouseX
 int rowRxtoMx(erow *row, int rx){
-    int cur_rx = 0;
-    int mx;
-    for (mx = 0;mx < row->size;mx++){
-        if (row->chars[mx] == '\t'){
-            cur_rx += (COMETTEX_TAB_STOP - 1) - (cur_rx % COMETTEX_TAB_STOP);
-        }
-        cur_rx++;
+    if (row->rxCheckpoints == NULL) return (rx < row->size) ? rx : row->size;
+
+    //Binary search for the last checkpoint that starts at or before rx
+    int lo = 0, hi = row->numRxCheckpoints - 1;
+    while (lo < hi){
+        int mid = (lo + hi + 1) / 2;
+        if (row->rxCheckpoints[mid].rx <= rx) lo = mid;
+        else hi = mid - 1;
+    }
+
+    int cur_rx = row->rxCheckpoints[lo].rx;
+    int mx = row->rxCheckpoints[lo].mx;
+    while (mx < row->size){
+        int n;
+        cur_rx += rowCharWidth(row, mx, cur_rx, &n);
 
         if (cur_rx > rx) return mx;
+        mx += n;
     }
     return mx;
 }
 
-void editorUpdateRow(editorConfig *ce, erow *row){
+static void editorUpdateRxCheckpoints(erow *row, int tabs){
+    //ASCII rows without tabs don't need checkpoints since mx == rx
+    int num = (!tabs && row->isAscii) ? 0 : row->size / COMETTEX_RX_CHECKPOINT + 1;
+    row->rxCheckpoints = rowRealloc(row->rxCheckpoints, sizeof(rxCheckpoint) * row->numRxCheckpoints, sizeof(rxCheckpoint) * num);
+    row->numRxCheckpoints = num;
+    if (num == 0) return;
+
+    int k = 0;
+    int rx = 0, rb = 0;
+    int i = 0;
+    while (i < row->size){
+        //A multibyte char can start a little after the checkpoint
+        while (k * COMETTEX_RX_CHECKPOINT <= i){
+            row->rxCheckpoints[k].mx = i;
+            row->rxCheckpoints[k].rx = rx;
+            row->rxCheckpoints[k].rb = rb;
+            k++;
+        }
+        int n;
+        int w = rowCharWidth(row, i, rx, &n);
+        rb += (row->chars[i] == '\t') ? w : n;
+        rx += w;
+        i += n;
+    }
+    while (k < row->numRxCheckpoints){
+        row->rxCheckpoints[k].mx = row->size;
+        row->rxCheckpoints[k].rx = rx;
+        row->rxCheckpoints[k].rb = rb;
+        k++;
+    }
+}
+
+/*
+ The checkpoints of a row where del chars at at were just replaced by ins chars. The ones
+ before at still hold, the columns are walked again from the last of them. Past the change
+ the old ones are only moved: to the same chars, and by as many columns as the walk is off
+ when it gets to one, once that's a whole number of tab stops. Until then a tab after the
+ change would come out a different width, but up to the next tab every column moves the same
+*/
+static void editorShiftRxCheckpoints(erow *row, int at, int del, int ins){
+    rxCheckpoint *old = row->rxCheckpoints;
+    int numOld = row->numRxCheckpoints;
+    int delta = ins - del;
+    int k = rowCheckpointBefore(row, at);
+
+    int cap = numOld - k + 16;
+    rxCheckpoint *cps = malloc(sizeof(rxCheckpoint) * cap);
+    int n = 0;
+    int i = old[k].mx, rx = old[k].rx, rb = old[k].rb;
+    int next = i + COMETTEX_RX_CHECKPOINT;
+    int j = k + 1;
+    while (1){
+        while (j < numOld && (old[j].mx < at + del || old[j].mx + delta < i)) j++;
+        if (j < numOld && old[j].mx + delta == i){
+            int drx = rx - old[j].rx, drb = rb - old[j].rb;
+            int last = row->size;
+            if (drx % COMETTEX_TAB_STOP != 0){
+                char *tab = memchr(&row->chars[i], '\t', row->size - i);
+                if (tab) last = tab - row->chars;
+            }
+            if (n + numOld - j > cap){
+                cap = n + numOld - j;
+                cps = realloc(cps, sizeof(rxCheckpoint) * cap);
+            }
+            for (; j < numOld && old[j].mx + delta <= last;j++){
+                cps[n].mx = old[j].mx + delta;
+                cps[n].rx = old[j].rx + drx;
+                cps[n].rb = old[j].rb + drb;
+                n++;
+            }
+            if (last == row->size) break;
+            //On from the last one before the tab
+            i = cps[n - 1].mx;
+            rx = cps[n - 1].rx;
+            rb = cps[n - 1].rb;
+            next = i + COMETTEX_RX_CHECKPOINT;
+        }
+        if (i >= row->size) break;
+        if (i >= next){
+            if (n == cap){
+                cap *= 2;
+                cps = realloc(cps, sizeof(rxCheckpoint) * cap);
+            }
+            cps[n].mx = i;
+            cps[n].rx = rx;
+            cps[n].rb = rb;
+            n++;
+            next = i + COMETTEX_RX_CHECKPOINT;
+        }
+        int bytes;
+        int w = rowCharWidth(row, i, rx, &bytes);
+        rb += (row->chars[i] == '\t') ? w : bytes;
+        rx += w;
+        i += bytes;
+    }
+
+    int num = k + 1 + n;
+    row->rxCheckpoints = rowRealloc(row->rxCheckpoints, sizeof(rxCheckpoint) * numOld, sizeof(rxCheckpoint) * num);
+    row->numRxCheckpoints = num;
+    memcpy(&row->rxCheckpoints[k + 1], cps, sizeof(rxCheckpoint) * n);
+    free(cps);
+}
+
+//Frees what only a long row has, with its lexer checkpoints
+static void editorRowFreeLong(erow *row){
+    if (row->longRow == NULL) return;
+    rowFree(row->longRow->hlCheckpoints, sizeof(hlCheckpoint) * row->longRow->numHlCheckpoints);
+    rowFree(row->longRow, sizeof(longRow));
+    row->longRow = NULL;
+}
+
+//Expands chars[mstart..mend) into render
+static void editorRenderWindow(erow *row, int mstart, int mend){
     int tabs = 0;
-    for (int i = 0;i<row->size;i++){
-        if (row->chars[i] == '\t') tabs++;
+    char *t = memchr(&row->chars[mstart], '\t', mend - mstart);
+    while (t){
+        tabs++;
+        t = memchr(t + 1, '\t', &row->chars[mend] - t - 1);
+    }
+
+    if (!row->renderShared) rowFree(row->render, row->rsize + 1);
+    int rstart = 0, rbstart = 0;
+    if (row->size < COMETTEX_LONG_LINE){
+        editorRowFreeLong(row);
+    }else{
+        if (row->longRow == NULL){
+            row->longRow = rowAlloc(sizeof(longRow));
+            memset(row->longRow, 0, sizeof(longRow));
+        }
+        rstart = rowMxToRx(row, mstart);
+        rbstart = rowMxToRb(row, mstart);
+        row->longRow->mstart = mstart;
+        row->longRow->mend = mend;
+        row->longRow->rstart = rstart;
+        row->longRow->rbstart = rbstart;
+    }
+
+    //Nothing to expand, so render is just the same bytes as chars
+    if (!tabs){
+        row->render = &row->chars[mstart];
+        row->rsize = mend - mstart;
+        row->renderShared = 1;
+        return;
     }
 
-    free(row->render);
-    row->render = malloc(row->size + tabs*(COMETTEX_TAB_STOP) + 1);
+    row->render = rowAlloc(rowMxToRb(row, mend) - rbstart + 1);
+    row->renderShared = 0;
 
     int idx = 0;
-    for (int i = 0;i<row->size;i++){
+    int rx = rstart;
+    int i = mstart;
+    while (i < mend){
+        int n;
+        int w = rowCharWidth(row, i, rx, &n);
         if (row->chars[i] == '\t'){
-            row->render[idx++] = ' ';
-            while (idx % COMETTEX_TAB_STOP != 0) row->render[idx++] = ' ';
+            //Tab stops depend on the real column, not the one inside the window
+            memset(&row->render[idx], ' ', w);
+            idx += w;
         }else{
-            row->render[idx++] = row->chars[i];
+            memcpy(&row->render[idx], &row->chars[i], n);
+            idx += n;
         }
+        rx += w;
+        i += n;
     }
     row->render[idx] = '\0';
     row->rsize = idx;
+}
+
+static void editorRenderWindowAt(editorConfig *ce, erow *row, int rx){
+    int lo = rx - ce->screenCol - COMETTEX_LONG_LINE_MARGIN;
+    if (lo < 0) lo = 0;
+    int hi = rx + ce->screenCol + COMETTEX_LONG_LINE_MARGIN;
 
+    //rowRxtoMx always lands on the start of a char
+    editorRenderWindow(row, rowRxtoMx(row, lo), rowRxtoMx(row, hi + 1));
+}
+
+//Makes sure render covers [rx, rx + screenCol) of a long row
+void editorRowEnsureWindow(editorConfig *ce, erow *row, int rx){
+    if (row->size < COMETTEX_LONG_LINE) return;
+
+    longRow *lr = row->longRow;
+    int startOk = lr->mstart == 0 || rx >= lr->rstart;
+    int endOk = lr->mend == row->size || rx + ce->screenCol <= lr->rstart + row->rsize;
+    if (startOk && endOk) return;
+
+    editorRenderWindowAt(ce, row, rx);
+    editorUpdateSyntaxWindow(ce, row);
+}
+
+//Brings the row's bytes in ce->stats up to date with what it holds now
+void editorRowAccount(editorConfig *ce, erow *row){
+    int text = (row->coldBlock == -1 && row->chars) ? row->size + 1 : 0;
+    int render = (row->render && !row->renderShared) ? row->rsize + 1 : 0;
+    render += sizeof(rxCheckpoint) * row->numRxCheckpoints;
+    int hl = sizeof(hlSpan) * row->numHl;
+    if (row->longRow){
+        render += sizeof(longRow);
+        hl += sizeof(hlCheckpoint) * row->longRow->numHlCheckpoints;
+    }
+
+    ce->stats.textBytes += text - row->statText;
+    ce->stats.renderBytes += render - row->statRender;
+    ce->stats.hlBytes += hl - row->statHl;
+    row->statText = text;
+    row->statRender = render;
+    row->statHl = hl;
+}
+
+//Moves the row to the histogram buckets len and tab
+static void editorRowCountBuckets(editorConfig *ce, erow *row, int len, int tab){
+    if (row->statLen){
+        ce->stats.lenHist[row->statLen - 1]--;
+        ce->stats.tabHist[row->statTabs - 1]--;
+    }
+    ce->stats.lenHist[len]++;
+    ce->stats.tabHist[tab]++;
+    row->statLen = len + 1;
+    row->statTabs = tab + 1;
+}
+
+static int editorRowLenBucket(erow *row){
+    int len = 0;
+    for (unsigned int size = row->size; size;size >>= 1) len++;
+    return (len < COMETTEX_STATS_LEN_BUCKETS) ? len : COMETTEX_STATS_LEN_BUCKETS - 1;
+}
+
+//The tab density bucket of a row with tabs tabs
+static int editorRowTabBucket(erow *row, int tabs){
+    if (!tabs) return 0;
+    return 1 + (int)(((long long)tabs * 10 - 1) / row->size);
+}
+
+//Takes the row out of ce->stats, it's going away
+static void editorRowUncount(editorConfig *ce, erow *row){
+    ce->stats.textBytes -= row->statText;
+    ce->stats.renderBytes -= row->statRender;
+    ce->stats.hlBytes -= row->statHl;
+    row->statText = row->statRender = row->statHl = 0;
+    if (row->statLen){
+        ce->stats.lenHist[row->statLen - 1]--;
+        ce->stats.tabHist[row->statTabs - 1]--;
+        row->statLen = row->statTabs = 0;
+    }
+}
+
+//Renders the row from its checkpoints and tells everything that keeps something about it
+static void editorRowRendered(editorConfig *ce, erow *row, int tab){
+    if (row->size >= COMETTEX_LONG_LINE){
+        //Only the part around the screen gets rendered, see editorRowEnsureWindow
+        editorRenderWindowAt(ce, row, ce->colOffset);
+    }else{
+        editorRenderWindow(row, 0, row->size);
+    }
+    editorRowCountBuckets(ce, row, editorRowLenBucket(row), tab);
+    editorRowAccount(ce, row);
+    editorWrapRowChanged(ce, row);
+    editorSymbolsRowChanged(ce, row);
+    editorDiffRowChanged(ce, row);
+    editorDamageRows(ce, row->idx, row->idx + 1);
+}
+
+//Rebuilds everything that comes from chars except the highlight
+static void editorUpdateRender(editorConfig *ce, erow *row){
+    long long t = editorPerfBegin();
+    int tabs = 0;
+    char *tab = memchr(row->chars, '\t', row->size);
+    while (tab){
+        tabs++;
+        tab = memchr(tab + 1, '\t', &row->chars[row->size] - tab - 1);
+    }
+    row->isAscii = utf8IsAscii(row->chars, row->size);
+    editorUpdateRxCheckpoints(row, tabs);
+    editorRowRendered(ce, row, editorRowTabBucket(row, tabs));
+    editorPerfEnd(PERF_UPDATE_ROW, t);
+}
+
+void editorUpdateRow(editorConfig *ce, erow *row){
+    editorUpdateRender(ce, row);
     editorUpdateSyntax(ce, row);
 }
 
-void editorInsertRow(editorConfig *ce, int at, char *s, size_t len){
-    if (at < 0 || at > ce->numRows) return;
+/*
+ editorUpdateRow for a row where del chars at at were just replaced by ins chars. A row
+ that was long already doesn't read all of itself again, only what the change reaches
+*/
+static void editorUpdateRowEdit(editorConfig *ce, erow *row, int at, int del, int ins){
+    if (row->size < COMETTEX_LONG_LINE || row->size - ins + del < COMETTEX_LONG_LINE){
+        editorUpdateRow(ce, row);
+        return;
+    }
+    long long t = editorPerfBegin();
+    //Deleting can leave it ASCII without it being known, that only costs a slower walk
+    row->isAscii = row->isAscii && utf8IsAscii(&row->chars[at], ins);
+    if (row->rxCheckpoints){
+        editorShiftRxCheckpoints(row, at, del, ins);
+    }else if (!row->isAscii || memchr(&row->chars[at], '\t', ins)){
+        editorUpdateRxCheckpoints(row, 1);
+    }
+    //Counting the tabs would read the whole row, it stays in the tab bucket it was in
+    editorRowRendered(ce, row, row->statTabs ? row->statTabs - 1 : 0);
+    editorPerfEnd(PERF_UPDATE_ROW, t);
+    editorUpdateSyntaxEdit(ce, row, at, del, ins);
+}
+
+//Sets up a new row of len chars with no buffers
+static void editorInitRowFields(erow *row, int at, size_t len){
+    row->idx = at;
+
+    row->size = len;
+    row->chars = NULL;
+
+    row->rsize = 0;
+    row->render = NULL;
+    row->hl = NULL;
+    row->numHl = 0;
+    row->hlOpenComment = 0;
+    row->rxCheckpoints = NULL;
+    row->numRxCheckpoints = 0;
+    row->renderShared = 0;
+    row->coldBlock = -1;
+    row->coldOff = 0;
+    row->isAscii = 1;
+    row->longRow = NULL;
+    row->statText = 0;
+    row->statRender = 0;
+    row->statHl = 0;
+    row->statLen = 0;
+    row->statTabs = 0;
+    row->wrapLines = 0;
+    row->symKind = SYMBOL_UNSCANNED;
+    row->brackets.sum = row->brackets.min = row->brackets.max = 0;
+}
+
+//Makes a new row with room for len chars, the caller fills them in
+static void editorInitRow(erow *row, int at, size_t len){
+    editorInitRowFields(row, at, len);
+    row->chars = rowAlloc(len + 1);
+    row->chars[len] = '\0';
+}
 
-    ce->row = realloc(ce->row, sizeof(erow) * (ce->numRows + 1));
-    memmove(&ce->row[at + 1], &ce->row[at], sizeof(erow) * (ce->numRows - at));
-    //Increment the below rows by one
-    for (int j = at + 1; j <= ce->numRows;j++){
-        ce->row[j].idx++;
+//Makes room for n rows in all, for when it's known up front how many there will be
+void editorReserveRows(editorConfig *ce, int n){
+    if (n <= ce->rowCap) return;
+    ce->rowCap = n;
+    ce->row = realloc(ce->row, sizeof(erow) * ce->rowCap);
+}
+
+//Leaves n uninitialised rows at at, moving the rows below only once
+static void editorOpenRows(editorConfig *ce, int at, int n){
+    if (ce->numRows + n > ce->rowCap){
+        int cap = ce->rowCap ? ce->rowCap : 64;
+        while (ce->numRows + n > cap) cap *= 2;
+        editorReserveRows(ce, cap);
     }
+    memmove(&ce->row[at + n], &ce->row[at], sizeof(erow) * (ce->numRows - at));
+    //Increment the below rows by n
+    for (int j = at + n; j < ce->numRows + n;j++){
+        ce->row[j].idx += n;
+    }
+    editorSyntaxRowsMoved(ce, at, n);
+    editorRowTreeMoved(ce, at, n);
+    editorSymbolsRowsMoved(ce);
+    editorBracketsRowsMoved(ce);
+    editorDiffRowsMoved(ce, at, n);
+    editorWindowsRowsMoved(ce, at, n);
+}
 
-    ce->row[at].idx = at;
+void editorInsertRow(editorConfig *ce, int at, char *s, size_t len){
+    if (at < 0 || at > ce->numRows) return;
 
-    ce->row[at].size = len;
-    ce->row[at].chars = malloc(len + 1);
+    editorOpenRows(ce, at, 1);
+    editorInitRow(&ce->row[at], at, len);
     memcpy(ce->row[at].chars, s, len);
-    ce->row[at].chars[len] = '\0';
-
-    ce->row[at].rsize = 0;
-    ce->row[at].render = NULL;
-    ce->row[at].hl = NULL;
-    ce->row[at].hlOpenComment = 0;
+    ce->numRows++;
+    //The row below started in the state the row above ends in, it's looked at again
+    //when the new row ends in any other
+    ce->row[at].hlOpenComment = (at > 0 && ce->row[at - 1].hlOpenComment);
     editorUpdateRow(ce, &ce->row[at]);
+    ce->dirty++;
+}
+
+/*
+ Adds a row of len chars that starts out cold, its text at off in cold block block and
+ tab the tab bucket it goes in. Nothing is rendered or highlighted until it's thawed,
+ the caller sets its hlOpenComment and brackets
+*/
+erow *editorInsertColdRow(editorConfig *ce, int at, size_t len, int block, int off, int tab){
+    if (at < 0 || at > ce->numRows) return NULL;
+
+    editorOpenRows(ce, at, 1);
+    erow *row = &ce->row[at];
+    editorInitRowFields(row, at, len);
+    row->coldBlock = block;
+    row->coldOff = off;
+    editorRowCountBuckets(ce, row, editorRowLenBucket(row), tab);
 
     ce->numRows++;
     ce->dirty++;
+    return row;
 }
 
-void editorFreeRow(erow *row){
-    free(row->render);
-    free(row->chars);
-    free(row->hl);
+//Frees the buffers a hot row owns, its fields but longRow are left as they are
+void editorRowFreeBuffers(erow *row){
+    if (!row->renderShared) rowFree(row->render, row->rsize + 1);
+    rowFree(row->chars, row->size + 1);
+    rowFree(row->hl, sizeof(hlSpan) * row->numHl);
+    rowFree(row->rxCheckpoints, sizeof(rxCheckpoint) * row->numRxCheckpoints);
+    editorRowFreeLong(row);
 }
 
-void editorDelRow(editorConfig *ce, int at){
-    if (at < 0 || at >= ce->numRows) return;
-    editorFreeRow(&ce->row[at]);
-    memmove(&ce->row[at], &ce->row[at + 1], sizeof(erow) * (ce->numRows - at - 1));
-    //Decrement the below rows by one
-    for (int j = at; j < ce->numRows - 1;j++) ce->row[j].idx--;
-    ce->numRows--;
+void editorFreeRow(editorConfig *ce, erow *row){
+    editorRowFreeCold(row);
+    editorRowFreeBuffers(row);
+    editorRowUncount(ce, row);
+}
+
+//Throws away every row at once, the buffers all go back with the arenas
+void editorFreeRows(editorConfig *ce){
+    rowAllocReset();
+    editorColdReset();
+    editorUndoReset();
+    free(ce->row);
+    ce->row = NULL;
+    ce->numRows = 0;
+    ce->rowCap = 0;
+    memset(&ce->stats, 0, sizeof(ce->stats));
+    editorRowTreeFree(ce);
+    editorSymbolsRowsMoved(ce);
+    editorBracketsRowsMoved(ce);
+    ce->numDiffHunks = 0;
+    ce->numDiffRows = 0;
+    ce->diffDirty = 0;
+    editorDamageRows(ce, 0, INT_MAX);
+}
+
+//Closes the gap of n already freed rows at at, moving the rows below only once
+static void editorCloseRows(editorConfig *ce, int at, int n){
+    memmove(&ce->row[at], &ce->row[at + n], sizeof(erow) * (ce->numRows - at - n));
+    ce->numRows -= n;
+    //Decrement the below rows by n
+    for (int j = at; j < ce->numRows;j++) ce->row[j].idx -= n;
+    editorSyntaxRowsMoved(ce, at, -n);
+    editorRowTreeMoved(ce, at, -n);
+    editorSymbolsRowsMoved(ce);
+    editorBracketsRowsMoved(ce);
+    editorDiffRowsMoved(ce, at, -n);
+    editorWindowsRowsMoved(ce, at, -n);
+}
+
+//Deletes rows [at, at + n) with a single move of the rows below
+void editorDelRows(editorConfig *ce, int at, int n){
+    if (at < 0 || at >= ce->numRows || n <= 0) return;
+    if (n > ce->numRows - at) n = ce->numRows - at;
+
+    for (int j = at; j < at + n;j++) editorFreeRow(ce, &ce->row[j]);
+    editorCloseRows(ce, at, n);
     ce->dirty++;
+
+    //The row now at at may start in a different comment state
+    if (at < ce->numRows) editorUpdateSyntax(ce, &ce->row[at]);
+}
+
+void editorDelRow(editorConfig *ce, int at){
+    editorDelRows(ce, at, 1);
 }
 
 void editorRowInsertChar(editorConfig *ce, erow *row, int at, int c){
     if (at < 0 || at > row->size) at = row->size;
-    row->chars = realloc(row->chars, row->size + 2);
+    row->chars = rowRealloc(row->chars, row->size + 1, row->size + 2);
     memmove(&row->chars[at + 1], &row->chars[at], row->size - at + 1);
     row->size++;
     row->chars[at] = c;
-    editorUpdateRow(ce, row);
+    editorUpdateRowEdit(ce, row, at, 0, 1);
     ce->dirty++;
 }
 
 void editorRowAppendString(editorConfig *ce, erow *row, char *s, size_t len){
-    row->chars = realloc(row->chars, row->size + len + 1);
+    row->chars = rowRealloc(row->chars, row->size + 1, row->size + len + 1);
     memcpy(&row->chars[row->size], s, len);
     row->size += len;
     row->chars[row->size] = '\0';
-    editorUpdateRow(ce, row);
+    editorUpdateRowEdit(ce, row, row->size - len, 0, len);
     ce->dirty++;
 }
 
-void editorRowDelChar(editorConfig *ce, erow *row, int at){
+void editorRowDelChars(editorConfig *ce, erow *row, int at, int len){
     if (at < 0 || at >= row->size) return;
-    memmove(&row->chars[at], &row->chars[at + 1], row->size - at);
-    row->size--;
-    editorUpdateRow(ce, row);
+    if (len > row->size - at) len = row->size - at;
+    memmove(&row->chars[at], &row->chars[at + len], row->size - at - len + 1);
+    row->chars = rowRealloc(row->chars, row->size + 1, row->size - len + 1);
+    row->size -= len;
+    editorUpdateRowEdit(ce, row, at, len, 0);
     ce->dirty++;
 }
 
+void editorRowDelChar(editorConfig *ce, erow *row, int at){
+    editorRowDelChars(ce, row, at, 1);
+}
+
+//Rows yanked by editorYankLines and editorDelLines, each ending in '\n'
+static char *yankBuf = NULL;
+static size_t yankLen = 0;
+
+//Copies the text between two positions, rows joined by '\n'. Cold rows are read in place
+static char *editorRangeText(editorConfig *ce, int y0, int x0, int y1, int x1, size_t *len){
+    if (y0 == y1){
+        char *s = malloc(x1 - x0);
+        memcpy(s, &editorRowText(&ce->row[y0])[x0], x1 - x0);
+        *len = x1 - x0;
+        return s;
+    }
+
+    size_t total = ce->row[y0].size - x0 + 1 + x1;
+    for (int j = y0 + 1; j < y1;j++) total += ce->row[j].size + 1;
+
+    char *s = malloc(total);
+    char *p = s;
+    memcpy(p, &editorRowText(&ce->row[y0])[x0], ce->row[y0].size - x0);
+    p += ce->row[y0].size - x0;
+    *p++ = '\n';
+    for (int j = y0 + 1; j < y1;j++){
+        memcpy(p, editorRowText(&ce->row[j]), ce->row[j].size);
+        p += ce->row[j].size;
+        *p++ = '\n';
+    }
+    memcpy(p, editorRowText(&ce->row[y1]), x1);
+    *len = total;
+    return s;
+}
+
+/*
+ Inserts text at (y, x), every '\n' in it starts a new row. All the new rows are made
+ with one move of the rows below and highlighted in one pass, so pasting or undoing
+ 100k lines costs the size of the text and not 100k single row inserts.
+*/
+void editorInsertText(editorConfig *ce, int y, int x, const char *s, size_t len){
+    if (y < 0 || y > ce->numRows || len == 0) return;
+
+    if (y == ce->numRows){
+        //Past the last row, same as a newline at the end of it
+        if (y > 0) editorUndoRecordInsert(ce, y - 1, ce->row[y - 1].size, "\n", 1);
+        editorInsertRow(ce, y, "", 0);
+    }
+
+    erow *row = &ce->row[y];
+    editorRowThaw(ce, row);
+    if (x < 0 || x > row->size) x = row->size;
+    editorUndoRecordInsert(ce, y, x, s, len);
+
+    const char *nl = memchr(s, '\n', len);
+    if (nl == NULL){
+        row->chars = rowRealloc(row->chars, row->size + 1, row->size + len + 1);
+        memmove(&row->chars[x + len], &row->chars[x], row->size - x + 1);
+        memcpy(&row->chars[x], s, len);
+        row->size += len;
+        editorUpdateRowEdit(ce, row, x, 0, len);
+        ce->dirty++;
+        return;
+    }
+
+    const char *end = s + len;
+    int n = 0;
+    for (const char *p = nl; p != NULL; p = memchr(p + 1, '\n', end - p - 1)) n++;
+
+    editorOpenRows(ce, y + 1, n);
+    row = &ce->row[y];
+
+    //One row per line after a newline, the last one also takes the rest of row y
+    const char *p = nl + 1;
+    for (int i = 1; i <= n;i++){
+        const char *e = (i < n) ? memchr(p, '\n', end - p) : end;
+        size_t l = e - p;
+        size_t tail = (i < n) ? 0 : row->size - x;
+        erow *r = &ce->row[y + i];
+        editorInitRow(r, y + i, l + tail);
+        memcpy(r->chars, p, l);
+        memcpy(&r->chars[l], &row->chars[x], tail);
+        p = e + 1;
+    }
+    ce->numRows += n;
+
+    size_t first = nl - s;
+    row->chars = rowRealloc(row->chars, row->size + 1, x + first + 1);
+    memcpy(&row->chars[x], s, first);
+    row->size = x + first;
+    row->chars[row->size] = '\0';
+
+    for (int j = y; j <= y + n;j++) editorUpdateRender(ce, &ce->row[j]);
+    editorUpdateSyntaxRange(ce, y, y + n + 1);
+    ce->dirty++;
+}
+
+/*
+ Splits row y at each of the n chars in xs, which go up. Row y keeps what's before xs[0]
+ and every split after it starts a new row, made with one move of the rows below and
+ highlighted in one pass, as a newline typed at each of them
+*/
+void editorSplitRow(editorConfig *ce, int y, const int *xs, int n){
+    if (y < 0 || y >= ce->numRows || n <= 0) return;
+
+    erow *row = &ce->row[y];
+    editorRowThaw(ce, row);
+    editorOpenRows(ce, y + 1, n);
+    row = &ce->row[y];
+
+    //Row y + i + 1 gets [x, end), each newline is recorded where the one before left the cursor
+    int first = xs[0] > row->size ? row->size : xs[0];
+    int x = first, from = 0;
+    for (int i = 0;i<n;i++){
+        int end = (i < n - 1 && xs[i + 1] < row->size) ? xs[i + 1] : row->size;
+        if (end < x) end = x;
+        editorUndoRecordInsert(ce, y + i, x - from, "\n", 1);
+        erow *r = &ce->row[y + i + 1];
+        editorInitRow(r, y + i + 1, end - x);
+        memcpy(r->chars, &row->chars[x], end - x);
+        from = x;
+        x = end;
+    }
+    ce->numRows += n;
+
+    row->chars = rowRealloc(row->chars, row->size + 1, first + 1);
+    row->size = first;
+    row->chars[first] = '\0';
+
+    for (int j = y; j <= y + n;j++) editorUpdateRender(ce, &ce->row[j]);
+    editorUpdateSyntaxRange(ce, y, y + n + 1);
+    ce->dirty++;
+}
+
+//Deletes from (y0, x0) up to (y1, x1), the rows in between go in one move
+void editorDeleteRange(editorConfig *ce, int y0, int x0, int y1, int x1){
+    if (ce->numRows == 0 || y0 < 0 || y0 >= ce->numRows) return;
+    if (y1 >= ce->numRows){
+        y1 = ce->numRows - 1;
+        x1 = ce->row[y1].size;
+    }
+    if (x0 < 0) x0 = 0;
+    if (x0 > ce->row[y0].size) x0 = ce->row[y0].size;
+    if (x1 > ce->row[y1].size) x1 = ce->row[y1].size;
+    if (y1 < y0 || (y1 == y0 && x1 <= x0)) return;
+
+    if (editorUndoRecording()){
+        size_t len;
+        char *s = editorRangeText(ce, y0, x0, y1, x1, &len);
+        editorUndoRecordDelete(ce, y0, x0, s, len);
+        free(s);
+    }
+
+    erow *first = &ce->row[y0];
+    editorRowThaw(ce, first);
+    if (y0 == y1){
+        editorRowDelChars(ce, first, x0, x1 - x0);
+        return;
+    }
+
+    //The start of the first row joined with the end of the last one
+    erow *last = &ce->row[y1];
+    editorRowThaw(ce, last);
+    size_t tail = last->size - x1;
+    first->chars = rowRealloc(first->chars, first->size + 1, x0 + tail + 1);
+    memcpy(&first->chars[x0], &last->chars[x1], tail);
+    first->size = x0 + tail;
+    first->chars[first->size] = '\0';
+
+    editorDelRows(ce, y0 + 1, y1 - y0);
+    editorUpdateRender(ce, &ce->row[y0]);
+    editorUpdateSyntaxRange(ce, y0, y0 + 1);
+}
+
+//Records rows [at, at + n) being replaced by lines for undo, straight from the rows into the log
+static void editorUndoRecordSplice(editorConfig *ce, int at, int n, char **lines, int *lens, int m){
+    //The rows' own '\n's go with them, with nothing in their place it's one '\n' more
+    int y = at, x = 0, before = 0, after = 0;
+    if (m == 0 && at + n < ce->numRows){
+        after = 1;
+    }else if (m == 0 && at > 0){
+        y = at - 1;
+        x = ce->row[y].size;
+        before = 1;
+    }
+
+    editorUndoBeginGroup();
+    editorUndoRecordStart(ce, 0, y, x);
+    if (before) editorUndoRecordMore("\n", 1);
+    for (int j = at; j < at + n;j++){
+        editorUndoRecordMore(editorRowText(&ce->row[j]), ce->row[j].size);
+        if (j < at + n - 1 || after) editorUndoRecordMore("\n", 1);
+    }
+    if (m > 0){
+        editorUndoRecordStart(ce, 1, at, 0);
+        for (int i = 0;i<m;i++){
+            editorUndoRecordMore(lines[i], lens[i]);
+            if (i < m - 1) editorUndoRecordMore("\n", 1);
+        }
+    }
+    editorUndoEndGroup();
+}
+
+/*
+ Puts m new rows in place of rows [at, at + n). lines[i] is a rowAlloc'd buffer of lens[i] + 1
+ chars ending in '\0' that the new row takes over. However many rows there are on either
+ side the rows below move once, and for undo it's one change
+*/
+void editorSpliceRows(editorConfig *ce, int at, int n, char **lines, int *lens, int m){
+    if (at < 0 || at >= ce->numRows || n <= 0) return;
+    if (n > ce->numRows - at) n = ce->numRows - at;
+
+    //Nothing left at all is an empty row, as editorDeleteRange leaves it, so redo does the same
+    char *empty;
+    int emptyLen = 0;
+    if (m == 0 && n == ce->numRows){
+        empty = rowAlloc(1);
+        empty[0] = '\0';
+        lines = &empty;
+        lens = &emptyLen;
+        m = 1;
+    }
+    if (editorUndoRecording()) editorUndoRecordSplice(ce, at, n, lines, lens, m);
+
+    for (int j = at; j < at + n;j++) editorFreeRow(ce, &ce->row[j]);
+    if (m > n){
+        editorOpenRows(ce, at + n, m - n);
+        ce->numRows += m - n;
+    }else if (m < n){
+        editorCloseRows(ce, at + m, n - m);
+    }
+    for (int i = 0;i<m;i++){
+        erow *row = &ce->row[at + i];
+        editorInitRowFields(row, at + i, lens[i]);
+        row->chars = lines[i];
+        editorUpdateRender(ce, row);
+    }
+
+    if (m > 0){
+        editorUpdateSyntaxRange(ce, at, at + m);
+    }else if (at < ce->numRows){
+        editorUpdateSyntax(ce, &ce->row[at]);
+    }
+    ce->dirty++;
+}
+
+//Copies rows [at, at + n) into the yank buffer, every row followed by '\n'
+void editorYankLines(editorConfig *ce, int at, int n){
+    if (at < 0 || at >= ce->numRows || n <= 0) return;
+    if (n > ce->numRows - at) n = ce->numRows - at;
+
+    size_t len = 0;
+    for (int j = at; j < at + n;j++) len += ce->row[j].size + 1;
+    free(yankBuf);
+    yankBuf = malloc(len);
+    yankLen = len;
+
+    char *p = yankBuf;
+    for (int j = at; j < at + n;j++){
+        memcpy(p, editorRowText(&ce->row[j]), ce->row[j].size);
+        p += ce->row[j].size;
+        *p++ = '\n';
+    }
+}
+
+size_t editorYankBytes(){
+    return yankLen;
+}
+
+int editorYankedLines(){
+    int n = 0;
+    for (char *p = yankBuf; p && (p = memchr(p, '\n', yankBuf + yankLen - p)) != NULL; p++) n++;
+    return n;
+}
+
+//Puts the yank buffer times over in front of row at, as one insert
+void editorPutLines(editorConfig *ce, int at, int times){
+    if (yankLen == 0 || times <= 0) return;
+    if (at < 0) at = 0;
+    if (at > ce->numRows) at = ce->numRows;
+
+    //After the last row the newline goes in front instead of at the end
+    int atEnd = (at == ce->numRows);
+    size_t len = yankLen * times;
+    char *s = malloc(len + 1);
+    char *p = s;
+    if (atEnd && ce->numRows > 0) *p++ = '\n';
+    for (int i = 0;i<times;i++){
+        memcpy(p, yankBuf, yankLen);
+        p += yankLen;
+    }
+    if (atEnd) p--;
+
+    if (atEnd && ce->numRows > 0){
+        editorInsertText(ce, ce->numRows - 1, ce->row[ce->numRows - 1].size, s, p - s);
+    }else{
+        editorInsertText(ce, at, 0, s, p - s);
+    }
+    free(s);
+}
+
+//Puts a tab in front of every non empty row in [at, at + n)
+void editorIndentLines(editorConfig *ce, int at, int n){
+    if (at < 0 || at >= ce->numRows || n <= 0) return;
+    if (n > ce->numRows - at) n = ce->numRows - at;
+
+    editorUndoBeginGroup();
+    for (int j = at; j < at + n;j++){
+        erow *row = &ce->row[j];
+        if (row->size == 0) continue;
+        editorRowThaw(ce, row);
+        editorUndoRecordInsert(ce, j, 0, "\t", 1);
+        row->chars = rowRealloc(row->chars, row->size + 1, row->size + 2);
+        memmove(&row->chars[1], row->chars, row->size + 1);
+        row->chars[0] = '\t';
+        row->size++;
+        editorUpdateRender(ce, row);
+    }
+    editorUndoEndGroup();
+
+    editorUpdateSyntaxRange(ce, at, at + n);
+    ce->dirty++;
+}
+
+//Takes one level of indent, a tab or up to COMETTEX_TAB_STOP spaces, off rows [at, at + n)
+void editorOutdentLines(editorConfig *ce, int at, int n){
+    if (at < 0 || at >= ce->numRows || n <= 0) return;
+    if (n > ce->numRows - at) n = ce->numRows - at;
+
+    editorUndoBeginGroup();
+    for (int j = at; j < at + n;j++){
+        erow *row = &ce->row[j];
+        char *text = editorRowText(row);
+        int k = 0;
+        if (row->size > 0 && text[0] == '\t'){
+            k = 1;
+        }else{
+            while (k < row->size && k < COMETTEX_TAB_STOP && text[k] == ' ') k++;
+        }
+        if (k == 0) continue;
+
+        editorRowThaw(ce, row);
+        editorUndoRecordDelete(ce, j, 0, row->chars, k);
+        memmove(row->chars, &row->chars[k], row->size - k + 1);
+        row->chars = rowRealloc(row->chars, row->size + 1, row->size - k + 1);
+        row->size -= k;
+        editorUpdateRender(ce, row);
+    }
+    editorUndoEndGroup();
+
+    editorUpdateSyntaxRange(ce, at, at + n);
+    ce->dirty++;
+}
+
+//Joins rows [at, at + n) into one, the leading blanks of each joined row become one space
+void editorJoinLines(editorConfig *ce, int at, int n){
+    if (n < 2) n = 2;
+    if (at < 0 || at >= ce->numRows - 1) return;
+    if (n > ce->numRows - at) n = ce->numRows - at;
+    int last = at + n - 1;
+
+    size_t cap = 0;
+    for (int j = at; j <= last;j++) cap += ce->row[j].size + 1;
+    char *s = malloc(cap);
+    size_t len = ce->row[at].size;
+    memcpy(s, editorRowText(&ce->row[at]), len);
+    for (int j = at + 1; j <= last;j++){
+        char *text = editorRowText(&ce->row[j]);
+        int k = 0;
+        while (k < ce->row[j].size && (text[k] == ' ' || text[k] == '\t')) k++;
+        if (k == ce->row[j].size) continue;
+        if (len > 0 && s[len - 1] != ' ' && s[len - 1] != '\t') s[len++] = ' ';
+        memcpy(&s[len], &text[k], ce->row[j].size - k);
+        len += ce->row[j].size - k;
+    }
+
+    //For undo it's the old rows deleted and the joined row inserted
+    if (editorUndoRecording()){
+        size_t oldLen;
+        char *old = editorRangeText(ce, at, 0, last, ce->row[last].size, &oldLen);
+        editorUndoBeginGroup();
+        editorUndoRecordDelete(ce, at, 0, old, oldLen);
+        editorUndoRecordInsert(ce, at, 0, s, len);
+        editorUndoEndGroup();
+        free(old);
+    }
+
+    erow *row = &ce->row[at];
+    editorRowThaw(ce, row);
+    row->chars = rowRealloc(row->chars, row->size + 1, len + 1);
+    memcpy(row->chars, s, len);
+    row->size = len;
+    row->chars[len] = '\0';
+    free(s);
+
+    editorDelRows(ce, at + 1, n - 1);
+    editorUpdateRender(ce, &ce->row[at]);
+    editorUpdateSyntaxRange(ce, at, at + 1);
+}
+
+//Deletes n whole rows starting at at, as one range delete and so one change for undo
+//The rows are yanked first, like vi
+void editorDelLines(editorConfig *ce, int at, int n){
+    if (at < 0 || at >= ce->numRows || n <= 0) return;
+    if (n > ce->numRows - at) n = ce->numRows - at;
+    editorYankLines(ce, at, n);
+
+    int last = at + n - 1;
+    if (last + 1 < ce->numRows){
+        editorDeleteRange(ce, at, 0, last + 1, 0);
+    }else if (at > 0){
+        //Nothing below, the newline ending the row above goes instead
+        editorDeleteRange(ce, at - 1, ce->row[at - 1].size, last, ce->row[last].size);
+    }else{
+        editorDeleteRange(ce, 0, 0, last, ce->row[last].size);
+    }
+}
+
 void editorDelChar(editorConfig *ce){
     if (ce->my == ce->numRows) return;
     if (ce->mx == 0 && ce->my == 0) return;
 
-    erow *row = &ce->row[ce->my];
     if (ce->mx > 0){
-        editorRowDelChar(ce, row, ce->mx - 1);
-        ce->mx--;
+        //Delete the whole char before the cursor, not just its last byte
+        erow *row = &ce->row[ce->my];
+        editorRowThaw(ce, row);
+        int prev = utf8PrevChar(row->chars, ce->mx);
+        editorDeleteRange(ce, ce->my, prev, ce->my, ce->mx);
+        ce->mx = prev;
     }else{
-        ce->mx = ce->row[ce->my - 1].size;
-        editorRowAppendString(ce, &ce->row[ce->my - 1], row->chars, row->size);
-        editorDelRow(ce, ce->my);
+        int prevSize = ce->row[ce->my - 1].size;
+        editorDeleteRange(ce, ce->my - 1, prevSize, ce->my, 0);
         ce->my--;
+        ce->mx = prevSize;
     }
 }
 
 void editorInsertNewLine(editorConfig *ce){
-    if (ce->mx == 0){
-        editorInsertRow(&E,ce->my, "", 0);
+    if (ce->my == ce->numRows){
+        //Past the last row, same as a newline at the end of it
+        if (ce->numRows > 0) editorUndoRecordInsert(ce, ce->numRows - 1, ce->row[ce->numRows - 1].size, "\n", 1);
+        editorInsertRow(ce, ce->numRows, "", 0);
     }else{
-        erow *row = &ce->row[ce->my];
-        editorInsertRow(ce,ce->my + 1, &row->chars[ce->mx], row->size - ce->mx);
-        row = &ce->row[ce->my];
-        row->size = ce->mx;
-        row->chars[row->size] = '\0';
-        editorUpdateRow(ce, row);
+        editorInsertText(ce, ce->my, ce->mx, "\n", 1);
     }
     ce->my++;
     ce->mx = 0;
 }
 
 void editorInsertChar(editorConfig *ce, int c){
-    if (ce->my == ce->numRows){
-        editorInsertRow(&E,ce->numRows, "", 0);
-    }
-    editorRowInsertChar(ce, &ce->row[ce->my], ce->mx, c);
+    char ch = c;
+    editorInsertText(ce, ce->my, ce->mx, &ch, 1);
     ce->mx++;
 }
-
@@ -5,18 +5,34 @@
 
 int rowMxToRx(erow *row, int mx);
 
+int rowMxToRb(erow *row, int mx);
+
 int rowRxtoMx(erow *row, int rx);
 
+void editorRowEnsureWindow(editorConfig *ce, erow *row, int rx);
+
 void editorUpdateRow(editorConfig *ce, erow *row);
 
 void editorInsertRow(editorConfig *ce, int at, char *s, size_t len);
 
-void editorFreeRow(erow *row);
+void editorReserveRows(editorConfig *ce, int n);
+
+erow *editorInsertColdRow(editorConfig *ce, int at, size_t len, int block, int off, int tab);
+
+void editorRowAccount(editorConfig *ce, erow *row);
+
+void editorRowFreeBuffers(erow *row);
+
+void editorFreeRow(editorConfig *ce, erow *row);
+
+void editorFreeRows(editorConfig *ce);
 
 void editorRowInsertChar(editorConfig *ce, erow *row, int at, int c);
 
 void editorRowAppendString(editorConfig *ce, erow *row, char *s, size_t len);
 
+void editorRowDelChars(editorConfig *ce, erow *row, int at, int len);
+
 void editorRowDelChar(editorConfig *ce, erow *row, int at);
 
 void editorDelChar(editorConfig *ce);
@@ -27,4 +43,30 @@ void editorInsertChar(editorConfig *ce, int c);
 
 void editorDelRow(editorConfig *ce, int at);
 
+void editorDelRows(editorConfig *ce, int at, int n);
+
+void editorSpliceRows(editorConfig *ce, int at, int n, char **lines, int *lens, int m);
+
+void editorInsertText(editorConfig *ce, int y, int x, const char *s, size_t len);
+
+void editorSplitRow(editorConfig *ce, int y, const int *xs, int n);
+
+void editorDeleteRange(editorConfig *ce, int y0, int x0, int y1, int x1);
+
+void editorDelLines(editorConfig *ce, int at, int n);
+
+void editorYankLines(editorConfig *ce, int at, int n);
+
+int editorYankedLines();
+
+size_t editorYankBytes();
+
+void editorPutLines(editorConfig *ce, int at, int times);
+
+void editorIndentLines(editorConfig *ce, int at, int n);
+
+void editorOutdentLines(editorConfig *ce, int at, int n);
+
+void editorJoinLines(editorConfig *ce, int at, int n);
+
 #endif
\ No newline at end of file
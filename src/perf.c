@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "perf.h"
+
+/*
+ Latency instrumentation. Stages are timed with editorPerfBegin/editorPerfEnd and summed
+ per frame. A frame starts when a key arrives and ends when the screen has been written,
+ so its length is what the user waits between pressing a key and seeing it.
+ The last COMETTEX_PERF_FRAMES frames are kept for the percentiles.
+
+ Timing is off unless something wants it (the HUD or a trace), editorPerfBegin returns 0
+ then and editorPerfEnd ignores it, so the row loops only pay for a branch.
+
+ A trace is a Chrome trace event file, open it in chrome://tracing or Perfetto.
+*/
+
+typedef struct perfFrame{
+    long long latency;
+    size_t bytes;
+} perfFrame;
+
+static const char *stageNames[PERF_STAGES] = {
+    "readKey", "key", "updateRow", "syntax", "draw", "write"
+};
+
+static int wanted = 0;
+static int enabled = 0;
+//When the key being handled came in, 0 when the last one has been painted
+static long long keyAt = 0;
+static long long stageNs[PERF_STAGES];
+static int stageCalls[PERF_STAGES];
+static perfFrame frames[COMETTEX_PERF_FRAMES];
+static int numFrames = 0;
+static int nextFrame = 0;
+static long long lastStageNs[PERF_STAGES];
+static int lastStageCalls[PERF_STAGES];
+static FILE *trace = NULL;
+static long long traceStart = 0;
+static int traceEvents = 0;
+
+static long long perfNow(){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static void perfTraceEvent(const char *name, long long start, long long dur, const char *args){
+    fprintf(trace, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f%s%s}",
+        traceEvents++ ? ",\n" : "", name, (start - traceStart) / 1e3, dur / 1e3, args ? ",\"args\":" : "", args ? args : "");
+}
+
+void editorPerfEnable(int on){
+    wanted = on;
+    enabled = wanted || trace != NULL;
+}
+
+int editorPerfEnabled(){
+    return enabled;
+}
+
+long long editorPerfBegin(){
+    return enabled ? perfNow() : 0;
+}
+
+void editorPerfEnd(int stage, long long start){
+    if (start == 0) return;
+    long long dur = perfNow() - start;
+    stageNs[stage] += dur;
+    stageCalls[stage]++;
+    if (trace && ((stage != PERF_UPDATE_ROW && stage != PERF_SYNTAX) || dur >= COMETTEX_PERF_TRACE_MIN_NS)){
+        perfTraceEvent(stageNames[stage], start, dur, NULL);
+    }
+}
+
+//A key came in from the terminal, the frame showing it starts now
+void editorPerfKey(){
+    if (enabled && keyAt == 0) keyAt = perfNow();
+}
+
+long long editorPerfKeyAt(){
+    return keyAt;
+}
+
+//The screen was written, bytes long. Closes the frame if a key started one
+void editorPerfFrame(size_t bytes){
+    if (!enabled) return;
+    if (keyAt){
+        long long now = perfNow();
+        perfFrame *f = &frames[nextFrame];
+        f->latency = now - keyAt;
+        f->bytes = bytes;
+        nextFrame = (nextFrame + 1) % COMETTEX_PERF_FRAMES;
+        if (numFrames < COMETTEX_PERF_FRAMES) numFrames++;
+
+        if (trace){
+            char args[256];
+            int len = snprintf(args, sizeof(args), "{\"bytes\":%zu", bytes);
+            for (int s = 0;s<PERF_STAGES;s++){
+                len += snprintf(args + len, sizeof(args) - len, ",\"%s\":%d", stageNames[s], stageCalls[s]);
+            }
+            snprintf(args + len, sizeof(args) - len, "}");
+            perfTraceEvent("frame", keyAt, now - keyAt, args);
+        }
+        memcpy(lastStageNs, stageNs, sizeof(stageNs));
+        memcpy(lastStageCalls, stageCalls, sizeof(stageCalls));
+        keyAt = 0;
+    }
+    memset(stageNs, 0, sizeof(stageNs));
+    memset(stageCalls, 0, sizeof(stageCalls));
+}
+
+static int perfCmp(const void *a, const void *b){
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+void editorPerfGetStats(perfStats *st){
+    memset(st, 0, sizeof(*st));
+    st->frames = numFrames;
+    memcpy(st->stageNs, lastStageNs, sizeof(lastStageNs));
+    memcpy(st->stageCalls, lastStageCalls, sizeof(lastStageCalls));
+    if (numFrames == 0) return;
+
+    long long lat[COMETTEX_PERF_FRAMES];
+    size_t bytes = 0;
+    for (int i = 0;i<numFrames;i++){
+        lat[i] = frames[i].latency;
+        bytes += frames[i].bytes;
+    }
+    qsort(lat, numFrames, sizeof(long long), perfCmp);
+    st->p50 = lat[(numFrames - 1) / 2];
+    st->p99 = lat[(numFrames * 99 + 99) / 100 - 1];
+    st->max = lat[numFrames - 1];
+    st->lastBytes = frames[(nextFrame + COMETTEX_PERF_FRAMES - 1) % COMETTEX_PERF_FRAMES].bytes;
+    st->avgBytes = bytes / numFrames;
+}
+
+static void perfTraceAtExit(){
+    editorPerfTraceStop();
+}
+
+//Starts writing every frame and stage to a trace file, -1 with errno set if it can't be opened
+int editorPerfTraceStart(const char *path){
+    static int registered = 0;
+    editorPerfTraceStop();
+    trace = fopen(path, "w");
+    if (trace == NULL) return -1;
+    //The editor quits with exit() from its key handlers, the file still gets closed then
+    if (!registered){
+        atexit(perfTraceAtExit);
+        registered = 1;
+    }
+    fputs("{\"traceEvents\":[\n", trace);
+    traceStart = perfNow();
+    traceEvents = 0;
+    enabled = 1;
+    return 0;
+}
+
+void editorPerfTraceStop(){
+    if (trace == NULL) return;
+    fputs("\n]}\n", trace);
+    fclose(trace);
+    trace = NULL;
+    enabled = wanted;
+}
+
+int editorPerfTracing(){
+    return trace != NULL;
+}
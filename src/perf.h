@@ -0,0 +1,43 @@
+#ifndef PERF_C_
+#define PERF_C_
+#include <stddef.h>
+
+//Frames kept for the latency percentiles
+#define COMETTEX_PERF_FRAMES 256
+//Row updates and highlighting run once per row, only calls at least this long go in a trace
+#define COMETTEX_PERF_TRACE_MIN_NS 50000
+
+enum perfStage{
+    PERF_READ_KEY = 0,  //Waiting for and decoding a key
+    PERF_KEY,           //From the key arriving to its handler returning
+    PERF_UPDATE_ROW,    //Rebuilding render from chars
+    PERF_SYNTAX,        //Highlighting
+    PERF_DRAW,          //Building the frame
+    PERF_WRITE,         //Writing it to the terminal
+    PERF_STAGES
+};
+
+typedef struct perfStats{
+    int frames;         //Frames in the window, at most COMETTEX_PERF_FRAMES
+    long long p50;      //Key to paint latency in ns
+    long long p99;
+    long long max;
+    size_t lastBytes;   //Written by the last frame
+    size_t avgBytes;
+    long long stageNs[PERF_STAGES];  //Time spent in each stage by the last frame
+    int stageCalls[PERF_STAGES];
+} perfStats;
+
+void editorPerfEnable(int on);
+int editorPerfEnabled();
+long long editorPerfBegin();
+void editorPerfEnd(int stage, long long start);
+void editorPerfKey();
+long long editorPerfKeyAt();
+void editorPerfFrame(size_t bytes);
+void editorPerfGetStats(perfStats *st);
+int editorPerfTraceStart(const char *path);
+void editorPerfTraceStop();
+int editorPerfTracing();
+
+#endif
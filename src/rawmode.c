@@ -5,15 +5,23 @@
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include "CometTex.h"
+#include "macro.h"
+#include "perf.h"
 
 void disableRawMode(editorConfig *ce){
     if( tcsetattr(STDIN_FILENO, TCSAFLUSH, &ce->orignal_termios) == -1) die("DisableRawMode() Failed");
 }
 
+//on_exit passes the exit status first
+static void rawModeAtExit(int status, void *ce){
+    (void)status;
+    disableRawMode(ce);
+}
+
 void enableRawMode(editorConfig *ce){
     if (tcgetattr(STDIN_FILENO, &ce->orignal_termios) == -1) die("EnableRawMode() tcgetattr Failece.d");
     //atexit is called when the program exits
-    on_exit(disableRawMode,ce);
+    on_exit(rawModeAtExit,ce);
 
     struct termios raw = ce->orignal_termios;
     //Turn off some flags
@@ -28,11 +36,13 @@ void enableRawMode(editorConfig *ce){
     if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == -1) die("EnableRawMode() tcsetattr Failed");
 }
 
-int editorReadKey(){
+static int editorReadTermKey(){
     int nread;
     char c;
     while((nread = read(STDIN_FILENO, &c, 1)) != 1){
         if (nread == -1 && errno != EAGAIN) die("EditorReadKey() failed");
+        //Nothing typed for a while, background work gets done meanwhile
+        if (nread == 0) editorIdle();
     }
 
     //If the character starts with an escape. It could be the start of on escape sequence
@@ -84,10 +94,24 @@ int editorReadKey(){
 
         return '\x1b';
     }else{
-        return c;
+        //Keep the bytes of multibyte chars positive
+        return (unsigned char)c;
     }
 }
 
+int editorReadKey(){
+    int key;
+    //A macro being replayed comes before the terminal
+    if (editorQueuedKey(&key)) return key;
+
+    long long t = editorPerfBegin();
+    key = editorReadTermKey();
+    editorPerfEnd(PERF_READ_KEY, t);
+    editorPerfKey();
+    if (editorMacroRecording()) editorMacroRecordKey(key);
+    return key;
+}
+
 int getCursorPos(int *rows,int *cols){
     char buf[32];
     unsigned int i = 0;
@@ -0,0 +1,161 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "CometTex.h"
+#include "ops.h"
+#include "syntaxHighlighting.h"
+#include "rowAlloc.h"
+#include "coldRows.h"
+#include "undo.h"
+#include "replace.h"
+
+/*
+ Replace all. Goes over the buffer in passes:
+   1. count the matches in every row
+   2. allocate every changed row's new buffer at its final size
+   3. write the new rows from the old ones
+   4. swap them in, record undo and re-render and re-highlight the changed rows
+ 1 and 3 only read rows and write their own slots, so on big buffers they're split across
+ threads. 2 and 4 stay on this thread, the row allocator and undo log aren't shared.
+*/
+
+typedef struct replaceJob{
+    editorConfig *ce;
+    const char *find;
+    size_t findLen;
+    const char *repl;
+    size_t replLen;
+    int *counts;     //Matches per row
+    int *changed;    //Rows with at least one match
+    char **out;      //New buffer of each changed row
+    int from;
+    int to;
+} replaceJob;
+
+static void *replaceCountRows(void *arg){
+    replaceJob *job = arg;
+    for (int i = job->from; i < job->to;i++){
+        char *text = editorRowText(&job->ce->row[i]);
+        int n = 0;
+        char *p = text;
+        while ((p = strstr(p, job->find)) != NULL){
+            n++;
+            p += job->findLen;
+        }
+        job->counts[i] = n;
+    }
+    return NULL;
+}
+
+static void *replaceFillRows(void *arg){
+    replaceJob *job = arg;
+    for (int k = job->from; k < job->to;k++){
+        erow *row = &job->ce->row[job->changed[k]];
+        char *dst = job->out[k];
+        char *src = row->chars;
+        char *p;
+        while ((p = strstr(src, job->find)) != NULL){
+            memcpy(dst, src, p - src);
+            dst += p - src;
+            memcpy(dst, job->repl, job->replLen);
+            dst += job->replLen;
+            src = p + job->findLen;
+        }
+        size_t rest = row->chars + row->size - src;
+        memcpy(dst, src, rest);
+        dst[rest] = '\0';
+    }
+    return NULL;
+}
+
+//Runs fn over [0, n) in up to threads slices
+static void replaceRun(replaceJob *base, void *(*fn)(void *), int n, int threads){
+    if (threads > COMETTEX_REPLACE_MAX_THREADS) threads = COMETTEX_REPLACE_MAX_THREADS;
+    if (threads < 1 || n < COMETTEX_REPLACE_PARALLEL_ROWS) threads = 1;
+
+    replaceJob jobs[COMETTEX_REPLACE_MAX_THREADS];
+    pthread_t tids[COMETTEX_REPLACE_MAX_THREADS];
+    int started = 0;
+    for (int t = 0;t<threads;t++){
+        jobs[t] = *base;
+        jobs[t].from = (long long)n * t / threads;
+        jobs[t].to = (long long)n * (t + 1) / threads;
+        if (t == 0) continue;
+        if (pthread_create(&tids[t], NULL, fn, &jobs[t]) != 0) break;
+        started = t;
+    }
+    //Whatever didn't get a thread is done here, after this thread's own slice
+    fn(&jobs[0]);
+    for (int t = 1;t<=started;t++) pthread_join(tids[t], NULL);
+    if (started + 1 < threads){
+        jobs[0].from = jobs[started + 1].from;
+        jobs[0].to = n;
+        fn(&jobs[0]);
+    }
+}
+
+int editorReplaceAll(editorConfig *ce, const char *find, const char *repl, int *rowsChanged){
+    *rowsChanged = 0;
+    size_t findLen = strlen(find);
+    if (findLen == 0 || ce->numRows == 0) return 0;
+
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    replaceJob job = {ce, find, findLen, repl, strlen(repl), NULL, NULL, NULL, 0, 0};
+    job.counts = malloc(sizeof(int) * ce->numRows);
+
+    //Reading cold rows goes through the block cache, which is one thread's
+    replaceRun(&job, replaceCountRows, ce->numRows, editorColdEnabled() ? 1 : threads);
+
+    int numChanged = 0;
+    int total = 0;
+    for (int i = 0;i<ce->numRows;i++){
+        if (job.counts[i]){
+            numChanged++;
+            total += job.counts[i];
+        }
+    }
+    if (numChanged == 0){
+        free(job.counts);
+        return 0;
+    }
+
+    job.changed = malloc(sizeof(int) * numChanged);
+    job.out = malloc(sizeof(char *) * numChanged);
+    int k = 0;
+    for (int i = 0;i<ce->numRows;i++){
+        if (!job.counts[i]) continue;
+        erow *row = &ce->row[i];
+        editorRowThaw(ce, row);
+        size_t len = row->size + (long long)job.counts[i] * ((long long)job.replLen - (long long)findLen);
+        job.changed[k] = i;
+        job.out[k] = rowAlloc(len + 1);
+        k++;
+    }
+
+    replaceRun(&job, replaceFillRows, numChanged, threads);
+
+    editorUndoBeginGroup();
+    for (k = 0;k<numChanged;k++){
+        int i = job.changed[k];
+        erow *row = &ce->row[i];
+        size_t len = row->size + (long long)job.counts[i] * ((long long)job.replLen - (long long)findLen);
+
+        //For undo a changed row is its old text deleted and its new text inserted
+        editorUndoRecordDelete(ce, i, 0, row->chars, row->size);
+        editorUndoRecordInsert(ce, i, 0, job.out[k], len);
+
+        rowFree(row->chars, row->size + 1);
+        row->chars = job.out[k];
+        row->size = len;
+        editorUpdateRow(ce, row);
+    }
+    editorUndoEndGroup();
+    ce->dirty++;
+
+    free(job.counts);
+    free(job.changed);
+    free(job.out);
+    *rowsChanged = numChanged;
+    return total;
+}
@@ -0,0 +1,11 @@
+#ifndef REPLACE_C_
+#define REPLACE_C_
+#include "CometTex.h"
+
+//Buffers with fewer rows than this are replaced on one thread
+#define COMETTEX_REPLACE_PARALLEL_ROWS 16384
+#define COMETTEX_REPLACE_MAX_THREADS 8
+
+int editorReplaceAll(editorConfig *ce, const char *find, const char *repl, int *rowsChanged);
+
+#endif
@@ -0,0 +1,179 @@
+#include <stdlib.h>
+#include <string.h>
+#include "rowAlloc.h"
+
+/*
+ Size classed allocator for row buffers (chars, render, highlight, checkpoints)
+ Buffers are carved out of big arenas and recycled through one free list per class.
+ Callers always pass the size they asked for, so there is no header per buffer.
+ Nothing goes back to the system until rowAllocReset, which drops every buffer at once.
+*/
+
+#define ROWALLOC_ARENA_MIN (64 * 1024)
+#define ROWALLOC_ARENA_MAX (4 * 1024 * 1024)
+
+static const int classSizes[ROWALLOC_CLASSES] = {
+    16, 24, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768,
+    1024, 1536, 2048, 3072, 4096, 6144, 8192
+};
+
+typedef struct arena{
+    struct arena *next;
+    size_t size;
+    size_t used;
+} arena;
+
+//Big buffers are kept in a list so rowAllocReset can find them
+typedef struct largeHdr{
+    struct largeHdr *prev;
+    struct largeHdr *next;
+    size_t size;
+    size_t pad;
+} largeHdr;
+
+static arena *arenas = NULL;
+static void *freeLists[ROWALLOC_CLASSES];
+static largeHdr *larges = NULL;
+static rowAllocStats stats;
+
+static int sizeClass(size_t size){
+    if (size > ROWALLOC_MAX_CLASS) return -1;
+    int c = 0;
+    while (classSizes[c] < (int)size) c++;
+    return c;
+}
+
+static void *arenaCarve(size_t size){
+    if (arenas == NULL || arenas->size - arenas->used < size){
+        //Each new arena is twice the last one up to ROWALLOC_ARENA_MAX
+        size_t asize = arenas ? arenas->size * 2 : ROWALLOC_ARENA_MIN;
+        if (asize > ROWALLOC_ARENA_MAX) asize = ROWALLOC_ARENA_MAX;
+        rowAllocReserve(asize);
+    }
+    void *p = (char *)arenas + sizeof(arena) + arenas->used;
+    arenas->used += size;
+    stats.arenaUsed += size;
+    return p;
+}
+
+//Makes sure the next bytes worth of buffers come from one arena
+void rowAllocReserve(size_t bytes){
+    if (arenas && arenas->size - arenas->used >= bytes) return;
+
+    //Keep the arena aligned for the checkpoint structs
+    bytes = (bytes + 15) & ~(size_t)15;
+    arena *a = malloc(sizeof(arena) + bytes);
+    if (a == NULL) return;
+    a->size = bytes;
+    a->used = 0;
+    //What's left in the old arena is only lost until the next reset
+    a->next = arenas;
+    arenas = a;
+    stats.arenaBytes += bytes;
+    stats.numArenas++;
+}
+
+void *rowAlloc(size_t size){
+    if (size == 0) return NULL;
+
+    int c = sizeClass(size);
+    if (c == -1){
+        largeHdr *h = malloc(sizeof(largeHdr) + size);
+        if (h == NULL) return NULL;
+        h->size = size;
+        h->prev = NULL;
+        h->next = larges;
+        if (larges) larges->prev = h;
+        larges = h;
+        stats.largeBytes += size;
+        stats.largeCount++;
+        return h + 1;
+    }
+
+    void *p = freeLists[c];
+    if (p){
+        freeLists[c] = *(void **)p;
+        stats.classFree[c]--;
+        stats.freeBytes -= classSizes[c];
+    }else{
+        p = arenaCarve(classSizes[c]);
+    }
+    stats.classLive[c]++;
+    stats.liveBytes += classSizes[c];
+    return p;
+}
+
+void rowFree(void *p, size_t size){
+    if (p == NULL) return;
+
+    int c = sizeClass(size);
+    if (c == -1){
+        largeHdr *h = (largeHdr *)p - 1;
+        if (h->prev) h->prev->next = h->next;
+        else larges = h->next;
+        if (h->next) h->next->prev = h->prev;
+        stats.largeBytes -= h->size;
+        stats.largeCount--;
+        free(h);
+        return;
+    }
+
+    *(void **)p = freeLists[c];
+    freeLists[c] = p;
+    stats.classLive[c]--;
+    stats.classFree[c]++;
+    stats.liveBytes -= classSizes[c];
+    stats.freeBytes += classSizes[c];
+}
+
+void *rowRealloc(void *p, size_t oldSize, size_t newSize){
+    if (p == NULL || oldSize == 0) return rowAlloc(newSize);
+    if (newSize == 0){
+        rowFree(p, oldSize);
+        return NULL;
+    }
+
+    int oc = sizeClass(oldSize);
+    int nc = sizeClass(newSize);
+    //Most edits stay in the same class and don't have to move at all
+    if (oc != -1 && oc == nc) return p;
+
+    if (oc == -1 && nc == -1){
+        largeHdr *h = (largeHdr *)p - 1;
+        largeHdr *n = realloc(h, sizeof(largeHdr) + newSize);
+        if (n == NULL) return NULL;
+        if (n->prev) n->prev->next = n;
+        else larges = n;
+        if (n->next) n->next->prev = n;
+        stats.largeBytes += newSize - n->size;
+        n->size = newSize;
+        return n + 1;
+    }
+
+    void *np = rowAlloc(newSize);
+    if (np == NULL) return NULL;
+    memcpy(np, p, oldSize < newSize ? oldSize : newSize);
+    rowFree(p, oldSize);
+    return np;
+}
+
+//Drops every buffer at once, only a few frees no matter how many rows there were
+void rowAllocReset(){
+    while (arenas){
+        arena *next = arenas->next;
+        free(arenas);
+        arenas = next;
+    }
+    while (larges){
+        largeHdr *next = larges->next;
+        free(larges);
+        larges = next;
+    }
+    memset(freeLists, 0, sizeof(freeLists));
+    memset(&stats, 0, sizeof(stats));
+}
+
+void rowAllocGetStats(rowAllocStats *st){
+    *st = stats;
+    for (int i = 0;i<ROWALLOC_CLASSES;i++) st->classSize[i] = classSizes[i];
+}
@@ -0,0 +1,30 @@
+#ifndef ROWALLOC_C_
+#define ROWALLOC_C_
+
+#include <stddef.h>
+
+#define ROWALLOC_CLASSES 19
+//Anything bigger than the last class is a plain malloc
+#define ROWALLOC_MAX_CLASS 8192
+
+typedef struct rowAllocStats{
+    size_t arenaBytes;  //Reserved from the system for the size classes
+    size_t arenaUsed;   //Carved out of the arenas so far
+    size_t liveBytes;   //Size class bytes handed out and not freed
+    size_t freeBytes;   //Size class bytes waiting on the free lists
+    size_t largeBytes;
+    int largeCount;
+    int numArenas;
+    int classSize[ROWALLOC_CLASSES];
+    int classLive[ROWALLOC_CLASSES];
+    int classFree[ROWALLOC_CLASSES];
+} rowAllocStats;
+
+void *rowAlloc(size_t size);
+void *rowRealloc(void *p, size_t oldSize, size_t newSize);
+void rowFree(void *p, size_t size);
+void rowAllocReserve(size_t bytes);
+void rowAllocReset();
+void rowAllocGetStats(rowAllocStats *st);
+
+#endif
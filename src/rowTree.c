@@ -0,0 +1,317 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "CometTex.h"
+#include "wrap.h"
+#include "brackets.h"
+#include "symbols.h"
+#include "rowTree.h"
+
+/*
+ Sums over runs of rows, for the lookups that would otherwise add up every row above:
+ which screen line a row starts on with soft wrap, and which row is on a given line,
+ which row closes a bracket that's still open, and the next row the symbol pass needs.
+
+ A B+ tree. A leaf stands for up to COMETTEX_ROWTREE_LEAF rows in a row and only knows
+ how many, a node above has up to COMETTEX_ROWTREE_FANOUT children, and every node keeps
+ the summaries of the rows under it. Which rows a leaf has is only where it is in the
+ order, so rows inserted or deleted change the count of the leaf they land in and the
+ nodes above it, splitting it or merging it into a neighbour. An Enter or a dd costs the
+ height of the tree instead of a rebuild.
+
+ A row that changes only marks its leaf and the nodes above it stale, summaries are
+ worked out again when a lookup asks for them, so a change to every row doesn't redo the
+ nodes over and over. The tree itself is built the first time it's asked for.
+*/
+
+typedef struct rowTree{
+    rowNode *root;
+    //The leaf the last lookup ended in and its first row, until rows come or go
+    rowNode *hint;
+    int hintStart;
+    size_t bytes;
+} rowTree;
+
+static rowNode *rtNew(rowTree *t, int leaf){
+    size_t size = offsetof(rowNode, child) + (leaf ? 0 : sizeof(rowNode *) * COMETTEX_ROWTREE_FANOUT);
+    rowNode *nd = calloc(1, size);
+    if (nd == NULL) die("calloc");
+    nd->leaf = leaf;
+    nd->stale = ROWTREE_ALL;
+    t->bytes += size;
+    return nd;
+}
+
+static void rtFreeNode(rowTree *t, rowNode *nd){
+    t->bytes -= offsetof(rowNode, child) + (nd->leaf ? 0 : sizeof(rowNode *) * COMETTEX_ROWTREE_FANOUT);
+    free(nd);
+}
+
+static void rtFreeAll(rowTree *t, rowNode *nd){
+    if (!nd->leaf){
+        for (int i = 0;i<nd->numChildren;i++) rtFreeAll(t, nd->child[i]);
+    }
+    rtFreeNode(t, nd);
+}
+
+//Every node above a stale one is stale too, so this stops at the first that already is
+static void rtStale(rowNode *nd, int what){
+    for (; nd && (nd->stale & what) != what; nd = nd->parent) nd->stale |= what;
+}
+
+static void rtAddRows(rowNode *nd, int d){
+    for (; nd; nd = nd->parent) nd->rows += d;
+}
+
+static int rtIndex(rowNode *p, rowNode *nd){
+    int i = 0;
+    while (p->child[i] != nd) i++;
+    return i;
+}
+
+//Leaves three quarters full, so the first rows inserted don't split them straight away
+static rowTree *rtBuild(editorConfig *ce){
+    rowTree *t = calloc(1, sizeof(rowTree));
+    if (t == NULL) die("calloc");
+    int per = COMETTEX_ROWTREE_LEAF * 3 / 4;
+    int n = (ce->numRows + per - 1) / per;
+    if (n == 0) n = 1;
+
+    rowNode **level = malloc(sizeof(rowNode *) * n);
+    for (int i = 0;i<n;i++){
+        level[i] = rtNew(t, 1);
+        level[i]->rows = (i < n - 1) ? per : ce->numRows - per * (n - 1);
+    }
+    per = COMETTEX_ROWTREE_FANOUT * 3 / 4;
+    while (n > 1){
+        int m = (n + per - 1) / per;
+        for (int i = 0;i<m;i++){
+            rowNode *nd = rtNew(t, 0);
+            for (int j = i * per;j<n && j<(i + 1) * per;j++){
+                nd->child[nd->numChildren++] = level[j];
+                level[j]->parent = nd;
+                nd->rows += level[j]->rows;
+            }
+            level[i] = nd;
+        }
+        n = m;
+    }
+    t->root = level[0];
+    free(level);
+    return t;
+}
+
+//The leaf row y is in and its first row in *start. y == rows gives the last leaf
+static rowNode *rtLeaf(rowTree *t, int y, int *start){
+    if (t->hint && y >= t->hintStart && y < t->hintStart + t->hint->rows){
+        *start = t->hintStart;
+        return t->hint;
+    }
+    rowNode *nd = t->root;
+    int s = 0;
+    while (!nd->leaf){
+        int i = 0;
+        while (i < nd->numChildren - 1 && y >= s + nd->child[i]->rows){
+            s += nd->child[i]->rows;
+            i++;
+        }
+        nd = nd->child[i];
+    }
+    t->hint = nd;
+    t->hintStart = s;
+    *start = s;
+    return nd;
+}
+
+//Puts nd, and the rows it stands for, right after the node after. A full parent is split in two
+static void rtInsertAfter(rowTree *t, rowNode *nd, rowNode *after){
+    rowNode *p = after->parent;
+    if (p == NULL){
+        p = rtNew(t, 0);
+        p->child[p->numChildren++] = after;
+        p->rows = after->rows;
+        after->parent = p;
+        t->root = p;
+    }
+    int i = rtIndex(p, after);
+    if (p->numChildren == COMETTEX_ROWTREE_FANOUT){
+        int half = COMETTEX_ROWTREE_FANOUT / 2;
+        rowNode *q = rtNew(t, 0);
+        for (int j = half;j<COMETTEX_ROWTREE_FANOUT;j++){
+            q->child[q->numChildren++] = p->child[j];
+            p->child[j]->parent = q;
+            q->rows += p->child[j]->rows;
+        }
+        p->numChildren = half;
+        p->stale = ROWTREE_ALL;
+        //q's rows are already counted above p, they're counted again as q goes in
+        rtAddRows(p, -q->rows);
+        rtInsertAfter(t, q, p);
+        if (i >= half){
+            p = q;
+            i -= half;
+        }
+    }
+    memmove(&p->child[i + 2], &p->child[i + 1], sizeof(rowNode *) * (p->numChildren - i - 1));
+    p->child[i + 1] = nd;
+    p->numChildren++;
+    nd->parent = p;
+    rtAddRows(p, nd->rows);
+    rtStale(p, ROWTREE_ALL);
+}
+
+static void rtInsert(rowTree *t, int at, int n){
+    int start;
+    rowNode *leaf = rtLeaf(t, at, &start);
+    rtAddRows(leaf, n);
+    rtStale(leaf, ROWTREE_ALL);
+    //Too many for one leaf, the rest go into new leaves after it
+    while (leaf->rows > COMETTEX_ROWTREE_LEAF){
+        rowNode *nd = rtNew(t, 1);
+        nd->rows = COMETTEX_ROWTREE_LEAF / 2;
+        rtAddRows(leaf, -nd->rows);
+        rtInsertAfter(t, nd, leaf);
+    }
+}
+
+//nd got too small, it's merged into a neighbour or evened out with it
+static void rtUnderflow(rowTree *t, rowNode *nd){
+    rowNode *p = nd->parent;
+    if (p == NULL){
+        //A root with one child isn't needed
+        if (!nd->leaf && nd->numChildren == 1){
+            t->root = nd->child[0];
+            t->root->parent = NULL;
+            rtFreeNode(t, nd);
+        }
+        return;
+    }
+    int size = nd->leaf ? nd->rows : nd->numChildren;
+    int max = nd->leaf ? COMETTEX_ROWTREE_LEAF : COMETTEX_ROWTREE_FANOUT;
+    if (size >= max / 4 && (size > 0 || !nd->leaf)) return;
+    if (p->numChildren == 1){
+        //Nothing to merge with here, but p is too small itself now
+        rtUnderflow(t, p);
+        return;
+    }
+
+    int i = rtIndex(p, nd);
+    rowNode *left = (i > 0) ? p->child[i - 1] : nd;
+    rowNode *right = (i > 0) ? nd : p->child[i + 1];
+    rowNode *other = (i > 0) ? left : right;
+    int sibling = other->leaf ? other->rows : other->numChildren;
+
+    if (size + sibling <= max){
+        //right goes into left
+        if (left->leaf){
+            left->rows += right->rows;
+        }else{
+            for (int j = 0;j<right->numChildren;j++){
+                left->child[left->numChildren++] = right->child[j];
+                right->child[j]->parent = left;
+            }
+            left->rows += right->rows;
+        }
+        int r = rtIndex(p, right);
+        memmove(&p->child[r], &p->child[r + 1], sizeof(rowNode *) * (p->numChildren - r - 1));
+        p->numChildren--;
+        rtFreeNode(t, right);
+        left->stale = ROWTREE_ALL;
+        rtStale(p, ROWTREE_ALL);
+        rtUnderflow(t, p);
+    }else if (nd->leaf){
+        //Rows are only counts, evening them out is moving a number
+        int total = left->rows + right->rows;
+        left->rows = total / 2;
+        right->rows = total - total / 2;
+        left->stale = right->stale = ROWTREE_ALL;
+        rtStale(p, ROWTREE_ALL);
+    }
+}
+
+static void rtDelete(rowTree *t, int at, int n){
+    while (n > 0){
+        int start;
+        rowNode *leaf = rtLeaf(t, at, &start);
+        int take = start + leaf->rows - at;
+        if (take > n) take = n;
+        rtAddRows(leaf, -take);
+        rtStale(leaf, ROWTREE_ALL);
+        n -= take;
+        rtUnderflow(t, leaf);
+        t->hint = NULL;
+    }
+}
+
+//n rows were inserted (n > 0) or deleted (n < 0) at at
+void editorRowTreeMoved(editorConfig *ce, int at, int n){
+    rowTree *t = ce->rowTree;
+    if (t == NULL || n == 0) return;
+    t->hint = NULL;
+    if (n > 0) rtInsert(t, at, n);
+    else rtDelete(t, at, -n);
+    t->hint = NULL;
+}
+
+//Row y changed what it adds to the summaries in what
+void editorRowTreeChanged(editorConfig *ce, int y, int what){
+    rowTree *t = ce->rowTree;
+    if (t == NULL || y < 0 || y >= t->root->rows) return;
+    int start;
+    rtStale(rtLeaf(t, y, &start), what);
+}
+
+static void rtStaleAll(rowNode *nd, int what){
+    nd->stale |= what;
+    if (nd->leaf) return;
+    for (int i = 0;i<nd->numChildren;i++) rtStaleAll(nd->child[i], what);
+}
+
+//Every row changed what it adds to the summaries in what
+void editorRowTreeStale(editorConfig *ce, int what){
+    if (ce->rowTree) rtStaleAll(ce->rowTree->root, what);
+}
+
+//Works out the summaries in what of nd, whose first row is start, where they're stale
+static void rtFresh(editorConfig *ce, rowNode *nd, int start, int what){
+    what &= nd->stale;
+    if (!what) return;
+    if (what & ROWTREE_LINES) nd->lines = 0;
+    if (what & ROWTREE_BRACKETS) nd->brackets.sum = nd->brackets.min = nd->brackets.max = 0;
+    if (what & ROWTREE_UNSCANNED) nd->unscanned = 0;
+    if (nd->leaf){
+        for (int y = start;y<start + nd->rows;y++){
+            if (what & ROWTREE_LINES) nd->lines += editorWrapRowLines(ce, &ce->row[y]);
+            if (what & ROWTREE_BRACKETS) nd->brackets = editorBracketJoin(nd->brackets, ce->row[y].brackets);
+            if (what & ROWTREE_UNSCANNED) nd->unscanned += (ce->row[y].symKind == SYMBOL_UNSCANNED);
+        }
+    }else{
+        for (int i = 0;i<nd->numChildren;i++){
+            rowNode *c = nd->child[i];
+            rtFresh(ce, c, start, what);
+            if (what & ROWTREE_LINES) nd->lines += c->lines;
+            if (what & ROWTREE_BRACKETS) nd->brackets = editorBracketJoin(nd->brackets, c->brackets);
+            if (what & ROWTREE_UNSCANNED) nd->unscanned += c->unscanned;
+            start += c->rows;
+        }
+    }
+    nd->stale &= ~what;
+}
+
+//The root with the summaries in what up to date, and so every node under it
+rowNode *editorRowTreeRoot(editorConfig *ce, int what){
+    if (ce->rowTree == NULL) ce->rowTree = rtBuild(ce);
+    rtFresh(ce, ce->rowTree->root, 0, what);
+    return ce->rowTree->root;
+}
+
+void editorRowTreeFree(editorConfig *ce){
+    if (ce->rowTree == NULL) return;
+    rtFreeAll(ce->rowTree, ce->rowTree->root);
+    free(ce->rowTree);
+    ce->rowTree = NULL;
+}
+
+size_t editorRowTreeBytes(editorConfig *ce){
+    return ce->rowTree ? sizeof(rowTree) + ce->rowTree->bytes : 0;
+}
@@ -0,0 +1,41 @@
+#ifndef ROWTREE_C_
+#define ROWTREE_C_
+#include <stddef.h>
+#include "CometTex.h"
+
+//Rows a leaf stands for at most, and children of a node
+#define COMETTEX_ROWTREE_LEAF 64
+#define COMETTEX_ROWTREE_FANOUT 16
+
+//What a node keeps about its rows, each is worked out again on its own
+enum rowTreeSummary{
+    ROWTREE_LINES = 1,
+    ROWTREE_BRACKETS = 2,
+    ROWTREE_UNSCANNED = 4,
+};
+#define ROWTREE_ALL (ROWTREE_LINES | ROWTREE_BRACKETS | ROWTREE_UNSCANNED)
+
+typedef struct rowNode{
+    struct rowNode *parent;
+    int rows;
+    //Screen lines of the rows with soft wrap on
+    int lines;
+    //Brackets of the rows, see brackets.c
+    bracketSummary brackets;
+    //Rows the symbol pass has yet to look at, see symbols.c
+    int unscanned;
+    //Summaries that changed under the node since they were worked out
+    unsigned char stale;
+    unsigned char leaf;
+    int numChildren;
+    struct rowNode *child[];
+} rowNode;
+
+void editorRowTreeMoved(editorConfig *ce, int at, int n);
+void editorRowTreeChanged(editorConfig *ce, int y, int what);
+void editorRowTreeStale(editorConfig *ce, int what);
+rowNode *editorRowTreeRoot(editorConfig *ce, int what);
+void editorRowTreeFree(editorConfig *ce);
+size_t editorRowTreeBytes(editorConfig *ce);
+
+#endif
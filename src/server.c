@@ -0,0 +1,358 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "CometTex.h"
+#include "rawmode.h"
+#include "server.h"
+
+/*
+ Editor server. CometTex --server FILE opens the file once and keeps it open with nobody
+ looking, and CometTex FILE after that attaches to it in the time it takes to connect a
+ socket: no reading, no highlighting, the undo history and cursor are where they were left.
+
+ The editor itself doesn't know. It runs as usual on a pty, and a small process in front of
+ it passes what it draws to every attached terminal and what they type back to it. The pty
+ is as big as the smallest of them, and it gets SIGWINCH on each attach so it draws the
+ whole screen again for the new one.
+
+ It's one server per file. The rows, undo and cold storage behind a buffer are kept once for
+ the whole process, so two files can't share one.
+
+ What a client sends is 'k', a length and that many bytes typed, or 'w' and its size as two
+ unsigned shorts. A client that falls behind on what's drawn is dropped rather than holding
+ the editor up, attaching again gets a whole screen.
+*/
+
+typedef struct serverClient{
+    int fd;
+    unsigned short rows, cols; //0 until it says
+    unsigned char in[512];
+    int inLen;
+} serverClient;
+
+//Where the server for filename listens, a socket named after its full path in a directory
+//only we can get into. The directory is made when create is set, for the server
+static int serverSocketPath(const char *filename, struct sockaddr_un *addr, int create){
+    char path[PATH_MAX];
+    if (realpath(filename, path) == NULL){
+        //Not saved yet, the path it will have. One too long for a path can't be served
+        char cwd[PATH_MAX];
+        int n;
+        if (filename[0] == '/' || getcwd(cwd, sizeof(cwd)) == NULL) n = snprintf(path, sizeof(path), "%s", filename);
+        else n = snprintf(path, sizeof(path), "%s/%s", cwd, filename);
+        if (n < 0 || n >= (int)sizeof(path)) return -1;
+    }
+
+    char dir[PATH_MAX];
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    int n;
+    if (runtime && runtime[0]) n = snprintf(dir, sizeof(dir), "%s/comettex", runtime);
+    else n = snprintf(dir, sizeof(dir), "/tmp/comettex-%d", (int)getuid());
+    if (n < 0 || n >= (int)sizeof(dir)) return -1;
+    if (create) mkdir(dir, 0700);
+    struct stat st;
+    if (lstat(dir, &st) == -1 || !S_ISDIR(st.st_mode) || st.st_uid != getuid() || (st.st_mode & 077)) return -1;
+
+    unsigned long long hash = 14695981039346656037ULL;
+    for (const char *p = path;*p;p++){
+        hash ^= (unsigned char)*p;
+        hash *= 1099511628211ULL;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    n = snprintf(addr->sun_path, sizeof(addr->sun_path), "%s/%016llx.sock", dir, hash);
+    return (n < (int)sizeof(addr->sun_path)) ? 0 : -1;
+}
+
+//A connection to the server for the socket, -1 when there's none. One left by a server
+//that died is removed
+static int serverConnect(struct sockaddr_un *addr){
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) return -1;
+    if (connect(fd, (struct sockaddr *)addr, sizeof(*addr)) == -1){
+        if (errno == ECONNREFUSED) unlink(addr->sun_path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int serverWriteAll(int fd, const void *buf, int len){
+    const char *p = buf;
+    while (len > 0){
+        int n = write(fd, p, len);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static volatile sig_atomic_t clientResized = 0;
+
+static void clientWinch(int sig){
+    (void)sig;
+    clientResized = 1;
+}
+
+static int clientSendSize(int fd){
+    int rows, cols;
+    if (getWindowSize(&rows, &cols) == -1) return 0;
+    unsigned char msg[5] = {'w'};
+    unsigned short r = rows, c = cols;
+    memcpy(msg + 1, &r, 2);
+    memcpy(msg + 3, &c, 2);
+    return serverWriteAll(fd, msg, sizeof(msg));
+}
+
+static int clientSendKeys(int fd, const unsigned char *keys, int len){
+    unsigned char msg[2 + 255] = {'k', len};
+    memcpy(msg + 2, keys, len);
+    return serverWriteAll(fd, msg, 2 + len);
+}
+
+/*
+ Shows the server's editor for filename on this terminal until it quits or
+ COMETTEX_DETACH_KEY is typed. -1 right away when no server has the file
+*/
+int editorAttach(const char *filename){
+    struct sockaddr_un addr;
+    if (serverSocketPath(filename, &addr, 0) == -1) return -1;
+    int fd = serverConnect(&addr);
+    if (fd == -1) return -1;
+
+    //Only the terminal settings are used, they go back when we exit
+    static editorConfig term;
+    enableRawMode(&term);
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = clientWinch;
+    sigaction(SIGWINCH, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    int detached = 0;
+    if (clientSendSize(fd) == -1) detached = -1;
+    while (!detached){
+        if (clientResized){
+            clientResized = 0;
+            if (clientSendSize(fd) == -1) break;
+        }
+        struct pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {fd, POLLIN, 0}};
+        if (poll(fds, 2, -1) == -1){
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (fds[0].revents & POLLIN){
+            unsigned char keys[255];
+            int n = read(STDIN_FILENO, keys, sizeof(keys));
+            if (n > 0){
+                unsigned char *stop = memchr(keys, COMETTEX_DETACH_KEY, n);
+                if (stop){
+                    n = stop - keys;
+                    detached = 1;
+                }
+                if (n > 0 && clientSendKeys(fd, keys, n) == -1) break;
+            }
+        }
+        if (fds[1].revents & (POLLIN | POLLHUP | POLLERR)){
+            char buf[16384];
+            int n = read(fd, buf, sizeof(buf));
+            //The editor quit, it cleared the screen on the way out
+            if (n <= 0) break;
+            serverWriteAll(STDOUT_FILENO, buf, n);
+        }
+    }
+    close(fd);
+    if (detached == 1){
+        write(STDOUT_FILENO, "\x1b[2J", 4);
+        write(STDOUT_FILENO, "\x1b[H", 3);
+    }
+    return 0;
+}
+
+static void serverDrop(serverClient *clients, int *numClients, int i){
+    close(clients[i].fd);
+    clients[i] = clients[--*numClients];
+}
+
+//The pty takes the smallest size any client has, and the editor draws everything again
+static void serverResize(int master, pid_t editor, serverClient *clients, int numClients){
+    struct winsize ws = {0};
+    for (int i = 0;i<numClients;i++){
+        if (clients[i].rows == 0) continue;
+        if (ws.ws_row == 0 || clients[i].rows < ws.ws_row) ws.ws_row = clients[i].rows;
+        if (ws.ws_col == 0 || clients[i].cols < ws.ws_col) ws.ws_col = clients[i].cols;
+    }
+    if (ws.ws_row) ioctl(master, TIOCSWINSZ, &ws);
+    kill(editor, SIGWINCH);
+}
+
+//Takes whole messages from what a client sent, -1 when it sent something that isn't one
+static int serverClientInput(int master, serverClient *c, int *resized){
+    int at = 0;
+    while (c->inLen - at >= 2){
+        unsigned char *m = c->in + at;
+        if (m[0] == 'k'){
+            if (c->inLen - at < 2 + m[1]) break;
+            serverWriteAll(master, m + 2, m[1]);
+            at += 2 + m[1];
+        }else if (m[0] == 'w'){
+            if (c->inLen - at < 5) break;
+            memcpy(&c->rows, m + 1, 2);
+            memcpy(&c->cols, m + 3, 2);
+            *resized = 1;
+            at += 5;
+        }else{
+            return -1;
+        }
+    }
+    memmove(c->in, c->in + at, c->inLen - at);
+    c->inLen -= at;
+    return 0;
+}
+
+//Between the clients and the editor on master until the editor exits
+static void serverLoop(int listenFd, int master, pid_t editor){
+    serverClient clients[COMETTEX_SERVER_CLIENTS];
+    int numClients = 0;
+    while (1){
+        struct pollfd fds[2 + COMETTEX_SERVER_CLIENTS];
+        fds[0] = (struct pollfd){master, POLLIN, 0};
+        fds[1] = (struct pollfd){listenFd, POLLIN, 0};
+        for (int i = 0;i<numClients;i++) fds[2 + i] = (struct pollfd){clients[i].fd, POLLIN, 0};
+        int polled = numClients;
+        if (poll(fds, 2 + polled, -1) == -1){
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        int resized = 0;
+        //Clients first, the ones dropped on the way are only ever the last ones polled
+        for (int i = polled - 1;i>=0;i--){
+            if (!(fds[2 + i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            serverClient *c = &clients[i];
+            int n = read(c->fd, c->in + c->inLen, sizeof(c->in) - c->inLen);
+            if (n <= 0){
+                serverDrop(clients, &numClients, i);
+                resized = 1;
+                continue;
+            }
+            c->inLen += n;
+            if (serverClientInput(master, c, &resized) == -1){
+                serverDrop(clients, &numClients, i);
+                resized = 1;
+            }
+        }
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)){
+            char buf[16384];
+            int n = read(master, buf, sizeof(buf));
+            //EIO once the editor has exited and nothing has the pty open
+            if (n <= 0 && !(n == -1 && errno == EINTR)) break;
+            for (int i = numClients - 1;n > 0 && i>=0;i--){
+                if (send(clients[i].fd, buf, n, MSG_DONTWAIT | MSG_NOSIGNAL) == n) continue;
+                serverDrop(clients, &numClients, i);
+                resized = 1;
+            }
+        }
+        if (fds[1].revents & POLLIN){
+            int fd = accept(listenFd, NULL, NULL);
+            if (fd != -1 && numClients == COMETTEX_SERVER_CLIENTS){
+                close(fd);
+            }else if (fd != -1){
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+                clients[numClients++] = (serverClient){fd, 0, 0, {0}, 0};
+            }
+        }
+        if (resized) serverResize(master, editor, clients, numClients);
+    }
+    for (int i = 0;i<numClients;i++) close(clients[i].fd);
+}
+
+/*
+ Starts a server for filename and attaches this terminal to it, or only attaches when one
+ already has the file. Returns only in the process that goes on to be the editor, with its
+ stdin and stdout on the server's pty
+*/
+int editorServe(const char *filename){
+    struct sockaddr_un addr;
+    if (serverSocketPath(filename, &addr, 1) == -1) die("editorServe() no socket directory");
+    int fd = serverConnect(&addr);
+    if (fd != -1){
+        close(fd);
+        exit(editorAttach(filename) == -1);
+    }
+
+    //Listening before anything forks, so attaching can't beat it
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd == -1) die("editorServe() socket");
+    if (bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) == -1) die("editorServe() bind");
+    if (listen(listenFd, COMETTEX_SERVER_CLIENTS) == -1) die("editorServe() listen");
+
+    struct winsize ws = {0};
+    int rows, cols;
+    if (getWindowSize(&rows, &cols) != -1){
+        ws.ws_row = rows;
+        ws.ws_col = cols;
+    }
+
+    pid_t pid = fork();
+    if (pid == -1) die("editorServe() fork");
+    if (pid > 0){
+        //This terminal is the first client
+        close(listenFd);
+        exit(editorAttach(filename) == -1);
+    }
+
+    setsid();
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master == -1 || grantpt(master) == -1 || unlockpt(master) == -1) _exit(1);
+    if (ws.ws_row) ioctl(master, TIOCSWINSZ, &ws);
+    //Opened here so the pty never has nobody on the other side before the editor is up
+    int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    if (slave == -1) _exit(1);
+
+    pid_t editor = fork();
+    if (editor == -1) _exit(1);
+    if (editor == 0){
+        //The pty becomes the editor's terminal
+        setsid();
+        ioctl(slave, TIOCSCTTY, 0);
+        dup2(slave, STDIN_FILENO);
+        dup2(slave, STDOUT_FILENO);
+        dup2(slave, STDERR_FILENO);
+        if (slave > STDERR_FILENO) close(slave);
+        close(master);
+        close(listenFd);
+        return 0;
+    }
+    close(slave);
+
+    int null = open("/dev/null", O_RDWR);
+    if (null != -1){
+        dup2(null, STDIN_FILENO);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        if (null > STDERR_FILENO) close(null);
+    }
+    signal(SIGPIPE, SIG_IGN);
+    fcntl(listenFd, F_SETFD, FD_CLOEXEC);
+    serverLoop(listenFd, master, editor);
+    unlink(addr.sun_path);
+    close(master);
+    waitpid(editor, NULL, 0);
+    _exit(0);
+}
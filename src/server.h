@@ -0,0 +1,12 @@
+#ifndef SERVER_C_
+#define SERVER_C_
+
+//Clients one server takes at once
+#define COMETTEX_SERVER_CLIENTS 16
+//Key that detaches a client and leaves the server running, Ctrl+Backslash
+#define COMETTEX_DETACH_KEY 0x1c
+
+int editorAttach(const char *filename);
+int editorServe(const char *filename);
+
+#endif
@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "CometTex.h"
+#include "ops.h"
+#include "syntaxHighlighting.h"
+#include "coldRows.h"
+#include "languages.h"
+#include "session.h"
+
+/*
+ Session cache. Opening a file splits it into rows, renders every one and lexes the whole
+ file for highlighting. What that leaves behind that matters before a row is on screen is
+ small: where each row is in the file, whether it ends inside a comment, its brackets and
+ its tab bucket. That's written to a session file when the buffer is saved or the editor
+ quits, and the next open of the same unchanged file reads it back instead.
+
+ The session has a header and then one array for each of those, so it's mmapped and read
+ as it is. It's used when the file has the size, mtime and content hash the header has,
+ and the syntax for the file lexes comments and strings the same. The rows are then made
+ cold straight from the file's text, see editorColdAddBlock, and only the ones that get
+ drawn or edited are ever rendered and highlighted.
+
+ Sessions go in the comettex/sessions cache directory, one per file named after a hash
+ of its full path.
+*/
+
+#define SESSION_MAGIC "CTSESS1"
+
+typedef struct sessionHeader{
+    char magic[8];
+    long long size;
+    long long mtime;
+    long long mtimeNs;
+    unsigned long long hash;    //Of the file's contents, see sessionHash
+    unsigned long long syntax;  //See sessionSyntaxKey
+    int numRows;
+    int my, mx;
+    int rowOffset, colOffset;
+    int pad;
+} sessionHeader;
+
+//After the header: long long off[numRows], int len[numRows], bracketSummary brackets[numRows]
+//and unsigned char flags[numRows]
+#define SESSION_OPEN_COMMENT 0x80
+#define SESSION_TAB_MASK 0x7f
+
+static size_t sessionLen(int numRows){
+    return sizeof(sessionHeader) + (size_t)numRows * (sizeof(long long) + sizeof(int) + sizeof(bracketSummary) + 1);
+}
+
+//Eight bytes at a time, the whole file goes through it on every warm open
+static unsigned long long sessionHash(const unsigned char *p, size_t len){
+    unsigned long long h = 0x9e3779b97f4a7c15ULL ^ len;
+    size_t i = 0;
+    for (;i + 8 <= len;i += 8){
+        unsigned long long w;
+        memcpy(&w, p + i, 8);
+        h = (h ^ w) * 0xff51afd7ed558ccdULL;
+        h ^= h >> 32;
+    }
+    unsigned long long w = 0;
+    memcpy(&w, p + i, len - i);
+    h = (h ^ w) * 0xff51afd7ed558ccdULL;
+    return h ^ (h >> 29);
+}
+
+static unsigned long long sessionFnv(unsigned long long h, const char *s){
+    if (s == NULL) s = "";
+    do{
+        h ^= (unsigned char)*s;
+        h *= 1099511628211ULL;
+    }while (*s++);
+    return h;
+}
+
+//What decides where comments and strings are, which is all the saved lexer state depends on
+static unsigned long long sessionSyntaxKey(struct editorSyntax *syntax){
+    if (syntax == NULL) return 0;
+    unsigned long long h = 14695981039346656037ULL;
+    h = sessionFnv(h, syntax->fileType);
+    h = sessionFnv(h, syntax->singleCommentStart);
+    h = sessionFnv(h, syntax->multiCommentStart);
+    h = sessionFnv(h, syntax->multiCommentEnd);
+    h ^= (unsigned int)syntax->flags;
+    return h ? h : 1;
+}
+
+static char *sessionPath(const char *filename){
+    char real[PATH_MAX];
+    if (realpath(filename, real) == NULL) return NULL;
+
+    const char *base = getenv("XDG_CACHE_HOME");
+    const char *sub = "";
+    if (base == NULL || *base == '\0'){
+        base = getenv("HOME");
+        sub = "/.cache";
+        if (base == NULL) return NULL;
+    }
+    char *path = malloc(strlen(base) + strlen(sub) + strlen(COMETTEX_SESSION_DIR) + 32);
+    sprintf(path, "%s%s/%s/%016llx", base, sub, COMETTEX_SESSION_DIR, sessionFnv(14695981039346656037ULL, real));
+    return path;
+}
+
+//Makes the cold rows from the file's text in blocks the size editorFreezeRows makes them
+static void sessionLoadRows(editorConfig *ce, const char *text, long long *off, int *len, bracketSummary *brackets, unsigned char *flags, int numRows){
+    editorReserveRows(ce, numRows);
+    int y = 0;
+    while (y < numRows){
+        int first = y;
+        int rawLen = 0;
+        while (y < numRows && y - first < COMETTEX_COLD_BLOCK_ROWS && (y == first || rawLen + len[y] + 1 <= COMETTEX_COLD_BLOCK_BYTES)){
+            rawLen += len[y] + 1;
+            y++;
+        }
+
+        char *raw = malloc(rawLen);
+        int at = 0;
+        for (int i = first;i<y;i++){
+            memcpy(raw + at, text + off[i], len[i]);
+            raw[at + len[i]] = '\0';
+            at += len[i] + 1;
+        }
+        int b = editorColdAddBlock(raw, rawLen, y - first);
+
+        at = 0;
+        for (int i = first;i<y;i++){
+            erow *row = editorInsertColdRow(ce, ce->numRows, len[i], b, at, flags[i] & SESSION_TAB_MASK);
+            row->hlOpenComment = (flags[i] & SESSION_OPEN_COMMENT) != 0;
+            row->brackets = brackets[i];
+            at += len[i] + 1;
+        }
+    }
+}
+
+//Every row has to be somewhere in the file and the flags have to make sense
+static int sessionRowsValid(sessionHeader *h, long long *off, int *len, unsigned char *flags){
+    for (int i = 0;i<h->numRows;i++){
+        if (off[i] < 0 || len[i] < 0 || off[i] + len[i] > h->size) return 0;
+        if ((flags[i] & SESSION_TAB_MASK) >= COMETTEX_STATS_TAB_BUCKETS) return 0;
+    }
+    return 1;
+}
+
+/*
+ Opens the file on fd from its session when there's one for it as it is now. Returns 1
+ with the rows, syntax and cursor set, or 0 having done nothing
+*/
+int editorSessionOpen(editorConfig *ce, int fd, struct stat *st){
+    if (ce->filename == NULL || !S_ISREG(st->st_mode) || st->st_size == 0) return 0;
+    char *path = sessionPath(ce->filename);
+    if (path == NULL) return 0;
+    int sfd = open(path, O_RDONLY);
+    free(path);
+    if (sfd == -1) return 0;
+
+    struct stat sst;
+    char *session = MAP_FAILED;
+    if (fstat(sfd, &sst) == 0 && (size_t)sst.st_size >= sizeof(sessionHeader)){
+        session = mmap(NULL, sst.st_size, PROT_READ, MAP_PRIVATE, sfd, 0);
+    }
+    close(sfd);
+    if (session == MAP_FAILED) return 0;
+
+    sessionHeader *h = (sessionHeader *)session;
+    struct editorSyntax *syntax = editorLanguageFor(ce->filename);
+    int loaded = 0;
+    if (!memcmp(h->magic, SESSION_MAGIC, sizeof(h->magic)) && h->numRows > 0 &&
+        sessionLen(h->numRows) == (size_t)sst.st_size && h->size == (long long)st->st_size &&
+        h->mtime == (long long)st->st_mtim.tv_sec && h->mtimeNs == (long long)st->st_mtim.tv_nsec &&
+        h->syntax == sessionSyntaxKey(syntax)){
+
+        long long *off = (long long *)(session + sizeof(sessionHeader));
+        int *len = (int *)(off + h->numRows);
+        bracketSummary *brackets = (bracketSummary *)(len + h->numRows);
+        unsigned char *flags = (unsigned char *)(brackets + h->numRows);
+
+        char *text = mmap(NULL, st->st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (text != MAP_FAILED){
+            if (sessionHash((unsigned char *)text, st->st_size) == h->hash && sessionRowsValid(h, off, len, flags)){
+                ce->syntax = syntax;
+                sessionLoadRows(ce, text, off, len, brackets, flags, h->numRows);
+                ce->my = (h->my < 0) ? 0 : (h->my > ce->numRows) ? ce->numRows : h->my;
+                int size = (ce->my < ce->numRows) ? ce->row[ce->my].size : 0;
+                ce->mx = (h->mx < 0) ? 0 : (h->mx > size) ? size : h->mx;
+                ce->rowOffset = (h->rowOffset < 0 || h->rowOffset > ce->my) ? ce->my : h->rowOffset;
+                ce->colOffset = (h->colOffset < 0) ? 0 : h->colOffset;
+                loaded = 1;
+            }
+            munmap(text, st->st_size);
+        }
+    }
+    munmap(session, sst.st_size);
+    return loaded;
+}
+
+/*
+ Writes the session for the buffer. Only when it's what's on disk: it isn't dirty, and
+ its rows with a \n after each add up to the file, give or take the last \n
+*/
+void editorSessionSave(editorConfig *ce){
+    if (ce->filename == NULL || ce->dirty || ce->numRows == 0) return;
+
+    long long total = 0;
+    for (int i = 0;i<ce->numRows;i++) total += ce->row[i].size + 1;
+    int fd = open(ce->filename, O_RDONLY);
+    if (fd == -1) return;
+    struct stat st;
+    char *text = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && (st.st_size == total || st.st_size == total - 1)){
+        text = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (text == MAP_FAILED) return;
+
+    size_t sessionSize = sessionLen(ce->numRows);
+    char *session = calloc(1, sessionSize);
+    sessionHeader *h = (sessionHeader *)session;
+    memcpy(h->magic, SESSION_MAGIC, sizeof(h->magic));
+    h->size = st.st_size;
+    h->mtime = st.st_mtim.tv_sec;
+    h->mtimeNs = st.st_mtim.tv_nsec;
+    h->hash = sessionHash((unsigned char *)text, st.st_size);
+    h->syntax = sessionSyntaxKey(ce->syntax);
+    h->numRows = ce->numRows;
+    h->my = ce->my;
+    h->mx = ce->mx;
+    h->rowOffset = ce->rowOffset;
+    h->colOffset = ce->colOffset;
+
+    long long *off = (long long *)(session + sizeof(sessionHeader));
+    int *len = (int *)(off + ce->numRows);
+    bracketSummary *brackets = (bracketSummary *)(len + ce->numRows);
+    unsigned char *flags = (unsigned char *)(brackets + ce->numRows);
+    long long at = 0;
+    int same = 1;
+    for (int i = 0;i<ce->numRows && same;i++){
+        erow *row = &ce->row[i];
+        off[i] = at;
+        len[i] = row->size;
+        brackets[i] = row->brackets;
+        flags[i] = (row->statTabs ? row->statTabs - 1 : 0) | (row->hlOpenComment ? SESSION_OPEN_COMMENT : 0);
+        //Changed on disk since it was read, the state we have is for something else
+        same = !memcmp(text + at, editorRowText(row), row->size) && (at + row->size == st.st_size || text[at + row->size] == '\n' ||
+            (at + row->size + 1 == st.st_size && text[at + row->size] == '\r'));
+        at += row->size + 1;
+    }
+    munmap(text, st.st_size);
+
+    char *path = same ? sessionPath(ce->filename) : NULL;
+    if (path == NULL){
+        free(session);
+        return;
+    }
+    //Make the directories on the way, the session is only an optimisation so failing is fine
+    for (char *p = strchr(path + 1, '/'); p; p = strchr(p + 1, '/')){
+        *p = '\0';
+        mkdir(path, 0700);
+        *p = '/';
+    }
+    char *tmp = malloc(strlen(path) + 16);
+    sprintf(tmp, "%s.%d", path, (int)getpid());
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd != -1){
+        size_t done = 0;
+        ssize_t n = 1;
+        while (done < sessionSize && (n = write(fd, session + done, sessionSize - done)) > 0) done += n;
+        int ok = (done == sessionSize);
+        close(fd);
+        if (!ok || rename(tmp, path) == -1) unlink(tmp);
+    }
+    free(tmp);
+    free(path);
+    free(session);
+}
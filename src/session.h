@@ -0,0 +1,11 @@
+#ifndef SESSION_C_
+#define SESSION_C_
+#include <sys/stat.h>
+#include "CometTex.h"
+
+#define COMETTEX_SESSION_DIR "comettex/sessions"
+
+int editorSessionOpen(editorConfig *ce, int fd, struct stat *st);
+void editorSessionSave(editorConfig *ce);
+
+#endif
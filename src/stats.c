@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <string.h>
+#include "CometTex.h"
+#include "ops.h"
+#include "syntaxHighlighting.h"
+#include "rowAlloc.h"
+#include "coldRows.h"
+#include "undo.h"
+#include "symbols.h"
+#include "diff.h"
+#include "rowTree.h"
+#include "stats.h"
+
+/*
+ Buffer statistics. Nothing here walks the rows: the row bytes and histograms are the
+ counters ops.c keeps in ce->stats, everything else comes from the stats each module
+ already keeps, so a report costs the same on any size of file.
+*/
+
+void editorMemoryGetStats(editorConfig *ce, memStats *st){
+    rowAllocStats ra;
+    coldStats cs;
+    undoStats us;
+    rowAllocGetStats(&ra);
+    editorColdGetStats(&cs);
+    editorUndoGetStats(&us);
+
+    memset(st, 0, sizeof(*st));
+    st->text = ce->stats.textBytes;
+    st->render = ce->stats.renderBytes;
+    st->hl = ce->stats.hlBytes;
+    st->rows = sizeof(erow) * ce->rowCap + sizeof(unsigned long long) * ce->diffRowsCap;
+    st->cold = cs.compressedBytes;
+    st->undo = us.textCap + us.recordBytes;
+    st->caches = cs.cacheBytes + editorHlScratchBytes() + editorYankBytes() + sizeof(editorCursor) * ce->cursorCap +
+        sizeof(editorSymbol) * ce->symbolsCap + ce->symbolNamesCap +
+        editorRowTreeBytes(ce) + sizeof(unsigned long long) * ce->diffBaseCap + sizeof(diffHunk) * ce->diffHunksCap;
+
+    //Everything the allocator got from the system that isn't a row buffer: size class
+    //rounding, free lists and arena space not handed out yet
+    size_t held = ra.arenaBytes + ra.largeBytes;
+    size_t used = st->text + st->render + st->hl;
+    st->alloc = held > used ? held - used : 0;
+
+    st->total = st->text + st->render + st->hl + st->rows + st->cold + st->undo + st->caches + st->alloc;
+}
+
+static const char *statsFmtBytes(size_t n, char *buf, size_t len){
+    if (n >= (size_t)1 << 30) snprintf(buf, len, "%.1fG", n / (double)(1 << 30));
+    else if (n >= 1 << 20) snprintf(buf, len, "%.1fM", n / (double)(1 << 20));
+    else if (n >= 1 << 10) snprintf(buf, len, "%.1fK", n / (double)(1 << 10));
+    else snprintf(buf, len, "%zuB", n);
+    return buf;
+}
+
+//One line for the message bar
+void editorMemorySummary(editorConfig *ce, char *buf, size_t len){
+    memStats st;
+    editorMemoryGetStats(ce, &st);
+    char a[16], b[16], c[16], d[16], e[16], f[16], g[16];
+    snprintf(buf, len, "%s: text %s render %s hl %s rows %s undo %s other %s",
+        statsFmtBytes(st.total, a, sizeof(a)), statsFmtBytes(st.text, b, sizeof(b)),
+        statsFmtBytes(st.render, c, sizeof(c)), statsFmtBytes(st.hl, d, sizeof(d)),
+        statsFmtBytes(st.rows, e, sizeof(e)), statsFmtBytes(st.undo, f, sizeof(f)),
+        statsFmtBytes(st.cold + st.caches + st.alloc, g, sizeof(g)));
+}
+
+static void statsPrintLine(FILE *f, const char *name, size_t n, size_t total){
+    char buf[16];
+    fprintf(f, "  %-10s %10s %5.1f%%\n", name, statsFmtBytes(n, buf, sizeof(buf)), total ? 100.0 * n / total : 0.0);
+}
+
+static void statsPrintBar(FILE *f, const char *label, long long n, long long max){
+    int width = max ? (int)(40 * n / max) : 0;
+    if (n && width == 0) width = 1;
+    fprintf(f, "  %-14s %10lld ", label, n);
+    for (int i = 0;i<width;i++) fputc('#', f);
+    fputc('\n', f);
+}
+
+//The full report, memory by category and the row histograms
+void editorPrintStats(editorConfig *ce, FILE *f){
+    memStats st;
+    editorMemoryGetStats(ce, &st);
+    char buf[16];
+
+    fprintf(f, "%s: %d rows, %s\n", ce->filename ? ce->filename : "[No Name]", ce->numRows,
+        statsFmtBytes(st.total, buf, sizeof(buf)));
+    statsPrintLine(f, "text", st.text, st.total);
+    statsPrintLine(f, "render", st.render, st.total);
+    statsPrintLine(f, "highlight", st.hl, st.total);
+    statsPrintLine(f, "rows", st.rows, st.total);
+    statsPrintLine(f, "cold", st.cold, st.total);
+    statsPrintLine(f, "undo", st.undo, st.total);
+    statsPrintLine(f, "caches", st.caches, st.total);
+    statsPrintLine(f, "allocator", st.alloc, st.total);
+
+    long long max = 0;
+    for (int i = 0;i<COMETTEX_STATS_LEN_BUCKETS;i++){
+        if (ce->stats.lenHist[i] > max) max = ce->stats.lenHist[i];
+    }
+    fprintf(f, "line length\n");
+    for (int i = 0;i<COMETTEX_STATS_LEN_BUCKETS;i++){
+        if (ce->stats.lenHist[i] == 0) continue;
+        char label[32];
+        if (i <= 1) snprintf(label, sizeof(label), "%d", i);
+        else if (i == COMETTEX_STATS_LEN_BUCKETS - 1) snprintf(label, sizeof(label), "%lld+", 1LL << (i - 1));
+        else snprintf(label, sizeof(label), "%lld-%lld", 1LL << (i - 1), (1LL << i) - 1);
+        statsPrintBar(f, label, ce->stats.lenHist[i], max);
+    }
+
+    max = 0;
+    for (int i = 0;i<COMETTEX_STATS_TAB_BUCKETS;i++){
+        if (ce->stats.tabHist[i] > max) max = ce->stats.tabHist[i];
+    }
+    fprintf(f, "tab density\n");
+    for (int i = 0;i<COMETTEX_STATS_TAB_BUCKETS;i++){
+        if (ce->stats.tabHist[i] == 0) continue;
+        char label[32];
+        if (i == 0) snprintf(label, sizeof(label), "no tabs");
+        else snprintf(label, sizeof(label), "%d-%d%%", (i - 1) * 10, i * 10);
+        statsPrintBar(f, label, ce->stats.tabHist[i], max);
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef STATS_C_
+#define STATS_C_
+#include <stdio.h>
+#include "CometTex.h"
+
+typedef struct memStats{
+    size_t text;        //Row chars
+    size_t render;      //Render buffers and rx checkpoints
+    size_t hl;          //Highlight spans and lexer checkpoints
+    size_t rows;        //The row array, erow structs included, and the tables lined up with it
+    size_t cold;        //Compressed cold blocks
+    size_t undo;        //Undo text arena and records
+    size_t caches;      //Cold block cache, lexer scratch, yank buffer, cursors
+    size_t alloc;       //Held by the row allocator without row data in it
+    size_t total;
+} memStats;
+
+void editorMemoryGetStats(editorConfig *ce, memStats *st);
+void editorMemorySummary(editorConfig *ce, char *buf, size_t len);
+void editorPrintStats(editorConfig *ce, FILE *f);
+
+#endif
@@ -0,0 +1,260 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "CometTex.h"
+#include "ops.h"
+#include "coldRows.h"
+#include "symbols.h"
+#include "rowTree.h"
+
+/*
+ Symbol index. Each row remembers what kind of definition starts on it, if any: a function,
+ a struct, union, enum or class, a typedef closing with "} name;" or a #define. Only the start
+ of rows at the top level is looked at, which is where definitions are in C and most things
+ like it, so a row costs the same to look at however long it is.
+
+ Rows are looked at by a pass run while waiting for keys, a slice at a time, see editorIdle.
+ A row that changes, or comes in, is just marked to be looked at again. The row tree counts
+ the marked rows under each node, so the pass goes down it to the next one instead of over
+ every row that was looked at already, and rows that only moved stay as they were.
+
+ The jump prompt matches against a list of every symbol with a copy of its name, so typing
+ into it doesn't touch the rows at all. The list is built again after rows with a symbol
+ change or rows come and go.
+*/
+
+static int symIdent(int c){
+    return isalnum(c) || c == '_';
+}
+
+static int symSkipSpace(const char *s, int i, int n){
+    while (i < n && (s[i] == ' ' || s[i] == '\t')) i++;
+    return i;
+}
+
+static int symSkipIdent(const char *s, int i, int n){
+    while (i < n && symIdent((unsigned char)s[i])) i++;
+    return i;
+}
+
+static int symWordIs(const char *s, int from, int to, const char *w){
+    return (int)strlen(w) == to - from && !memcmp(s + from, w, to - from);
+}
+
+//Looks for a definition at the start of s, the name is s[*off, *off + *len)
+static int symScanText(const char *s, int n, int *off, int *len){
+    if (n > COMETTEX_SYMBOL_SCAN) n = COMETTEX_SYMBOL_SCAN;
+    if (n == 0 || s[0] == ' ' || s[0] == '\t') return SYMBOL_NONE;
+
+    if (s[0] == '#'){
+        int i = symSkipSpace(s, 1, n);
+        int end = symSkipIdent(s, i, n);
+        if (!symWordIs(s, i, end, "define")) return SYMBOL_NONE;
+        *off = symSkipSpace(s, end, n);
+        *len = symSkipIdent(s, *off, n) - *off;
+        return *len ? SYMBOL_DEFINE : SYMBOL_NONE;
+    }
+    if (s[0] == '}'){
+        //The end of a typedef
+        *off = symSkipSpace(s, 1, n);
+        int end = symSkipIdent(s, *off, n);
+        *len = end - *off;
+        end = symSkipSpace(s, end, n);
+        return (*len && end < n && s[end] == ';') ? SYMBOL_TYPE : SYMBOL_NONE;
+    }
+
+    //The last char that isn't space, a declaration ends with ;
+    int last = n - 1;
+    while (last > 0 && isspace((unsigned char)s[last])) last--;
+    int declaration = (s[last] == ';' || s[last] == ',');
+
+    //struct name {, class Name(Base): and the like
+    int i = 0;
+    while (i < n && symIdent((unsigned char)s[i])){
+        int end = symSkipIdent(s, i, n);
+        if (symWordIs(s, i, end, "struct") || symWordIs(s, i, end, "union") ||
+            symWordIs(s, i, end, "enum") || symWordIs(s, i, end, "class")){
+            int nameFrom = symSkipSpace(s, end, n);
+            int nameTo = symSkipIdent(s, nameFrom, n);
+            int after = symSkipSpace(s, nameTo, n);
+            if (nameTo > nameFrom && !declaration && (after == n || (s[after] && strchr("{:(", s[after])))){
+                *off = nameFrom;
+                *len = nameTo - nameFrom;
+                return SYMBOL_TYPE;
+            }
+            break;
+        }
+        i = symSkipSpace(s, end, n);
+    }
+
+    //A function: a name right before the first (, after a return type or def, fn, func...
+    if (declaration) return SYMBOL_NONE;
+    for (i = 1;i<n;i++){
+        if (s[i] == '=' || s[i] == ';') return SYMBOL_NONE;
+        if (s[i] != '(' || !symIdent((unsigned char)s[i - 1])) continue;
+        int from = i;
+        while (from > 0 && symIdent((unsigned char)s[from - 1])) from--;
+        //Calls at the top level, main() at the end of a script
+        if (from == 0 || isdigit((unsigned char)s[from])) return SYMBOL_NONE;
+        if (symWordIs(s, from, i, "if") || symWordIs(s, from, i, "while") || symWordIs(s, from, i, "for") ||
+            symWordIs(s, from, i, "switch") || symWordIs(s, from, i, "return") || symWordIs(s, from, i, "sizeof")){
+            return SYMBOL_NONE;
+        }
+        *off = from;
+        *len = i - from;
+        return SYMBOL_FUNCTION;
+    }
+    return SYMBOL_NONE;
+}
+
+//Only the kind is kept, the name is found again when the list is built
+static void symScanRow(editorConfig *ce, erow *row){
+    int off, len;
+    row->symKind = symScanText(editorRowText(row), row->size, &off, &len);
+    editorRowTreeChanged(ce, row->idx, ROWTREE_UNSCANNED);
+    if (row->symKind != SYMBOL_NONE) ce->symbolsValid = 0;
+}
+
+//The row's text changed, the pass looks at it again
+void editorSymbolsRowChanged(editorConfig *ce, erow *row){
+    if (row->symKind > SYMBOL_NONE) ce->symbolsValid = 0;
+    if (row->symKind == SYMBOL_UNSCANNED) return;
+    row->symKind = SYMBOL_UNSCANNED;
+    editorRowTreeChanged(ce, row->idx, ROWTREE_UNSCANNED);
+}
+
+//Rows were inserted or deleted, the row tree keeps which still need a look
+void editorSymbolsRowsMoved(editorConfig *ce){
+    ce->symbolsValid = 0;
+}
+
+//First row from from on under nd, whose first row is start, that needs a look. -1 if none
+static int symNextUnscanned(editorConfig *ce, rowNode *nd, int start, int from){
+    if (start + nd->rows <= from || nd->unscanned == 0) return -1;
+    if (nd->leaf){
+        for (int y = (from > start) ? from : start;y<start + nd->rows;y++){
+            if (ce->row[y].symKind == SYMBOL_UNSCANNED) return y;
+        }
+        return -1;
+    }
+    for (int i = 0;i<nd->numChildren;i++){
+        int y = symNextUnscanned(ce, nd->child[i], start, from);
+        if (y != -1) return y;
+        start += nd->child[i]->rows;
+    }
+    return -1;
+}
+
+//Looks at up to rows rows that need it, 1 while some are left
+int editorSymbolsIndex(editorConfig *ce, int rows){
+    int y = symNextUnscanned(ce, editorRowTreeRoot(ce, ROWTREE_UNSCANNED), 0, 0);
+    while (y != -1 && rows > 0){
+        symScanRow(ce, &ce->row[y]);
+        rows--;
+        //The rows right after mostly need it too, the tree is only asked again after a leaf's
+        //worth that don't
+        int skipped = 0;
+        for (y++;y<ce->numRows && ce->row[y].symKind != SYMBOL_UNSCANNED;y++){
+            if (++skipped == COMETTEX_ROWTREE_LEAF){
+                y = symNextUnscanned(ce, editorRowTreeRoot(ce, ROWTREE_UNSCANNED), 0, y);
+                break;
+            }
+        }
+        if (y == ce->numRows) y = -1;
+    }
+    return editorRowTreeRoot(ce, ROWTREE_UNSCANNED)->unscanned > 0;
+}
+
+//A bit for each letter, any case, and one for digits and _. A name can only match a query
+//with all the query's bits, which rules out most names without looking at them
+static unsigned int symChars(const char *s, int len){
+    unsigned int bits = 0;
+    for (int i = 0;i<len;i++){
+        int c = tolower((unsigned char)s[i]);
+        if (c >= 'a' && c <= 'z') bits |= 1u << (c - 'a');
+        else bits |= 1u << 26;
+    }
+    return bits;
+}
+
+static void symBuildList(editorConfig *ce){
+    ce->numSymbols = 0;
+    ce->symbolNamesLen = 0;
+    for (int y = 0;y<ce->numRows;y++){
+        erow *row = &ce->row[y];
+        if (row->symKind <= SYMBOL_NONE) continue;
+
+        int off = 0, len = 0;
+        const char *text = editorRowText(row);
+        symScanText(text, row->size, &off, &len);
+        if (ce->numSymbols == ce->symbolsCap){
+            ce->symbolsCap = ce->symbolsCap ? ce->symbolsCap * 2 : 256;
+            ce->symbols = realloc(ce->symbols, sizeof(editorSymbol) * ce->symbolsCap);
+        }
+        while (ce->symbolNamesLen + len + 1 > ce->symbolNamesCap){
+            ce->symbolNamesCap = ce->symbolNamesCap ? ce->symbolNamesCap * 2 : 4096;
+            ce->symbolNames = realloc(ce->symbolNames, ce->symbolNamesCap);
+        }
+        editorSymbol *sym = &ce->symbols[ce->numSymbols++];
+        sym->row = y;
+        sym->off = off;
+        sym->len = len;
+        sym->kind = row->symKind;
+        sym->name = ce->symbolNamesLen;
+        memcpy(ce->symbolNames + ce->symbolNamesLen, text + off, len);
+        sym->chars = symChars(ce->symbolNames + ce->symbolNamesLen, len);
+        ce->symbolNamesLen += len;
+        ce->symbolNames[ce->symbolNamesLen++] = '\0';
+    }
+    ce->symbolsValid = 1;
+}
+
+//How well name matches query: its chars in order, any case. Starts of words and runs of
+//chars count for more, gaps for less. -1 when it doesn't match
+static int symScore(const char *name, int len, const char *query){
+    int score = 0;
+    int prev = -1;
+    int q = 0;
+    for (int i = 0;i<len && query[q];i++){
+        if (tolower((unsigned char)name[i]) != tolower((unsigned char)query[q])) continue;
+        int start = (i == 0 || name[i - 1] == '_' || (islower((unsigned char)name[i - 1]) && isupper((unsigned char)name[i])));
+        score += 1 + (start ? 8 : 0);
+        if (prev != -1){
+            int gap = i - prev - 1;
+            score += gap ? -(gap < 8 ? gap : 8) : 4;
+        }
+        prev = i;
+        q++;
+    }
+    if (query[q]) return -1;
+    if (q == len) score += 16;
+    return score;
+}
+
+//The best max symbols for query, best first and in row order when they score the same.
+//out gets indexes into ce->symbols. Rows not looked at yet aren't in it
+int editorSymbolsMatch(editorConfig *ce, const char *query, int *out, int max){
+    if (!ce->symbolsValid) symBuildList(ce);
+    if (max <= 0) return 0;
+
+    int found = 0;
+    int scores[max];
+    unsigned int chars = symChars(query, strlen(query));
+    for (int i = 0;i<ce->numSymbols;i++){
+        editorSymbol *sym = &ce->symbols[i];
+        if (chars & ~sym->chars) continue;
+        int score = symScore(ce->symbolNames + sym->name, sym->len, query);
+        if (score < 0) continue;
+        if (found == max && score <= scores[max - 1]) continue;
+
+        int at = (found < max) ? found++ : max - 1;
+        while (at > 0 && scores[at - 1] < score){
+            scores[at] = scores[at - 1];
+            out[at] = out[at - 1];
+            at--;
+        }
+        scores[at] = score;
+        out[at] = i;
+    }
+    return found;
+}
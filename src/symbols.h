@@ -0,0 +1,35 @@
+#ifndef SYMBOLS_C_
+#define SYMBOLS_C_
+#include "CometTex.h"
+
+//Rows the background pass looks at between checks for a key
+#define COMETTEX_SYMBOL_SLICE 4096
+//Best matches the jump prompt goes through with the arrows
+#define COMETTEX_SYMBOL_MATCHES 64
+//Only this much of a row's start is looked at for a definition
+#define COMETTEX_SYMBOL_SCAN 256
+
+enum editorSymbolKind{
+    SYMBOL_UNSCANNED = 0,
+    SYMBOL_NONE,
+    SYMBOL_FUNCTION,
+    SYMBOL_TYPE,
+    SYMBOL_DEFINE,
+};
+
+//A definition in the index, name is an offset into editorConfig.symbolNames
+typedef struct editorSymbol{
+    int row;
+    int off;    //Where the name starts in the row's chars
+    int len;
+    int name;
+    int kind;
+    unsigned int chars; //Which letters and digits the name has, see symChars
+} editorSymbol;
+
+void editorSymbolsRowChanged(editorConfig *ce, erow *row);
+void editorSymbolsRowsMoved(editorConfig *ce);
+int editorSymbolsIndex(editorConfig *ce, int rows);
+int editorSymbolsMatch(editorConfig *ce, const char *query, int *out, int max);
+
+#endif
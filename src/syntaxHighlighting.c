@@ -3,6 +3,13 @@
 #include <string.h>
 #include <ctype.h>
 #include "syntaxHighlighting.h"
+#include "ops.h"
+#include "rowAlloc.h"
+#include "coldRows.h"
+#include "perf.h"
+#include "languages.h"
+#include "brackets.h"
+#include "window.h"
 
 char *C_HL_extensions[] = {".c", ".h", ".cpp", NULL};
 char *C_HL_keywords[] = {
@@ -11,7 +18,7 @@ char *C_HL_keywords[] = {
     "int|", "long|", "double|", "float|", "char|", "unsigned|", "signed|", "void|", NULL
 };
 
-char *C_HL_importwords[] = {"#include", "#define"};
+char *C_HL_importwords[] = {"#include", "#define", NULL};
 
 struct editorSyntax HLDB[] = {
     {
@@ -24,16 +31,85 @@ struct editorSyntax HLDB[] = {
     },
 };
 
+//HLDB_ENTRIES only works where HLDB is defined
+unsigned int HLDBEntries = HLDB_ENTRIES;
+
 int isSeparator(int c){
+    //Bytes of multibyte chars come in as negative chars
+    c = (unsigned char)c;
     return isspace(c) || c == '\0' || strchr(",.()+-/*=~%<>[];", c) != NULL;
 }
 
-void editorUpdateSyntax(editorConfig *ce, erow *row){
-    row->hl = realloc(row->hl, row->rsize);
-    memset(row->hl, HL_NORMAL, row->rsize);
+//The lexer works on one byte per render byte, rows only keep the spans made from it
+static unsigned char *hlScratch = NULL;
+static int hlScratchCap = 0;
+
+static unsigned char *editorHlScratch(int len){
+    if (len + 1 > hlScratchCap){
+        hlScratchCap = len + 1;
+        hlScratch = realloc(hlScratch, hlScratchCap);
+    }
+    memset(hlScratch, HL_NORMAL, len);
+    return hlScratch;
+}
+
+size_t editorHlScratchBytes(){
+    return hlScratchCap;
+}
 
-    if (ce->syntax == NULL) return;
+//Turns the byte per render byte highlight into spans
+static void editorHlCompress(erow *row, unsigned char *hl, int len){
+    int n = 0;
+    for (int i = 0;i<len;){
+        int j = i + 1;
+        while (j < len && hl[j] == hl[i] && j - i < 0xffff) j++;
+        if (hl[i] != HL_NORMAL) n++;
+        i = j;
+    }
+
+    rowFree(row->hl, sizeof(hlSpan) * row->numHl);
+    row->hl = rowAlloc(sizeof(hlSpan) * n);
+    row->numHl = n;
 
+    n = 0;
+    for (int i = 0;i<len;){
+        int j = i + 1;
+        while (j < len && hl[j] == hl[i] && j - i < 0xffff) j++;
+        if (hl[i] != HL_NORMAL){
+            row->hl[n].start = i;
+            row->hl[n].len = j - i;
+            row->hl[n].hl = hl[i];
+            n++;
+        }
+        i = j;
+    }
+}
+
+//Highlight of render[rb]
+int editorHlAt(erow *row, int rb){
+    int lo = 0, hi = row->numHl - 1;
+    while (lo <= hi){
+        int mid = (lo + hi) / 2;
+        if (rb < row->hl[mid].start) hi = mid - 1;
+        else if (rb >= row->hl[mid].start + row->hl[mid].len) lo = mid + 1;
+        else return row->hl[mid].hl;
+    }
+    return HL_NORMAL;
+}
+
+static void hlSet(unsigned char *hl, int at, int h, int n){
+    if (hl) memset(&hl[at], h, n);
+}
+
+/*
+ Highlights text from st->pos up to stop starting from the lexer state st, and leaves the
+ state where it stopped in st. That can be a little past stop, keywords and comment ends
+ are taken whole. len is where the text really ends, what follows a char is looked at up
+ to there, so lexing a row in pieces gives the same as lexing it at once
+ hl can be NULL when only the state is wanted
+ If bs isn't NULL the brackets outside strings and comments are counted in it
+*/
+static void editorLex(editorConfig *ce, char *text, int len, int stop, unsigned char *hl, hlState *st, bracketScan *bs){
     char **keywords = ce->syntax->keywords;
     char **importwords = ce->syntax->importwords;
 
@@ -44,61 +120,60 @@ void editorUpdateSyntax(editorConfig *ce, erow *row){
     int scsLen = scs ? strlen(scs) : 0;
     int mcsLen = mcs ? strlen(mcs) : 0;
     int mceLen = mce ? strlen(mce) : 0;
-    
-    int preSep = 1;
-    int inString = 0;
-    int inComment = (row->idx > 0 && ce->row[row->idx - 1].hlOpenComment);
-
-    int i = 0;
-    while(i < row->rsize){
-        char c = row->render[i];
-        unsigned char preHL = (i > 0) ? row->hl[i - 1] : HL_NORMAL;
-
-        if (scsLen && !inString && !inComment){
-            if (!strncmp(&row->render[i], scs, scsLen)){
-                memset(&row->hl[i], HL_COMMENT, row->rsize - i);
-                break;
+
+    int i = st->pos;
+    while(i < stop){
+        char c = text[i];
+
+        if (!st->inLineComment && scsLen && !st->inString && !st->inComment){
+            if (!strncmp(&text[i], scs, scsLen)){
+                st->inLineComment = 1;
             }
         }
+        if (st->inLineComment){
+            hlSet(hl, i, HL_COMMENT, len - i);
+            i = len;
+            break;
+        }
 
         //If we started a multiline comment and make sure we aren't in a string
-        if (mcsLen && mceLen && !inString){
-            if (inComment){
-                row->hl[i] = HL_MLCOMMENT;
-                if (!strncmp(&row->render[i], mce, mceLen)){
-                    memset(&row->hl[i], HL_MLCOMMENT, mceLen);
+        if (mcsLen && mceLen && !st->inString){
+            if (st->inComment){
+                hlSet(hl, i, HL_MLCOMMENT, 1);
+                if (!strncmp(&text[i], mce, mceLen)){
+                    hlSet(hl, i, HL_MLCOMMENT, mceLen);
                     i += mceLen;
-                    inComment = 0;
-                    preSep = 1;
+                    st->inComment = 0;
+                    st->preSep = 1;
                     continue;
                 }else{
                     i++;
                     continue;
                 }
-            }else if (!strncmp(&row->render[i], mcs, mcsLen)){
-                memset(&row->hl[i], HL_MLCOMMENT, mcsLen);
+            }else if (!strncmp(&text[i], mcs, mcsLen)){
+                hlSet(hl, i, HL_MLCOMMENT, mcsLen);
                 i += mcsLen;
-                inComment = 1;
+                st->inComment = 1;
                 continue;
             }
         }
-        
+
         if (ce->syntax->flags & HL_HIGHLIGHT_STRINGS){
-            if (inString){
-                row->hl[i] = HL_STRING;
-                if (c == '\\' && i + 1 < row->rsize){
-                    row->hl[i + 1] = HL_STRING;
+            if (st->inString){
+                hlSet(hl, i, HL_STRING, 1);
+                if (c == '\\' && i + 1 < len){
+                    hlSet(hl, i + 1, HL_STRING, 1);
                     i += 2;
                     continue;
                 }
-                if (c == inString) inString = 0;
+                if (c == st->inString) st->inString = 0;
                 i++;
-                preSep = 1;
+                st->preSep = 1;
                 continue;
             }else{
                 if (c == '"' || c == '\''){
-                    inString = c;
-                    row->hl[i] = HL_STRING;
+                    st->inString = c;
+                    hlSet(hl, i, HL_STRING, 1);
                     i++;
                     continue;
                 }
@@ -106,61 +181,388 @@ void editorUpdateSyntax(editorConfig *ce, erow *row){
         }
         //If a function is starting
         //Make the chars before it a certain color
-        if (c == '('){
+        if (c == '(' && hl){
             int cnt = i-1;
-            while(!isSeparator(row->render[cnt])){
-                row->hl[cnt] = HL_FUNCTIONS;
+            while(cnt >= 0 && !isSeparator(text[cnt])){
+                hl[cnt] = HL_FUNCTIONS;
                 cnt--;
             }
         }
-        
+
         if (ce->syntax->flags & HL_HIGHLIGHT_NUMBERS){
-            if (isdigit(c)){
-                row->hl[i] = HL_NUMBER;
+            if (isdigit((unsigned char)c)){
+                hlSet(hl, i, HL_NUMBER, 1);
                 i++;
-                preSep = 0;
+                st->preSep = 0;
                 continue;
             }
         }
 
-        if (preSep){
+        if (st->preSep){
             int j;
             for (j = 0; keywords[j]; j++){
                 int klen = strlen(keywords[j]);
                 int kw2 = keywords[j][klen - 1] == '|';
                 if (kw2) klen--;
 
-                if (!strncmp(&row->render[i], keywords[j], klen) && isSeparator(row->render[i + klen])){
-                    memset(&row->hl[i], kw2 ? HL_KEYWORD2 : HL_KEYWORD1, klen);
+                if (!strncmp(&text[i], keywords[j], klen) && isSeparator(text[i + klen])){
+                    hlSet(hl, i, kw2 ? HL_KEYWORD2 : HL_KEYWORD1, klen);
                     i += klen;
                     break;
                 }
             }
             if (keywords[j] != NULL){
-                preSep = 0;
+                st->preSep = 0;
                 continue;
             }
 
             int jk;
             for (jk = 0; importwords[jk];jk++){
                 int iwLen = strlen(importwords[jk]);
-                if (!strncmp(&row->render[i],importwords[jk],iwLen)){
-                    memset(&row->hl[i],HL_IMPORTKEYWORDS,iwLen);
+                if (!strncmp(&text[i],importwords[jk],iwLen)){
+                    hlSet(hl, i, HL_IMPORTKEYWORDS, iwLen);
                     i += iwLen;
                     break;
                 }
             }
         }
 
-        preSep = isSeparator(c);
+        if (bs && IS_BRACKET(c)) editorBracketSee(bs, c, i);
+        st->preSep = isSeparator(c);
         i++;
     }
+    st->pos = i;
+}
+
+//How far past a char the lexer can look to decide on it
+static int editorLexReach(editorConfig *ce){
+    struct editorSyntax *s = ce->syntax;
+    //An escape in a string takes the char after it
+    int reach = 2;
+    for (int j = 0;s->keywords[j];j++){
+        //The separator after a keyword too, the '|' of a type takes its place
+        int l = strlen(s->keywords[j]) + 1;
+        if (l > reach) reach = l;
+    }
+    for (int j = 0;s->importwords[j];j++){
+        int l = strlen(s->importwords[j]);
+        if (l > reach) reach = l;
+    }
+    char *delims[] = {s->singleCommentStart, s->multiCommentStart, s->multiCommentEnd};
+    for (int j = 0;j<3;j++){
+        int l = delims[j] ? (int)strlen(delims[j]) : 0;
+        if (l > reach) reach = l;
+    }
+    return reach;
+}
+
+//Lexes a long row's chars from st up to stop. Without a syntax every bracket counts
+static void editorLexLongPiece(editorConfig *ce, erow *row, int stop, hlState *st, bracketScan *bs){
+    if (ce->syntax){
+        editorLex(ce, row->chars, row->size, stop, NULL, st, bs);
+        return;
+    }
+    if (stop > row->size) stop = row->size;
+    for (int i = st->pos;i<stop;i++){
+        if (IS_BRACKET(row->chars[i])) editorBracketSee(bs, row->chars[i], i);
+    }
+    st->pos = stop;
+}
+
+static int hlSameState(hlState *a, hlState *b){
+    return a->inString == b->inString && a->inComment == b->inComment &&
+        a->inLineComment == b->inLineComment && a->preSep == b->preSep;
+}
+
+//Last checkpoint of a long row at or before pos
+static int hlCheckpointBefore(erow *row, int pos){
+    int lo = 0, hi = row->longRow->numHlCheckpoints - 1;
+    while (lo < hi){
+        int mid = (lo + hi + 1) / 2;
+        if (row->longRow->hlCheckpoints[mid].st.pos <= pos) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
+
+/*
+ Lexes a long row again after del chars at at were replaced by ins chars, or all of it when
+ at is -1. Only the highlight of the window is kept, the rest is the checkpoints.
+
+ The lexer starts again at the last checkpoint it couldn't have looked at the change from,
+ and writes a new one about every COMETTEX_HL_CHECKPOINT chars. Once it gets to where an old
+ checkpoint past the change has moved to in the same state as that one, the text from there
+ is what it was and so is everything the lexer did with it, those checkpoints are kept as
+ they were ins - del chars further on. A keystroke lexes a piece or two of the row.
+
+ st is left as the state at the end of the row and bs has the row's brackets
+*/
+static void editorLexLong(editorConfig *ce, erow *row, int at, int del, int ins, hlState *st, bracketScan *bs){
+    longRow *lr = row->longRow;
+    hlCheckpoint *old = lr->hlCheckpoints;
+    int numOld = lr->numHlCheckpoints;
+    int delta = ins - del;
+    int k = 0;
+    if (at < 0 || old == NULL){
+        numOld = 0;
+    }else if (ce->syntax){
+        int reach = editorLexReach(ce);
+        //The first checkpoint is where the row starts, nothing in the row decides it
+        k = hlCheckpointBefore(row, at - reach);
+        *st = old[k].st;
+    }else{
+        k = hlCheckpointBefore(row, at);
+        *st = old[k].st;
+    }
+
+    //The new ones after the first k, the old ones after the change are moved into it as they are
+    int cap = numOld - k + 16;
+    hlCheckpoint *cps = malloc(sizeof(hlCheckpoint) * cap);
+    int n = 0;
+    int j = k + 1;
+    int same = 0;
+    while (1){
+        //Old checkpoints in or before the change, or passed already, are no use
+        while (j < numOld && (old[j].st.pos < at + del || old[j].st.pos + delta <= st->pos)) j++;
+        int stop = st->pos + COMETTEX_HL_CHECKPOINT;
+        //The lexer can only land on where an old one went by stopping there
+        if (j < numOld && old[j].st.pos + delta < stop + COMETTEX_HL_CHECKPOINT) stop = old[j].st.pos + delta;
+
+        hlCheckpoint *cp = &cps[n++];
+        cp->st = *st;
+        bracketScan piece = {{0, 0, 0}, NULL, 0, 0};
+        editorLexLongPiece(ce, row, stop, st, &piece);
+        cp->brackets = piece.s;
+        if (st->pos >= row->size) break;
+
+        if (j < numOld && old[j].st.pos + delta == st->pos && hlSameState(&old[j].st, st)){
+            same = 1;
+            break;
+        }
+        if (n == cap){
+            cap *= 2;
+            cps = realloc(cps, sizeof(hlCheckpoint) * cap);
+        }
+    }
+
+    int tail = same ? numOld - j : 0;
+    if (n + tail > cap) cps = realloc(cps, sizeof(hlCheckpoint) * (n + tail));
+    for (int i = 0;i<tail;i++){
+        cps[n + i] = old[j + i];
+        cps[n + i].st.pos += delta;
+    }
+    if (same){
+        //The end of the row is lexed as it was
+        st->inComment = row->hlOpenComment;
+    }
+
+    int num = k + n + tail;
+    lr->hlCheckpoints = rowRealloc(lr->hlCheckpoints, sizeof(hlCheckpoint) * lr->numHlCheckpoints, sizeof(hlCheckpoint) * num);
+    lr->numHlCheckpoints = num;
+    memcpy(&lr->hlCheckpoints[k], cps, sizeof(hlCheckpoint) * (n + tail));
+    free(cps);
+
+    for (int i = 0;i<num;i++) bs->s = editorBracketJoin(bs->s, lr->hlCheckpoints[i].brackets);
+}
+
+//Lexes one row, returns whether the next row now starts in a different comment state
+static int editorHighlightRow(editorConfig *ce, erow *row){
+    //Frozen rows aren't on any screen, they're thawed before they're drawn
+    if (row->coldBlock == -1) editorDamageRows(ce, row->idx, row->idx + 1);
+    hlState st = {0, 0, 0, 0, 1};
+    st.inComment = (row->idx > 0 && ce->row[row->idx - 1].hlOpenComment);
+    bracketScan bs = {{0, 0, 0}, NULL, 0, 0};
+
+    if (row->coldBlock != -1){
+        //Frozen rows have no highlight to keep, only the state for the next row
+        if (ce->syntax == NULL){
+            editorBracketScanText(&bs, editorRowText(row), row->size);
+            editorBracketsRowChanged(ce, row, &bs);
+            return 0;
+        }
+        editorLex(ce, editorRowText(row), row->size, row->size, NULL, &st, &bs);
+    }else if (row->size >= COMETTEX_LONG_LINE){
+        //Long rows are lexed without writing any highlight, only the checkpoints
+        //The visible window is highlighted from the closest one
+        editorLexLong(ce, row, -1, 0, 0, &st, &bs);
+        editorUpdateSyntaxWindow(ce, row);
+        editorBracketsRowChanged(ce, row, &bs);
+        if (ce->syntax == NULL) return 0;
+    }else{
+        //A row that got shorter let go of its checkpoints when it was rendered
+        if (ce->syntax == NULL){
+            editorHlCompress(row, NULL, 0);
+            editorRowAccount(ce, row);
+            editorBracketScanText(&bs, row->chars, row->size);
+            editorBracketsRowChanged(ce, row, &bs);
+            return 0;
+        }
+        unsigned char *hl = editorHlScratch(row->rsize);
+        editorLex(ce, row->render, row->rsize, row->rsize, hl, &st, &bs);
+        editorHlCompress(row, hl, row->rsize);
+        editorRowAccount(ce, row);
+    }
+    editorBracketsRowChanged(ce, row, &bs);
+
+    int changed = (row->hlOpenComment != st.inComment);
+    row->hlOpenComment = st.inComment;
+    return changed;
+}
+
+//Where the brackets outside strings and comments are in a row's chars, for finding one
+//in particular. The row can be cold
+void editorLexBrackets(editorConfig *ce, erow *row, bracketScan *bs){
+    if (ce->syntax == NULL){
+        editorBracketScanText(bs, editorRowText(row), row->size);
+        return;
+    }
+    hlState st = {0, 0, 0, 0, 1};
+    st.inComment = (row->idx > 0 && ce->row[row->idx - 1].hlOpenComment);
+    editorLex(ce, editorRowText(row), row->size, row->size, NULL, &st, bs);
+}
 
-    int changed = (row->hlOpenComment != inComment);
-    row->hlOpenComment = inComment;
-    if (changed && row->idx + 1 < ce->numRows){
-        editorUpdateSyntax(ce, &ce->row[row->idx + 1]);
+//A long row's brackets are kept in pieces, one from each checkpoint to the next, any other
+//row's are one piece
+int editorBracketPieces(erow *row){
+    return (row->longRow && row->longRow->hlCheckpoints) ? row->longRow->numHlCheckpoints : 1;
+}
+
+bracketSummary editorBracketPiece(erow *row, int k){
+    return (editorBracketPieces(row) > 1) ? row->longRow->hlCheckpoints[k].brackets : row->brackets;
+}
+
+//The piece with char x in it
+int editorBracketPieceAt(erow *row, int x){
+    return (editorBracketPieces(row) > 1) ? hlCheckpointBefore(row, x) : 0;
+}
+
+//Where the brackets of piece k of the row are, a long row is only lexed from its checkpoint
+void editorLexBracketPiece(editorConfig *ce, erow *row, int k, bracketScan *bs){
+    int n = editorBracketPieces(row);
+    if (n == 1){
+        editorLexBrackets(ce, row, bs);
+        return;
+    }
+    hlCheckpoint *cps = row->longRow->hlCheckpoints;
+    hlState st = cps[k].st;
+    editorLexLongPiece(ce, row, (k + 1 < n) ? cps[k + 1].st.pos : row->size, &st, bs);
+}
+
+static void editorSyntaxMarkDirty(editorConfig *ce, int from, int to){
+    if (ce->hlDirtyFrom >= ce->hlDirtyTo){
+        ce->hlDirtyFrom = from;
+        ce->hlDirtyTo = to;
+        return;
+    }
+    if (from < ce->hlDirtyFrom) ce->hlDirtyFrom = from;
+    if (to > ce->hlDirtyTo) ce->hlDirtyTo = to;
+}
+
+//Keep going down for as long as the comment state changes. A loop and not recursion,
+//opening a comment at the top of a big file walks every row below it
+static void editorHighlightFrom(editorConfig *ce, erow *row){
+    while (editorHighlightRow(ce, row) && row->idx + 1 < ce->numRows){
+        row = &ce->row[row->idx + 1];
+    }
+}
+
+void editorUpdateSyntax(editorConfig *ce, erow *row){
+    if (ce->hlDefer){
+        editorSyntaxMarkDirty(ce, row->idx, row->idx + 1);
+        return;
     }
+    long long t = editorPerfBegin();
+    editorHighlightFrom(ce, row);
+    editorPerfEnd(PERF_SYNTAX, t);
+}
+
+/*
+ Like editorUpdateSyntax after del chars at at of the row were replaced by ins chars. A row
+ that was long before the change and still is only lexes what the change reaches
+*/
+void editorUpdateSyntaxEdit(editorConfig *ce, erow *row, int at, int del, int ins){
+    if (ce->hlDefer || row->longRow == NULL || row->longRow->hlCheckpoints == NULL){
+        editorUpdateSyntax(ce, row);
+        return;
+    }
+    long long t = editorPerfBegin();
+    editorDamageRows(ce, row->idx, row->idx + 1);
+    hlState st;
+    bracketScan bs = {{0, 0, 0}, NULL, 0, 0};
+    editorLexLong(ce, row, at, del, ins, &st, &bs);
+    editorUpdateSyntaxWindow(ce, row);
+    editorBracketsRowChanged(ce, row, &bs);
+    if (ce->syntax && row->hlOpenComment != st.inComment){
+        row->hlOpenComment = st.inComment;
+        if (row->idx + 1 < ce->numRows) editorHighlightFrom(ce, &ce->row[row->idx + 1]);
+    }
+    editorPerfEnd(PERF_SYNTAX, t);
+}
+
+//Highlights rows [from, to) in one pass, for edits that touch many rows at once
+void editorUpdateSyntaxRange(editorConfig *ce, int from, int to){
+    if (from < 0) from = 0;
+    if (ce->hlDefer){
+        if (from < to) editorSyntaxMarkDirty(ce, from, to);
+        return;
+    }
+    if (to > ce->numRows) to = ce->numRows;
+    long long t = editorPerfBegin();
+    for (int i = from;i<to;i++){
+        editorHighlightRow(ce, &ce->row[i]);
+    }
+    //The rows after the range only need a look if the state going into them changed
+    if (to < ce->numRows && from < to){
+        editorHighlightFrom(ce, &ce->row[to]);
+    }
+    editorPerfEnd(PERF_SYNTAX, t);
+}
+
+//Stops highlighting until editorFlushSyntax, which does every row touched meanwhile at once
+void editorDeferSyntax(editorConfig *ce){
+    ce->hlDefer = 1;
+    ce->hlDirtyFrom = 0;
+    ce->hlDirtyTo = 0;
+}
+
+void editorFlushSyntax(editorConfig *ce){
+    ce->hlDefer = 0;
+    editorUpdateSyntaxRange(ce, ce->hlDirtyFrom, ce->hlDirtyTo);
+    ce->hlDirtyFrom = 0;
+    ce->hlDirtyTo = 0;
+}
+
+//Where row x is after n rows are inserted (n > 0) or deleted (n < 0) at at, deleted rows go to at
+static int syntaxMoveRow(int x, int at, int n){
+    if (n >= 0) return (x < at) ? x : x + n;
+    if (x <= at) return x;
+    return (x >= at - n) ? x + n : at;
+}
+
+//n rows were inserted (n > 0) or deleted (n < 0) at at, the dirty range has to follow them
+void editorSyntaxRowsMoved(editorConfig *ce, int at, int n){
+    if (!ce->hlDefer || ce->hlDirtyFrom >= ce->hlDirtyTo) return;
+    ce->hlDirtyFrom = syntaxMoveRow(ce->hlDirtyFrom, at, n);
+    ce->hlDirtyTo = syntaxMoveRow(ce->hlDirtyTo, at, n);
+}
+
+//Highlights the rendered window of a long row
+void editorUpdateSyntaxWindow(editorConfig *ce, erow *row){
+    if (ce->syntax == NULL || row->longRow == NULL || row->longRow->hlCheckpoints == NULL){
+        editorHlCompress(row, NULL, 0);
+        editorRowAccount(ce, row);
+        return;
+    }
+
+    //Catch the lexer up from the closest checkpoint to the start of the window
+    int mstart = row->longRow->mstart;
+    hlState st = row->longRow->hlCheckpoints[hlCheckpointBefore(row, mstart)].st;
+    editorLex(ce, row->chars, row->size, mstart, NULL, &st, NULL);
+    st.pos = 0;
+    unsigned char *hl = editorHlScratch(row->rsize);
+    editorLex(ce, row->render, row->rsize, row->rsize, hl, &st, NULL);
+    editorHlCompress(row, hl, row->rsize);
+    editorRowAccount(ce, row);
 }
 
 // int fromIdxToSep(int idx, erow *row){
@@ -193,28 +595,9 @@ int editorSyntaxToColor(int hl){
     }
 }
 
+//Picks the definition for the file name, see languages.c. Everything is highlighted again when it changes
 void editorSelectSyntaxHighlight(editorConfig *ce){
-    ce->syntax = NULL;
-    if (ce->filename == NULL) return;
-
-    char *ext = strrchr(ce->filename, '.');
-
-    for (unsigned int i = 0;i<HLDB_ENTRIES;i++){
-        struct editorSyntax *s = &HLDB[i];
-        unsigned int j = 0;
-        while(s->fileMatch[j]){
-            int is_ext = (s->fileMatch[j][0] == '.');
-            if ((is_ext && ext && !strcmp(ext, s->fileMatch[j])) || (!is_ext && strstr(ce->filename, s->fileMatch[j]))){
-                ce->syntax = s;
-
-                int fileRow;
-                for (fileRow = 0;fileRow < ce->numRows; fileRow++){
-                    editorUpdateSyntax(ce, &ce->row[fileRow]);
-                }
-
-                return;
-            }
-            j++;
-        }
-    }
+    struct editorSyntax *old = ce->syntax;
+    ce->syntax = (ce->filename == NULL) ? NULL : editorLanguageFor(ce->filename);
+    if (ce->syntax != old) editorUpdateSyntaxRange(ce, 0, ce->numRows);
 }
\ No newline at end of file
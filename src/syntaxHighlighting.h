@@ -17,6 +17,22 @@ struct editorSyntax{
     int flags;
 };
 
+//Everything the lexer carries from one char to the next
+typedef struct hlState{
+    int pos;
+    char inString;
+    char inComment;
+    char inLineComment;
+    char preSep;
+} hlState;
+
+//A long row's lexer state about every COMETTEX_HL_CHECKPOINT chars, at st.pos, and the
+//brackets from there up to the next checkpoint
+typedef struct hlCheckpoint{
+    hlState st;
+    bracketSummary brackets;
+} hlCheckpoint;
+
 enum editorHighlight{
     HL_NORMAL = 0,
     HL_NUMBER,
@@ -35,10 +51,25 @@ extern char *C_HL_extensions[];
 extern struct editorSyntax HLDB[];
 
 #define HLDB_ENTRIES (sizeof(HLDB) / sizeof(HLDB[0]))
+extern unsigned int HLDBEntries;
 
 void editorUpdateSyntax(editorConfig *ce, erow *row);
+void editorUpdateSyntaxEdit(editorConfig *ce, erow *row, int at, int del, int ins);
+void editorUpdateSyntaxRange(editorConfig *ce, int from, int to);
+void editorDeferSyntax(editorConfig *ce);
+void editorFlushSyntax(editorConfig *ce);
+void editorSyntaxRowsMoved(editorConfig *ce, int at, int n);
+void editorUpdateSyntaxWindow(editorConfig *ce, erow *row);
 int fromIdxToSep(int idx, erow *row);
+int editorHlAt(erow *row, int rb);
 int editorSyntaxToColor(int hl);
+size_t editorHlScratchBytes();
 void editorSelectSyntaxHighlight(editorConfig *ce);
+struct bracketScan;
+void editorLexBrackets(editorConfig *ce, erow *row, struct bracketScan *bs);
+int editorBracketPieces(erow *row);
+bracketSummary editorBracketPiece(erow *row, int k);
+int editorBracketPieceAt(erow *row, int x);
+void editorLexBracketPiece(editorConfig *ce, erow *row, int k, struct bracketScan *bs);
 
 #endif
\ No newline at end of file
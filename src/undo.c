@@ -0,0 +1,296 @@
+#include <stdlib.h>
+#include <string.h>
+#include "CometTex.h"
+#include "ops.h"
+#include "undo.h"
+
+/*
+ Undo log. Every change is a record saying some text was inserted or deleted at a
+ position, the text itself lives in one append-only arena, so a record is a few ints
+ no matter how big the change was. Undoing a record is a single editorDeleteRange or
+ editorInsertText, which handle any number of rows in one pass.
+
+ Typing and backspacing merge into the last record while they stay next to each other,
+ so a word typed is one record and not one per char. Records sharing a group are
+ undone together.
+*/
+
+enum undoType{
+    UNDO_INSERT = 0,
+    UNDO_DELETE
+};
+
+typedef struct undoRecord{
+    int type;
+    int y, x;   //Where the text starts
+    int ey, ex; //Right after its last char
+    size_t off; //The text in the arena
+    size_t len;
+    int cy, cx; //Cursor before the change
+    unsigned group;
+} undoRecord;
+
+static char *text = NULL;
+static size_t textLen = 0;
+static size_t textCap = 0;
+static undoRecord *records = NULL;
+static int numRecords = 0;
+static int recordCap = 0;
+//records[0..cur) can be undone, records[cur..numRecords) redone
+static int cur = 0;
+//The next change can't merge into the last record
+static int sealed = 1;
+static int groupDepth = 0;
+static unsigned groupId = 0;
+//The first record of the open group, or where it will be
+static int groupStart = 0;
+static unsigned nextGroup = 1;
+//Set while undoing or redoing so the edits made don't get recorded again
+static int applying = 0;
+
+static void undoEndPos(int y, int x, const char *s, size_t len, int *ey, int *ex){
+    const char *end = s + len;
+    const char *nl;
+    while ((nl = memchr(s, '\n', end - s)) != NULL){
+        y++;
+        x = 0;
+        s = nl + 1;
+    }
+    *ey = y;
+    *ex = x + (end - s);
+}
+
+static void undoReserveText(size_t len){
+    if (textLen + len <= textCap) return;
+    while (textLen + len > textCap) textCap = textCap ? textCap * 2 : 4096;
+    text = realloc(text, textCap);
+}
+
+//Drops the oldest records before keep, whole groups at a time, until the new text fits.
+//The group still being recorded is never cut into, a change bigger than the limit goes over it
+static void undoTrim(size_t incoming, int keep){
+    if (textLen + incoming <= COMETTEX_UNDO_BYTES) return;
+    int open = (groupDepth > 0 && groupStart < keep) ? groupStart : keep;
+
+    //Go down to half the limit so this doesn't run again on the very next change
+    int k = 0;
+    while (k < open && textLen - records[k].off + incoming > COMETTEX_UNDO_BYTES / 2) k++;
+    while (k > 0 && k < open && records[k].group == records[k - 1].group) k++;
+    if (k == 0) return;
+
+    size_t base = (k < numRecords) ? records[k].off : textLen;
+    memmove(text, text + base, textLen - base);
+    textLen -= base;
+    memmove(records, records + k, sizeof(undoRecord) * (numRecords - k));
+    numRecords -= k;
+    cur -= k;
+    groupStart -= k;
+    for (int i = 0;i<numRecords;i++) records[i].off -= base;
+    sealed = 1;
+}
+
+static void undoNewRecord(editorConfig *ce, int type, int y, int x, const char *s, size_t len){
+    //A new change throws away whatever could have been redone
+    if (cur < numRecords){
+        textLen = records[cur].off;
+        numRecords = cur;
+        if (groupStart > numRecords) groupStart = numRecords;
+    }
+    undoTrim(len, numRecords);
+
+    if (numRecords == recordCap){
+        recordCap = recordCap ? recordCap * 2 : 256;
+        records = realloc(records, sizeof(undoRecord) * recordCap);
+    }
+    undoRecord *r = &records[numRecords++];
+    cur = numRecords;
+
+    r->type = type;
+    r->y = y;
+    r->x = x;
+    undoEndPos(y, x, s, len, &r->ey, &r->ex);
+    r->cy = ce->my;
+    r->cx = ce->mx;
+    r->group = groupDepth ? groupId : nextGroup++;
+
+    undoReserveText(len);
+    r->off = textLen;
+    r->len = len;
+    if (len) memcpy(text + textLen, s, len);
+    textLen += len;
+
+    sealed = (groupDepth > 0);
+}
+
+//The last record if the next change is allowed to merge into it
+static undoRecord *undoLastOpen(int type, size_t len){
+    if (sealed || applying || groupDepth || cur != numRecords || numRecords == 0) return NULL;
+    undoRecord *r = &records[numRecords - 1];
+    if (r->type != type || r->len + len > COMETTEX_UNDO_COALESCE) return NULL;
+    return r;
+}
+
+int editorUndoRecording(){
+    return !applying;
+}
+
+void editorUndoRecordInsert(editorConfig *ce, int y, int x, const char *s, size_t len){
+    if (applying || len == 0) return;
+
+    undoRecord *r = undoLastOpen(UNDO_INSERT, len);
+    if (r && r->ey == y && r->ex == x){
+        //Typing right after the last insert
+        undoReserveText(len);
+        memcpy(text + textLen, s, len);
+        textLen += len;
+        r->len += len;
+        undoEndPos(y, x, s, len, &r->ey, &r->ex);
+        return;
+    }
+    undoNewRecord(ce, UNDO_INSERT, y, x, s, len);
+}
+
+void editorUndoRecordDelete(editorConfig *ce, int y, int x, const char *s, size_t len){
+    if (applying || len == 0) return;
+
+    undoRecord *r = undoLastOpen(UNDO_DELETE, len);
+    if (r){
+        int ey, ex;
+        undoEndPos(y, x, s, len, &ey, &ex);
+        if (ey == r->y && ex == r->x){
+            //Backspace, the text goes in front. The record is the last thing in the arena
+            undoReserveText(len);
+            memmove(text + r->off + len, text + r->off, r->len);
+            memcpy(text + r->off, s, len);
+            textLen += len;
+            r->len += len;
+            r->y = y;
+            r->x = x;
+            return;
+        }
+        if (y == r->y && x == r->x){
+            //Delete key, the text that was after the last deletion
+            undoReserveText(len);
+            memcpy(text + textLen, s, len);
+            textLen += len;
+            r->len += len;
+            undoEndPos(r->ey, r->ex, s, len, &r->ey, &r->ex);
+            return;
+        }
+    }
+    undoNewRecord(ce, UNDO_DELETE, y, x, s, len);
+}
+
+/*
+ For text too big to want a copy of first: editorUndoRecordStart opens an empty record at
+ (y, x) and editorUndoRecordMore adds to the end of its text, until anything else is recorded.
+ It never merges with other records. The text counts against the limit as it comes, older
+ changes are dropped for it but never the record itself or the rest of its group
+*/
+void editorUndoRecordStart(editorConfig *ce, int insert, int y, int x){
+    if (applying) return;
+    undoNewRecord(ce, insert ? UNDO_INSERT : UNDO_DELETE, y, x, "", 0);
+    sealed = 1;
+}
+
+void editorUndoRecordMore(const char *s, size_t len){
+    if (applying || numRecords == 0 || len == 0) return;
+    undoTrim(len, numRecords - 1);
+    undoRecord *r = &records[numRecords - 1];
+    undoReserveText(len);
+    memcpy(text + textLen, s, len);
+    textLen += len;
+    r->len += len;
+    undoEndPos(r->ey, r->ex, s, len, &r->ey, &r->ex);
+}
+
+void editorUndoSeal(){
+    sealed = 1;
+}
+
+//Everything recorded until the matching editorUndoEndGroup is undone as one change
+void editorUndoBeginGroup(){
+    if (groupDepth++ == 0){
+        groupId = nextGroup++;
+        groupStart = numRecords;
+    }
+    sealed = 1;
+}
+
+void editorUndoEndGroup(){
+    if (groupDepth > 0) groupDepth--;
+    sealed = 1;
+}
+
+static void undoClampCursor(editorConfig *ce){
+    if (ce->my > ce->numRows) ce->my = ce->numRows;
+    if (ce->my < 0) ce->my = 0;
+    int size = (ce->my < ce->numRows) ? ce->row[ce->my].size : 0;
+    if (ce->mx > size) ce->mx = size;
+    if (ce->mx < 0) ce->mx = 0;
+}
+
+int editorUndo(editorConfig *ce){
+    if (cur == 0) return 0;
+
+    unsigned group = records[cur - 1].group;
+    applying = 1;
+    while (cur > 0 && records[cur - 1].group == group){
+        undoRecord *r = &records[--cur];
+        if (r->type == UNDO_INSERT){
+            editorDeleteRange(ce, r->y, r->x, r->ey, r->ex);
+        }else{
+            editorInsertText(ce, r->y, r->x, text + r->off, r->len);
+        }
+        ce->my = r->cy;
+        ce->mx = r->cx;
+    }
+    applying = 0;
+    sealed = 1;
+    undoClampCursor(ce);
+    return 1;
+}
+
+int editorRedo(editorConfig *ce){
+    if (cur == numRecords) return 0;
+
+    unsigned group = records[cur].group;
+    applying = 1;
+    while (cur < numRecords && records[cur].group == group){
+        undoRecord *r = &records[cur++];
+        if (r->type == UNDO_INSERT){
+            editorInsertText(ce, r->y, r->x, text + r->off, r->len);
+            ce->my = r->ey;
+            ce->mx = r->ex;
+        }else{
+            editorDeleteRange(ce, r->y, r->x, r->ey, r->ex);
+            ce->my = r->y;
+            ce->mx = r->x;
+        }
+    }
+    applying = 0;
+    sealed = 1;
+    undoClampCursor(ce);
+    return 1;
+}
+
+void editorUndoReset(){
+    free(text);
+    free(records);
+    text = NULL;
+    textLen = textCap = 0;
+    records = NULL;
+    numRecords = recordCap = 0;
+    cur = 0;
+    sealed = 1;
+    groupDepth = 0;
+    groupStart = 0;
+}
+
+void editorUndoGetStats(undoStats *st){
+    st->textBytes = textLen;
+    st->textCap = textCap;
+    st->recordBytes = sizeof(undoRecord) * recordCap;
+    st->records = numRecords;
+    st->undoable = cur;
+}
@@ -0,0 +1,34 @@
+#ifndef UNDO_C_
+#define UNDO_C_
+#include <stddef.h>
+#include "CometTex.h"
+
+//Text kept around for undo, the oldest changes are dropped past it
+#ifndef COMETTEX_UNDO_BYTES
+#define COMETTEX_UNDO_BYTES (64 * 1024 * 1024)
+#endif
+//Longest run of typing or deleting merged into a single change
+#define COMETTEX_UNDO_COALESCE 4096
+
+typedef struct undoStats{
+    size_t textBytes;   //Text the records point into
+    size_t textCap;     //What the text arena holds room for
+    size_t recordBytes; //Room for the records
+    int records;
+    int undoable;       //Records before the current one, the rest can be redone
+} undoStats;
+
+int editorUndoRecording();
+void editorUndoRecordInsert(editorConfig *ce, int y, int x, const char *s, size_t len);
+void editorUndoRecordDelete(editorConfig *ce, int y, int x, const char *s, size_t len);
+void editorUndoRecordStart(editorConfig *ce, int insert, int y, int x);
+void editorUndoRecordMore(const char *s, size_t len);
+void editorUndoSeal();
+void editorUndoBeginGroup();
+void editorUndoEndGroup();
+int editorUndo(editorConfig *ce);
+int editorRedo(editorConfig *ce);
+void editorUndoReset();
+void editorUndoGetStats(undoStats *st);
+
+#endif
@@ -0,0 +1,181 @@
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "utf8.h"
+
+struct interval{
+    int first;
+    int last;
+};
+
+//Chars that take no column of their own (combining marks, joiners, variation selectors)
+static const struct interval zeroWidth[] = {
+    {0x0300, 0x036F}, {0x0483, 0x0489}, {0x0591, 0x05BD}, {0x05BF, 0x05BF},
+    {0x05C1, 0x05C2}, {0x05C4, 0x05C5}, {0x05C7, 0x05C7}, {0x0610, 0x061A},
+    {0x064B, 0x065F}, {0x0670, 0x0670}, {0x06D6, 0x06DC}, {0x06DF, 0x06E4},
+    {0x06E7, 0x06E8}, {0x06EA, 0x06ED}, {0x0711, 0x0711}, {0x0730, 0x074A},
+    {0x07A6, 0x07B0}, {0x07EB, 0x07F3}, {0x0816, 0x082D}, {0x0859, 0x085B},
+    {0x08D3, 0x0902}, {0x093A, 0x093A}, {0x093C, 0x093C}, {0x0941, 0x0948},
+    {0x094D, 0x094D}, {0x0951, 0x0957}, {0x0962, 0x0963}, {0x0981, 0x0981},
+    {0x09BC, 0x09BC}, {0x09C1, 0x09C4}, {0x09CD, 0x09CD}, {0x09E2, 0x09E3},
+    {0x0A01, 0x0A02}, {0x0A3C, 0x0A3C}, {0x0A41, 0x0A51}, {0x0A70, 0x0A71},
+    {0x0A81, 0x0A82}, {0x0ABC, 0x0ABC}, {0x0AC1, 0x0AC8}, {0x0ACD, 0x0ACD},
+    {0x0B01, 0x0B01}, {0x0B3C, 0x0B3C}, {0x0B3F, 0x0B3F}, {0x0B41, 0x0B44},
+    {0x0B4D, 0x0B4D}, {0x0BC0, 0x0BC0}, {0x0BCD, 0x0BCD}, {0x0C3E, 0x0C40},
+    {0x0C46, 0x0C56}, {0x0CBC, 0x0CBC}, {0x0CCC, 0x0CCD}, {0x0D41, 0x0D44},
+    {0x0D4D, 0x0D4D}, {0x0DCA, 0x0DCA}, {0x0DD2, 0x0DD6}, {0x0E31, 0x0E31},
+    {0x0E34, 0x0E3A}, {0x0E47, 0x0E4E}, {0x0EB1, 0x0EB1}, {0x0EB4, 0x0EBC},
+    {0x0EC8, 0x0ECD}, {0x0F18, 0x0F19}, {0x0F35, 0x0F35}, {0x0F37, 0x0F37},
+    {0x0F39, 0x0F39}, {0x0F71, 0x0F7E}, {0x0F80, 0x0F84}, {0x0F86, 0x0F87},
+    {0x102D, 0x1030}, {0x1032, 0x1037}, {0x1039, 0x103A}, {0x1160, 0x11FF},
+    {0x135D, 0x135F}, {0x1712, 0x1714}, {0x17B4, 0x17B5}, {0x17B7, 0x17BD},
+    {0x17C6, 0x17C6}, {0x17C9, 0x17D3}, {0x180B, 0x180E}, {0x1AB0, 0x1AFF},
+    {0x1DC0, 0x1DFF}, {0x200B, 0x200F}, {0x202A, 0x202E}, {0x2060, 0x2064},
+    {0x20D0, 0x20F0}, {0x302A, 0x302D}, {0x3099, 0x309A}, {0xA66F, 0xA672},
+    {0xA674, 0xA67D}, {0xA69E, 0xA69F}, {0xA8E0, 0xA8F1}, {0xFB1E, 0xFB1E},
+    {0xFE00, 0xFE0F}, {0xFE20, 0xFE2F}, {0xFEFF, 0xFEFF}, {0xFFF9, 0xFFFB},
+    {0x1D167, 0x1D169}, {0x1D173, 0x1D182}, {0xE0001, 0xE007F}, {0xE0100, 0xE01EF},
+};
+
+//East Asian Wide and Fullwidth chars, plus the emoji that terminals draw as two columns
+static const struct interval doubleWidth[] = {
+    {0x1100, 0x115F}, {0x231A, 0x231B}, {0x2329, 0x232A}, {0x23E9, 0x23EC},
+    {0x23F0, 0x23F0}, {0x23F3, 0x23F3}, {0x25FD, 0x25FE}, {0x2614, 0x2615},
+    {0x2648, 0x2653}, {0x267F, 0x267F}, {0x2693, 0x2693}, {0x26A1, 0x26A1},
+    {0x26AA, 0x26AB}, {0x26BD, 0x26BE}, {0x26C4, 0x26C5}, {0x26CE, 0x26CE},
+    {0x26D4, 0x26D4}, {0x26EA, 0x26EA}, {0x26F2, 0x26F3}, {0x26F5, 0x26F5},
+    {0x26FA, 0x26FA}, {0x26FD, 0x26FD}, {0x2705, 0x2705}, {0x270A, 0x270B},
+    {0x2728, 0x2728}, {0x274C, 0x274C}, {0x274E, 0x274E}, {0x2753, 0x2755},
+    {0x2757, 0x2757}, {0x2795, 0x2797}, {0x27B0, 0x27B0}, {0x27BF, 0x27BF},
+    {0x2B1B, 0x2B1C}, {0x2B50, 0x2B50}, {0x2B55, 0x2B55}, {0x2E80, 0x303E},
+    {0x3041, 0x33FF}, {0x3400, 0x4DBF}, {0x4E00, 0x9FFF}, {0xA000, 0xA4CF},
+    {0xA960, 0xA97F}, {0xAC00, 0xD7A3}, {0xF900, 0xFAFF}, {0xFE10, 0xFE19},
+    {0xFE30, 0xFE6F}, {0xFF00, 0xFF60}, {0xFFE0, 0xFFE6}, {0x16FE0, 0x16FE4},
+    {0x17000, 0x18AFF}, {0x1B000, 0x1B2FF}, {0x1F004, 0x1F004}, {0x1F0CF, 0x1F0CF},
+    {0x1F18E, 0x1F18E}, {0x1F191, 0x1F19A}, {0x1F200, 0x1F251}, {0x1F300, 0x1F64F},
+    {0x1F680, 0x1F6FF}, {0x1F7E0, 0x1F7EB}, {0x1F90C, 0x1F9FF}, {0x1FA70, 0x1FAFF},
+    {0x20000, 0x2FFFD}, {0x30000, 0x3FFFD},
+};
+
+static int inTable(int cp, const struct interval *t, int n){
+    if (cp < t[0].first || cp > t[n - 1].last) return 0;
+    int lo = 0, hi = n - 1;
+    while (lo <= hi){
+        int mid = (lo + hi) / 2;
+        if (cp > t[mid].last) lo = mid + 1;
+        else if (cp < t[mid].first) hi = mid - 1;
+        else return 1;
+    }
+    return 0;
+}
+
+/*
+ Decodes the char at s into cp
+ @returns how many bytes it takes. Invalid or cut off sequences are one byte with cp = -1
+*/
+int utf8Decode(const char *s, int len, int *cp){
+    unsigned char c = s[0];
+    if (c < 0x80){
+        *cp = c;
+        return 1;
+    }
+
+    int n, min, v;
+    if ((c & 0xE0) == 0xC0){
+        n = 2; v = c & 0x1F; min = 0x80;
+    }else if ((c & 0xF0) == 0xE0){
+        n = 3; v = c & 0x0F; min = 0x800;
+    }else if ((c & 0xF8) == 0xF0){
+        n = 4; v = c & 0x07; min = 0x10000;
+    }else{
+        *cp = -1;
+        return 1;
+    }
+
+    if (n > len){
+        *cp = -1;
+        return 1;
+    }
+    for (int i = 1;i<n;i++){
+        if (((unsigned char)s[i] & 0xC0) != 0x80){
+            *cp = -1;
+            return 1;
+        }
+        v = (v << 6) | (s[i] & 0x3F);
+    }
+    //Overlong encodings and surrogates aren't valid either
+    if (v < min || v > 0x10FFFF || (v >= 0xD800 && v <= 0xDFFF)){
+        *cp = -1;
+        return 1;
+    }
+    *cp = v;
+    return n;
+}
+
+//How many columns the terminal uses for cp. Invalid and control chars are drawn as one
+int utf8CharWidth(int cp){
+    if (cp < 0x300) return 1;
+    if (inTable(cp, zeroWidth, sizeof(zeroWidth) / sizeof(zeroWidth[0]))) return 0;
+    if (inTable(cp, doubleWidth, sizeof(doubleWidth) / sizeof(doubleWidth[0]))) return 2;
+    return 1;
+}
+
+int utf8IsAscii(const char *s, int len){
+    int i = 0;
+#ifdef __SSE2__
+    //Or 64 bytes together and check all their top bits at once
+    for (;i + 64 <= len;i += 64){
+        __m128i a = _mm_loadu_si128((const __m128i *)&s[i]);
+        __m128i b = _mm_loadu_si128((const __m128i *)&s[i + 16]);
+        __m128i c = _mm_loadu_si128((const __m128i *)&s[i + 32]);
+        __m128i d = _mm_loadu_si128((const __m128i *)&s[i + 48]);
+        if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d)))) return 0;
+    }
+    for (;i + 16 <= len;i += 16){
+        if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)&s[i]))) return 0;
+    }
+#else
+    for (;i + 8 <= len;i += 8){
+        uint64_t w;
+        memcpy(&w, &s[i], 8);
+        if (w & 0x8080808080808080ULL) return 0;
+    }
+#endif
+    for (;i<len;i++){
+        if ((unsigned char)s[i] & 0x80) return 0;
+    }
+    return 1;
+}
+
+//Index of the char after the one at s[at], combining marks stay with the char before them
+int utf8NextChar(const char *s, int len, int at){
+    int cp;
+    if (at >= len) return len;
+    at += utf8Decode(&s[at], len - at, &cp);
+    while (at < len){
+        int n = utf8Decode(&s[at], len - at, &cp);
+        if (cp < 0 || utf8CharWidth(cp) != 0) break;
+        at += n;
+    }
+    return at;
+}
+
+//Index of the char before s[at], skipping back over combining marks
+int utf8PrevChar(const char *s, int at){
+    while (at > 0){
+        int start = at - 1;
+        while (start > 0 && at - start < 4 && ((unsigned char)s[start] & 0xC0) == 0x80) start--;
+
+        int cp;
+        //Stray continuation bytes count as one char each
+        if (start + utf8Decode(&s[start], at - start, &cp) != at){
+            start = at - 1;
+            cp = -1;
+        }
+        at = start;
+        if (cp < 0 || utf8CharWidth(cp) != 0) break;
+    }
+    return at;
+}
@@ -0,0 +1,10 @@
+#ifndef UTF8_C_
+#define UTF8_C_
+
+int utf8Decode(const char *s, int len, int *cp);
+int utf8CharWidth(int cp);
+int utf8IsAscii(const char *s, int len);
+int utf8NextChar(const char *s, int len, int at);
+int utf8PrevChar(const char *s, int at);
+
+#endif
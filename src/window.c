@@ -0,0 +1,217 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "CometTex.h"
+#include "cursors.h"
+#include "wrap.h"
+#include "window.h"
+
+/*
+ Split windows. They all show the one buffer, the rows with their render and highlight are
+ shared, so a window is only a cursor, a viewport and a place on the screen. The current
+ window's cursor and viewport are editorConfig's own mx, my, rowOffset and so on, which is
+ what everything that moves or scrolls works on. The other windows keep theirs in their
+ editorWindow until they're current again.
+
+ The current window is drawn every frame. Edits mark the rows that draw differently now as
+ damaged, and another window is only drawn again when the damage reaches into the rows it
+ showed last time or it would now show something else.
+*/
+
+//Puts the current window's cursor and viewport, which live in ce, in its editorWindow
+void editorWindowSync(editorConfig *ce){
+    if (ce->numWindows == 0) return;
+    editorWindow *win = &ce->windows[ce->curWindow];
+    win->mx = ce->mx;
+    win->my = ce->my;
+    win->rx = ce->rx;
+    win->rowOffset = ce->rowOffset;
+    win->colOffset = ce->colOffset;
+}
+
+//Makes window w the current one, its cursor goes back where it can be
+static void windowLoad(editorConfig *ce, int w){
+    editorWindow *win = &ce->windows[w];
+    ce->curWindow = w;
+    ce->my = (win->my > ce->numRows) ? ce->numRows : win->my;
+    int size = (ce->my < ce->numRows) ? ce->row[ce->my].size : 0;
+    ce->mx = (win->mx > size) ? size : win->mx;
+    ce->rx = win->rx;
+    ce->rowOffset = win->rowOffset;
+    ce->colOffset = win->colOffset;
+    //Only the current window scrolls by screen lines, the others start at the top of a row
+    ce->lineOffset = ce->wrapWidth ? editorWrapLineOf(ce, win->rowOffset) : 0;
+    ce->screenRow = win->height;
+}
+
+static void windowsUndrawn(editorConfig *ce){
+    for (int w = 0;w<ce->numWindows;w++) ce->windows[w].drawn = 0;
+}
+
+static void windowRemove(editorConfig *ce, int w){
+    memmove(&ce->windows[w], &ce->windows[w + 1], sizeof(editorWindow) * (ce->numWindows - w - 1));
+    ce->numWindows--;
+}
+
+/*
+ Shares lines screen lines out evenly between the windows, each one's text and its status
+ bar. The first call makes the one window there is at first. Windows that don't fit go
+*/
+void editorWindowsLayout(editorConfig *ce, int lines){
+    if (ce->numWindows == 0){
+        ce->windows = calloc(1, sizeof(editorWindow));
+        ce->numWindows = 1;
+        ce->curWindow = 0;
+    }
+    editorWindowSync(ce);
+    while (ce->numWindows > 1 && lines < ce->numWindows * (COMETTEX_WINDOW_MIN_ROWS + 1)){
+        windowRemove(ce, ce->numWindows - 1);
+    }
+    if (ce->curWindow >= ce->numWindows) ce->curWindow = ce->numWindows - 1;
+
+    int top = 0;
+    for (int w = 0;w<ce->numWindows;w++){
+        //The ones at the bottom get what doesn't divide evenly
+        int share = lines / ce->numWindows + (w >= ce->numWindows - lines % ce->numWindows);
+        ce->windows[w].top = top;
+        ce->windows[w].height = (share > 1) ? share - 1 : 1;
+        top += share;
+    }
+    windowsUndrawn(ce);
+    windowLoad(ce, ce->curWindow);
+}
+
+void editorWindowFocus(editorConfig *ce, int w){
+    if (w < 0 || w >= ce->numWindows || w == ce->curWindow) return;
+    editorWindowSync(ce);
+    //It was drawn with what only the current window shows, the search match, the bracket
+    //pair and the extra cursors, so it's drawn again without them
+    ce->windows[ce->curWindow].drawn = 0;
+    //Extra cursors belong to the window they were made in
+    editorClearCursors(ce);
+    windowLoad(ce, w);
+}
+
+//Splits the current window in two, the new one above it is current. 0 when it's too small
+int editorWindowSplit(editorConfig *ce){
+    int cur = ce->curWindow;
+    int lines = ce->windows[cur].height + 1;
+    if (lines < 2 * (COMETTEX_WINDOW_MIN_ROWS + 1)) return 0;
+    editorWindowSync(ce);
+
+    ce->windows = realloc(ce->windows, sizeof(editorWindow) * (ce->numWindows + 1));
+    memmove(&ce->windows[cur + 1], &ce->windows[cur], sizeof(editorWindow) * (ce->numWindows - cur));
+    ce->numWindows++;
+
+    editorWindow *above = &ce->windows[cur];
+    editorWindow *below = &ce->windows[cur + 1];
+    above->height = lines / 2 - 1;
+    below->top = above->top + above->height + 1;
+    below->height = lines - lines / 2 - 1;
+    above->drawn = below->drawn = 0;
+    windowLoad(ce, cur);
+    return 1;
+}
+
+//Closes the current window, the one above it takes its lines or the one below for the top one
+//0 when it's the only one
+int editorWindowClose(editorConfig *ce){
+    if (ce->numWindows <= 1) return 0;
+    int cur = ce->curWindow;
+    editorWindow gone = ce->windows[cur];
+    windowRemove(ce, cur);
+
+    int next = (cur > 0) ? cur - 1 : 0;
+    editorWindow *win = &ce->windows[next];
+    if (cur == 0) win->top = gone.top;
+    win->height += gone.height + 1;
+    win->drawn = 0;
+    editorClearCursors(ce);
+    windowLoad(ce, next);
+    return 1;
+}
+
+//Closes every window but the current one, which takes the whole screen. 0 when there's none
+int editorWindowOnly(editorConfig *ce){
+    if (ce->numWindows <= 1) return 0;
+    editorWindowSync(ce);
+    editorWindow *last = &ce->windows[ce->numWindows - 1];
+    int lines = last->top + last->height + 1;
+
+    ce->windows[0] = ce->windows[ce->curWindow];
+    ce->numWindows = 1;
+    ce->windows[0].top = 0;
+    ce->windows[0].height = lines - 1;
+    ce->windows[0].drawn = 0;
+    windowLoad(ce, 0);
+    return 1;
+}
+
+//Where row x is after n rows are inserted (n > 0) or deleted (n < 0) at at
+static int windowMoveRow(int x, int at, int n){
+    if (n >= 0) return (x < at) ? x : x + n;
+    if (x <= at) return x;
+    return (x >= at - n) ? x + n : at;
+}
+
+/*
+ Rows were inserted or deleted at at. The other windows' cursors and tops stay on the rows
+ they were on, and so does what they last drew, so a window the rows moved under without
+ reaching it isn't drawn again. What's damaged is the new rows or the row where they went
+*/
+void editorWindowsRowsMoved(editorConfig *ce, int at, int n){
+    editorDamageRows(ce, at, at + (n > 0 ? n : 1));
+    for (int w = 0;w<ce->numWindows;w++){
+        if (w == ce->curWindow) continue;
+        editorWindow *win = &ce->windows[w];
+        win->my = windowMoveRow(win->my, at, n);
+        win->rowOffset = windowMoveRow(win->rowOffset, at, n);
+        win->drawnRow = windowMoveRow(win->drawnRow, at, n);
+        if (win->drawnTo != INT_MAX) win->drawnTo = windowMoveRow(win->drawnTo, at, n);
+    }
+}
+
+//Rows [from, to) draw differently than they did when the screen was last drawn
+void editorDamageRows(editorConfig *ce, int from, int to){
+    if (ce->damageFrom >= ce->damageTo){
+        ce->damageFrom = from;
+        ce->damageTo = to;
+        return;
+    }
+    if (from < ce->damageFrom) ce->damageFrom = from;
+    if (to > ce->damageTo) ce->damageTo = to;
+}
+
+void editorDamageClear(editorConfig *ce){
+    ce->damageFrom = 0;
+    ce->damageTo = 0;
+}
+
+//The row at the top of window w, and with soft wrap which of its lines
+void editorWindowTopRow(editorConfig *ce, int w, int *row, int *sub){
+    if (ce->wrapWidth && w == ce->curWindow){
+        *row = editorWrapRowAt(ce, ce->lineOffset, sub);
+    }else{
+        *row = ce->windows[w].rowOffset;
+        *sub = 0;
+    }
+}
+
+int editorWindowNeedsDraw(editorConfig *ce, int w){
+    editorWindow *win = &ce->windows[w];
+    if (w == ce->curWindow || !win->drawn) return 1;
+
+    int row, sub;
+    editorWindowTopRow(ce, w, &row, &sub);
+    if (row != win->drawnRow || sub != win->drawnSub || win->colOffset != win->drawnCol) return 1;
+    return ce->damageFrom < ce->damageTo && ce->damageFrom < win->drawnTo && ce->damageTo > win->drawnRow;
+}
+
+//Window w was just drawn down to the row before to
+void editorWindowDrawn(editorConfig *ce, int w, int to){
+    editorWindow *win = &ce->windows[w];
+    editorWindowTopRow(ce, w, &win->drawnRow, &win->drawnSub);
+    win->drawnCol = win->colOffset;
+    win->drawnTo = to;
+    win->drawn = 1;
+}
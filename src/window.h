@@ -0,0 +1,36 @@
+#ifndef WINDOW_C_
+#define WINDOW_C_
+#include "CometTex.h"
+
+//Text lines a window can't be split below
+#define COMETTEX_WINDOW_MIN_ROWS 2
+
+typedef struct editorWindow{
+    //Its cursor and viewport, only up to date while it isn't the current one
+    int mx, my;
+    int rx;
+    int rowOffset;
+    int colOffset;
+    //Its first screen line and how many lines of text it has, its status bar comes after them
+    int top;
+    int height;
+    //What it showed when it was last drawn, nothing has been while drawn is 0
+    int drawn;
+    int drawnRow, drawnSub, drawnCol;
+    int drawnTo;    //Row after the last one on it, INT_MAX when it went past the end
+} editorWindow;
+
+void editorWindowsLayout(editorConfig *ce, int lines);
+void editorWindowSync(editorConfig *ce);
+void editorWindowFocus(editorConfig *ce, int w);
+int editorWindowSplit(editorConfig *ce);
+int editorWindowClose(editorConfig *ce);
+int editorWindowOnly(editorConfig *ce);
+void editorWindowsRowsMoved(editorConfig *ce, int at, int n);
+void editorDamageRows(editorConfig *ce, int from, int to);
+void editorDamageClear(editorConfig *ce);
+void editorWindowTopRow(editorConfig *ce, int w, int *row, int *sub);
+int editorWindowNeedsDraw(editorConfig *ce, int w);
+void editorWindowDrawn(editorConfig *ce, int w, int to);
+
+#endif
@@ -0,0 +1,117 @@
+#include <stdlib.h>
+#include <limits.h>
+#include "CometTex.h"
+#include "ops.h"
+#include "utf8.h"
+#include "coldRows.h"
+#include "wrap.h"
+#include "rowTree.h"
+#include "window.h"
+
+/*
+ Soft wrap. A row is cut into screen lines every wrapWidth render columns, line k of a
+ row shows columns [k * wrapWidth, (k + 1) * wrapWidth), the same thing horizontal scrolling
+ to k * wrapWidth would show. How many lines a row takes is kept in the row and only
+ worked out again when the row changes.
+
+ Going from a screen line to its row, for scrolling and paging, and back is a walk down
+ the row tree over those counts, log n steps instead of adding up every row above. See
+ rowTree.c
+*/
+
+//Render columns of a cold row, worked out from its text since it has no checkpoints
+static int wrapTextWidth(const char *s, int len){
+    int rx = 0;
+    int i = 0;
+    while (i < len){
+        unsigned char c = s[i];
+        if (c == '\t'){
+            rx += COMETTEX_TAB_STOP - (rx % COMETTEX_TAB_STOP);
+            i++;
+        }else if (c < 0x80){
+            rx++;
+            i++;
+        }else{
+            int cp;
+            i += utf8Decode(&s[i], len - i, &cp);
+            rx += utf8CharWidth(cp);
+        }
+    }
+    return rx;
+}
+
+int editorWrapRowLines(editorConfig *ce, erow *row){
+    if (row->wrapLines == 0){
+        int width = (row->coldBlock == -1) ? rowMxToRx(row, row->size) : wrapTextWidth(editorRowText(row), row->size);
+        row->wrapLines = (width == 0) ? 1 : (width + ce->wrapWidth - 1) / ce->wrapWidth;
+    }
+    return row->wrapLines;
+}
+
+//Turns soft wrap on at width columns, or off with 0. Every row is counted again
+void editorWrapSetWidth(editorConfig *ce, int width){
+    if (width == ce->wrapWidth) return;
+    ce->wrapWidth = width;
+    for (int i = 0;i<ce->numRows;i++) ce->row[i].wrapLines = 0;
+    editorRowTreeStale(ce, ROWTREE_LINES);
+    ce->lineOffset = 0;
+    editorDamageRows(ce, 0, INT_MAX);
+}
+
+//The row's text changed, recount it and mark its leaf if that's different
+void editorWrapRowChanged(editorConfig *ce, erow *row){
+    if (ce->wrapWidth == 0) return;
+    int old = row->wrapLines;
+    row->wrapLines = 0;
+    if (editorWrapRowLines(ce, row) != old) editorRowTreeChanged(ce, row->idx, ROWTREE_LINES);
+}
+
+//The screen line row y starts on
+int editorWrapLineOf(editorConfig *ce, int y){
+    rowNode *nd = editorRowTreeRoot(ce, ROWTREE_LINES);
+    if (y >= ce->numRows) return nd->lines;
+    int line = 0, s = 0;
+    while (!nd->leaf){
+        int i = 0;
+        while (i < nd->numChildren - 1 && y >= s + nd->child[i]->rows){
+            line += nd->child[i]->lines;
+            s += nd->child[i]->rows;
+            i++;
+        }
+        nd = nd->child[i];
+    }
+    for (;s<y;s++) line += editorWrapRowLines(ce, &ce->row[s]);
+    return line;
+}
+
+//The row on screen line line, and which of its lines it is in *sub
+//Lines past the last row give numRows, *sub is then how far past
+int editorWrapRowAt(editorConfig *ce, int line, int *sub){
+    rowNode *nd = editorRowTreeRoot(ce, ROWTREE_LINES);
+    int rem = line < 0 ? 0 : line;
+    if (rem >= nd->lines){
+        *sub = rem - nd->lines;
+        return ce->numRows;
+    }
+    int y = 0;
+    while (!nd->leaf){
+        int i = 0;
+        while (rem >= nd->child[i]->lines){
+            rem -= nd->child[i]->lines;
+            y += nd->child[i]->rows;
+            i++;
+        }
+        nd = nd->child[i];
+    }
+    for (;;y++){
+        int lines = editorWrapRowLines(ce, &ce->row[y]);
+        if (rem < lines) break;
+        rem -= lines;
+    }
+    *sub = rem;
+    return y;
+}
+
+int editorWrapTotal(editorConfig *ce){
+    return editorRowTreeRoot(ce, ROWTREE_LINES)->lines;
+}
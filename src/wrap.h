@@ -0,0 +1,12 @@
+#ifndef WRAP_C_
+#define WRAP_C_
+#include "CometTex.h"
+
+void editorWrapSetWidth(editorConfig *ce, int width);
+void editorWrapRowChanged(editorConfig *ce, erow *row);
+int editorWrapRowLines(editorConfig *ce, erow *row);
+int editorWrapLineOf(editorConfig *ce, int y);
+int editorWrapRowAt(editorConfig *ce, int line, int *sub);
+int editorWrapTotal(editorConfig *ce);
+
+#endif